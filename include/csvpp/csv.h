@@ -33,6 +33,7 @@ extern "C"
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include "version.h"
@@ -137,12 +138,36 @@ typedef struct CSV_reader CSV_reader;
 
 /// Create a new CSV_reader object parsing from a file
 
+/// When built with \c CSVPP_USE_ZLIB or \c CSVPP_USE_ZSTD, compressed files
+/// are detected and decompressed
 /// @param filename Path to file
 /// @returns New CSV_reader object. Free with CSV_reader_free()
 /// @returns NULL if unable to open the file. Use strerror / perror for details
 /// @ingroup c_reader
 CSV_reader * CSV_reader_init_from_filename(const char * filename);
 
+/// Compression format of CSV_reader input
+
+/// @ingroup c_reader
+typedef enum {
+    CSV_COMPRESSION_DETECT, ///< Detect from the first bytes of input. Formats that are not enabled are read as-is
+    CSV_COMPRESSION_NONE,   ///< Not compressed
+    CSV_COMPRESSION_GZIP,   ///< gzip or zlib. Requires \c CSVPP_USE_ZLIB
+    CSV_COMPRESSION_ZSTD    ///< Zstandard. Requires \c CSVPP_USE_ZSTD
+} CSV_compression;
+
+/// Create a new CSV_reader object parsing from a compressed file
+
+/// Corrupt or truncated input is reported as ::CSV_IO_ERROR while reading
+/// @param filename Path to file
+/// @param compression Compression format of the file
+/// @returns New CSV_reader object. Free with CSV_reader_free()
+/// @returns NULL if unable to open the file. Use strerror / perror for
+/// details. \c errno is set to \c EINVAL if \c compression is a format that is
+/// not enabled
+/// @ingroup c_reader
+CSV_reader * CSV_reader_init_from_filename_compressed(const char * filename, CSV_compression compression);
+
 /// Create a new CSV_reader object parsing from a FILE *
 
 /// @param file FILE * opened in read mode. Caller remains responsible to call \c
@@ -152,6 +177,67 @@ CSV_reader * CSV_reader_init_from_filename(const char * filename);
 /// @ingroup c_reader
 CSV_reader * CSV_reader_init_from_file(FILE * file);
 
+/// Byte range of a CSV file, for reading part of a file
+
+/// \c begin and \c end are both row starts (or the end of the file), so
+/// shards with the same \c end and \c begin for adjacent shards cover every row
+/// exactly once. A row belongs to the shard containing its first character.
+///
+/// Create with CSV_resolve_shard() or CSV_plan_shards(), and read with
+/// CSV_reader_init_from_shard()
+/// @ingroup c_reader
+typedef struct {
+    uint64_t begin; ///< Byte offset of the shard's first row
+    uint64_t end;   ///< Byte offset just past the shard's last row
+    uint64_t line;  ///< Line number of \c begin
+    uint64_t col;   ///< Column number of \c begin
+} CSV_shard;
+
+/// Find the rows within a byte range of a CSV file
+
+/// The shard begins at the first row that starts at or after \c begin, and
+/// ends at the first row that starts at or after \c end. Processes given
+/// adjacent byte ranges of the same file get shards that cover every row
+/// exactly once without having to coordinate.
+///
+/// The file is scanned from the beginning to track quoted fields, so a field
+/// containing line breaks is never mistaken for the end of a row. This assumes
+/// quotes only appear in quoted fields, as in any valid CSV
+/// @param filename Path to file
+/// @param begin Byte offset of start of range
+/// @param end Byte offset of end of range
+/// @param quote Quote character
+/// @param[out] shard Set to shard for the range
+/// @returns \c false if unable to read the file. Use strerror / perror for details
+/// @ingroup c_reader
+bool CSV_resolve_shard(const char * filename, uint64_t begin, uint64_t end, const char quote, CSV_shard * shard);
+
+/// Split a CSV file into shards of about equal size
+
+/// Scans the file once to find row starts near each split point. See
+/// CSV_resolve_shard() for details
+/// @param filename Path to file
+/// @param count Number of shards
+/// @param quote Quote character
+/// @param[out] shards Array of \c count shards to fill, in order. Shards may be
+/// empty if there are fewer rows than shards, or if some rows are very long
+/// @returns \c false if unable to read the file, if \c count is 0, or if
+/// out of memory
+/// @ingroup c_reader
+bool CSV_plan_shards(const char * filename, size_t count, const char quote, CSV_shard * shards);
+
+/// Create a new CSV_reader object parsing part of a file
+
+/// Only the rows in \c shard are read. Line and column numbers are those of
+/// the full file
+/// @param filename Path to file
+/// @param shard Range of rows to read, from CSV_resolve_shard() or CSV_plan_shards()
+/// @returns New CSV_reader object. Free with CSV_reader_free()
+/// @returns NULL if unable to open the file or seek to the start of the shard.
+/// Use strerror / perror for details
+/// @ingroup c_reader
+CSV_reader * CSV_reader_init_from_shard(const char * filename, const CSV_shard * shard);
+
 /// Create a new CSV_reader object parsing from an in-memory string
 
 /// @param input String to read from. Caller remains responsible to free the string
@@ -163,7 +249,7 @@ CSV_reader * CSV_reader_init_from_str(const char * input);
 
 /// Free a CSV_reader object
 
-/// Closes the file if created with CSV_reader_init_from_filename
+/// Closes the file if created with CSV_reader_init_from_filename, CSV_reader_init_from_filename_compressed, or CSV_reader_init_from_shard
 /// @ingroup c_reader
 void CSV_reader_free(CSV_reader * reader);
 
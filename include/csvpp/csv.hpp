@@ -24,19 +24,68 @@
 #ifndef CSV_HPP
 #define CSV_HPP
 
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <deque>
 #include <exception>
+#include <filesystem>
 #include <fstream>
+#include <functional>
+#include <limits>
 #include <map>
 #include <memory>
+#include <new>
 #include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <variant>
 #include <vector>
 
 #include <cassert>
 #include <cerrno>
+#include <cmath>
+#include <cstdint>
 #include <cstring>
 
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CSVPP_HAS_MMAP
+#endif
+
+#if defined(CSVPP_USE_IO_URING) && defined(CSVPP_HAS_MMAP)
+#include "uring.h"
+#define CSVPP_HAS_URING
+#endif
+
+#ifdef CSVPP_USE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef CSVPP_USE_ZSTD
+#include <zstd.h>
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CSVPP_HAS_X86_SIMD
+#endif
+
+// Error paths are kept out of line, so they don't take up space in the inlined parser
+#if defined(__GNUC__) || defined(__clang__)
+#define CSVPP_COLD __attribute__((cold, noinline))
+#else
+#define CSVPP_COLD
+#endif
+
+#include "simd.h"
 #include "version.h"
 
 /// @defgroup cpp C++ library
@@ -159,6 +208,190 @@ namespace csv
         int errno_code_;
     };
 
+    /// Kind of error reported by Read_error
+    enum class Error_kind
+    {
+        parse,           ///< Malformed CSV. Corresponds to Parse_error
+        type_conversion, ///< Field could not be converted. Corresponds to Type_conversion_error
+        io,              ///< Error reading input. Corresponds to IO_error
+        other            ///< Any other exception, such as one thrown by a user-defined conversion or filter, or std::bad_alloc
+    };
+
+    /// Error returned by the non-throwing Reader methods
+
+    /// Holds the same information as the exception the throwing methods
+    /// would raise, without allocating. The message is only formatted when
+    /// message() is called
+    class Read_error
+    {
+    public:
+        /// @param kind Kind of error
+        /// @param type Parsing error type. Must be a string literal
+        /// @param field Field that failed to convert
+        /// @param line_no Line that the error occured on
+        /// @param col_no Column that the error occured on
+        Read_error(Error_kind kind, const char * type, std::string_view field, int line_no, int col_no) noexcept:
+            kind_{kind},
+            type_{type},
+            field_{field},
+            line_no_{line_no},
+            col_no_{col_no}
+        {}
+
+        /// @param exception Exception that was caught
+        /// @param kind Kind of error. Error_kind::io or Error_kind::other
+        explicit Read_error(std::exception_ptr exception, Error_kind kind = Error_kind::io) noexcept:
+            kind_{kind},
+            exception_{std::move(exception)}
+        {}
+
+        /// @returns Kind of error
+        Error_kind kind() const noexcept { return kind_; }
+        /// @returns Line number that the error occured on. 0 for IO and other errors
+        int line_no() const noexcept { return line_no_; }
+        /// @returns Column that the error occured on. 0 for IO and other errors
+        int col_no() const noexcept { return col_no_; }
+        /// @returns Parsing error type (ie. quote found inside of unquoted field). Empty unless kind() is Error_kind::parse
+        std::string_view type() const noexcept { return type_; }
+        /// @returns Value of field that failed to convert. Empty unless kind()
+        /// is Error_kind::type_conversion. Valid until the next row is read
+        std::string_view field() const noexcept { return field_; }
+
+        /// @returns Caught exception. Null unless kind() is Error_kind::io or Error_kind::other
+        const std::exception_ptr & exception() const noexcept { return exception_; }
+
+        /// @returns Error message. Same as \c what() of the corresponding exception
+        std::string message() const
+        {
+            switch(kind_)
+            {
+            case Error_kind::parse:
+                return "Error parsing CSV at line: " + std::to_string(line_no_) + ", col: " + std::to_string(col_no_) + ": " + type_;
+            case Error_kind::type_conversion:
+                return "Could not convert '" + std::string{field_} + "' to requested type";
+            case Error_kind::io:
+            case Error_kind::other:
+            default:
+                // an exception_ptr's exception can only be reached by rethrowing it
+                try
+                {
+                    std::rethrow_exception(exception_);
+                }
+                catch(const std::exception & e)
+                {
+                    return e.what();
+                }
+                catch(...)
+                {
+                    return "Unknown exception";
+                }
+            }
+        }
+
+        /// Throw the corresponding exception
+
+        /// @throws Parse_error, Type_conversion_error, or IO_error, depending
+        /// on kind(), or the caught exception for Error_kind::other
+        [[noreturn]] void raise() const
+        {
+            switch(kind_)
+            {
+            case Error_kind::parse:
+                throw Parse_error(type_, line_no_, col_no_);
+            case Error_kind::type_conversion:
+                throw Type_conversion_error(std::string{field_});
+            case Error_kind::io:
+            case Error_kind::other:
+            default:
+                std::rethrow_exception(exception_);
+            }
+        }
+
+    private:
+        Error_kind kind_;
+        const char * type_ {""};
+        std::string_view field_;
+        int line_no_ {0};
+        int col_no_ {0};
+        std::exception_ptr exception_;
+    };
+
+    /// Result of a non-throwing Reader method
+
+    /// Holds either a value or a Read_error
+    /// @tparam T Type of value
+    template <typename T>
+    class Read_result
+    {
+    public:
+        /// @param value Value read
+        Read_result(T value) noexcept(std::is_nothrow_move_constructible_v<T>): result_{std::in_place_index<0>, std::move(value)} {}
+        /// @param error Error that occured while reading
+        Read_result(Read_error error) noexcept: result_{std::in_place_index<1>, std::move(error)} {}
+
+        /// @returns \c true if a value was read
+        bool has_value() const noexcept { return result_.index() == 0; }
+        /// @returns \c true if a value was read
+        explicit operator bool() const noexcept { return has_value(); }
+
+        /// @returns Value read
+        /// @throws Parse_error, Type_conversion_error, IO_error, or the caught exception if an error occured instead
+        T & value() & { check(); return *std::get_if<0>(&result_); }
+        /// @copydoc value()
+        const T & value() const & { check(); return *std::get_if<0>(&result_); }
+        /// @copydoc value()
+        T && value() && { check(); return std::move(*std::get_if<0>(&result_)); }
+
+        /// @param default_value Value to return if an error occured
+        /// @returns Value read, or \c default_value
+        template <typename U>
+        T value_or(U && default_value) const & { return has_value() ? **this : static_cast<T>(std::forward<U>(default_value)); }
+        /// @copydoc value_or()
+        template <typename U>
+        T value_or(U && default_value) && { return has_value() ? std::move(**this) : static_cast<T>(std::forward<U>(default_value)); }
+
+        /// @returns Value read. has_value() must be \c true
+        T & operator*() & noexcept { return *std::get_if<0>(&result_); }
+        /// @copydoc operator*()
+        const T & operator*() const & noexcept { return *std::get_if<0>(&result_); }
+        /// @copydoc operator*()
+        T && operator*() && noexcept { return std::move(*std::get_if<0>(&result_)); }
+        /// @returns Pointer to value read. has_value() must be \c true
+        T * operator->() noexcept { return std::get_if<0>(&result_); }
+        /// @copydoc operator->()
+        const T * operator->() const noexcept { return std::get_if<0>(&result_); }
+
+        /// @returns Error that occured. has_value() must be \c false
+        const Read_error & error() const noexcept { return *std::get_if<1>(&result_); }
+
+    private:
+        void check() const
+        {
+            if(!has_value())
+                error().raise();
+        }
+
+        std::variant<T, Read_error> result_;
+    };
+
+    /// Compression format of Reader input
+    enum class Compression
+    {
+        detect, ///< Detect from the first bytes of input. Formats that are not enabled are read as-is
+        none,   ///< Not compressed
+        gzip,   ///< gzip or zlib. Requires \c CSVPP_USE_ZLIB
+        zstd    ///< Zstandard. Requires \c CSVPP_USE_ZSTD
+    };
+
+    /// Quoting policy for Writer fields
+    enum class Quoting
+    {
+        minimal, ///< Quote fields containing the delimiter, quote, CR, or LF. The default
+        always,  ///< Quote every field, without checking whether it needs it. Quotes within fields are still escaped
+        never,   ///< Never quote or escape fields. Output may not be valid CSV if fields contain special characters
+        trusted  ///< As Quoting::never, but fields are asserted to not need quoting in debug builds
+    };
+
     namespace detail
     {
         // SFINAE types to determine the best way to convert a given type to a std::string
@@ -186,744 +419,3696 @@ namespace csv
         struct has_ostr<T, std::void_t<decltype(std::declval<std::ostringstream&>() << std::declval<T>())>> : std::true_type{};
         template <typename T>
         inline constexpr bool has_ostr_v = has_ostr<T>::value;
-    };
-
-    /// String conversion
 
-    /// Convert a given type to std::string, using conversion, to_string, or std::ostream insertion
-    /// @param t Data to convert to std::string
-    /// @returns Input converted to std::string
-    template <typename T, typename std::enable_if_t<std::is_convertible_v<T, std::string>, int> = 0>
-    std::string str(const T & t)
-    {
-        return t;
-    }
+        // Does the type have a std::hash specialization
+        template <typename T, typename = void>
+        struct is_hashable: std::false_type{};
+        template <typename T>
+        struct is_hashable<T, std::void_t<decltype(std::hash<T>{}(std::declval<const T&>()))>> : std::true_type{};
+        template <typename T>
+        inline constexpr bool is_hashable_v = is_hashable<T>::value;
 
-    template <typename T, typename std::enable_if_t<!std::is_convertible_v<T, std::string> && detail::has_std_to_string_v<T>, int> = 0>
-    std::string str(const T & t)
-    {
-        return std::to_string(t);
-    }
+        // Can the type be parsed with std::from_chars? Character types are
+        // excluded, as std::istream reads them as characters rather than numbers
+        template <typename T>
+        inline constexpr bool is_char_v = std::is_same_v<T, char> || std::is_same_v<T, signed char> || std::is_same_v<T, unsigned char>
+            || std::is_same_v<T, wchar_t> || std::is_same_v<T, char16_t> || std::is_same_v<T, char32_t>;
+        template <typename T>
+        inline constexpr bool has_from_chars_v = (std::is_integral_v<T> && !std::is_same_v<T, bool> && !is_char_v<T>)
+#ifdef __cpp_lib_to_chars
+            || std::is_floating_point_v<T>
+#endif
+            ;
+
+        // Can the type be written with std::to_chars? The same types that are
+        // read with std::from_chars
+        template <typename T>
+        inline constexpr bool has_to_chars_v = has_from_chars_v<T>;
 
-    template <typename T, typename std::enable_if_t<!std::is_convertible_v<T, std::string> && !detail::has_std_to_string_v<T> && detail::has_to_string_v<T>, int> = 0>
-    std::string str(const T & t)
-    {
-        return to_string(t);
-    }
+        /// Largest number of characters format_number() writes
 
-    template <typename T, typename std::enable_if_t<!std::is_convertible_v<T, std::string> && !detail::has_std_to_string_v<T> && !detail::has_to_string_v<T> && detail::has_ostr_v<T>, int> = 0>
-    std::string str(const T & t)
-    {
-        std::ostringstream os;
-        os<<t;
-        return os.str();
-    }
+        /// @param precision Digits after the decimal point for floating point
+        /// types, or negative for the shortest representation. Ignored for integers
+        /// @returns Maximum size of a formatted \c T
+        template <typename T>
+        constexpr std::size_t max_number_size(int precision)
+        {
+            if constexpr(std::is_floating_point_v<T>)
+            {
+                if(precision < 0)
+                    return std::numeric_limits<T>::max_digits10 + 10; // sign, point, and exponent
+                return std::numeric_limits<T>::max_exponent10 + static_cast<std::size_t>(precision) + 4;
+            }
+            else
+            {
+                return std::numeric_limits<T>::digits10 + 3;
+            }
+        }
 
-    // special conversion for char using std::string's initializer list ctor
-    std::string str(char c)
-    {
-        return {c};
-    }
+        /// Format a number with std::to_chars
+
+        /// Floating point numbers are written with the shortest representation
+        /// that reads back as the same value, or with a fixed number of digits
+        /// after the decimal point
+        /// @param first Start of output
+        /// @param last End of output. max_number_size<T>(precision) characters
+        /// are always enough
+        /// @param value Number to format
+        /// @param precision Digits after the decimal point for floating point
+        /// types, or negative for the shortest representation. Ignored for integers
+        /// @returns End of output, and std::errc::value_too_large if the output did not fit
+        template <typename T>
+        std::to_chars_result format_number(char * first, char * last, T value, int precision)
+        {
+            if constexpr(std::is_floating_point_v<T>)
+            {
+                if(precision >= 0)
+                    return std::to_chars(first, last, value, std::chars_format::fixed, precision);
+            }
+            return std::to_chars(first, last, value);
+        }
 
-    /// Parses CSV data
+        /// @returns \c true if \c c may appear in a number written by format_number()
+        inline bool is_number_char(char c)
+        {
+            return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e'
+                || c == 'i' || c == 'n' || c == 'f' || c == 'a'; // inf and nan
+        }
 
-    /// By default, parses according to RFC 4180 rules, and throws a Parse_error
-    /// when given non-conformant input. The field delimiter and quote
-    /// characters may be changed, and there is a lenient parsing option to ignore
-    /// violations.
-    ///
-    /// Blank rows are ignored and skipped over.
-    ///
-    /// Most methods operate on rows, but some read field-by-field. Mixing
-    /// row-wise and field-wise methods is not recommended, but is possible.
-    /// Row-wise methods will act as if the current position is the start of a
-    /// row, regardless of any fields that have been read from the current row so
-    /// far.
-    class Reader
-    {
-    public:
-        /// Represents a single row of CSV data
+        /// Convert a field to a number without a std::istream
 
-        /// A Row may be obtained from Reader::get_row or Reader::Iterator
-        /// @warning Reader object must not be destroyed or read from during Row lifetime
-        class Row
+        /// Only succeeds for fields that std::istream would also parse to the
+        /// same value. Anything else (leading whitespace or '+', out of range
+        /// values, negative unsigned values, etc.) should be converted by
+        /// std::istream, as before, for consistent results
+        /// @param field Field to convert
+        /// @returns Converted field, or \c std::nullopt if the field should be converted with std::istream
+        template <typename T>
+        std::optional<T> from_chars(std::string_view field)
         {
-        public:
-            /// Iterates over the fields within a Row
-
-            /// @tparam T Type to convert fields to. Defaults to std::string
-            template <typename T = std::string> class Iterator
+            if constexpr(std::is_same_v<T, bool>)
             {
-            public:
-                using value_type        = T;
-                using difference_type   = std::ptrdiff_t;
-                using pointer           = const T*;
-                using reference         = const T&;
-                using iterator_category = std::input_iterator_tag;
-
-                /// Empty constructor
-
-                /// Denotes the end of iteration
-                Iterator(): row_{nullptr} {}
+                if(field == "0")
+                    return false;
+                else if(field == "1")
+                    return true;
+                return std::nullopt;
+            }
+            else
+            {
+                static_assert(has_from_chars_v<T>);
 
-                /// Creates an iterator from a Row, and parses the first field
+                T value{};
+                auto end = std::data(field) + std::size(field);
+                if(auto [ptr, ec] = std::from_chars(std::data(field), end, value); ec != std::errc{} || ptr != end)
+                    return std::nullopt;
 
-                /// @param row Row to iterate over.
-                /// @warning \c row must not be destroyed or read from during iteration
-                /// @throws Parse_error if error parsing first field (*only when not parsing in lenient mode*)
-                /// @throws IO_error if error reading CSV data
-                /// @throws Type_conversion_error if error converting to type T. Caller may call this again with a different type to try again
-                explicit Iterator(Reader::Row & row): row_{&row}
+                if constexpr(std::is_floating_point_v<T>)
                 {
-                    ++*this;
+                    // std::istream does not accept infinity or NaN
+                    if(!std::isfinite(value))
+                        return std::nullopt;
                 }
 
-                /// @returns Current field
-                const T & operator*() const { return obj_; }
-
-                /// @returns Pointer to current field
-                const T * operator->() const { return &obj_; }
+                return value;
+            }
+        }
 
-                /// Parse and iterate to next field
+        /// Convert a field to a non-string type
 
-                /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
-                /// @throws IO_error if error reading CSV data
-                /// @throws Type_conversion_error if error converting to type T. Caller may call this again with a different type to try again
-                Iterator & operator++()
-                {
-                    assert(row_);
+        /// Tries from_chars first, falling back to std::istream
+        /// @param field Field to convert
+        /// @returns Converted field, or \c std::nullopt if the field could not be converted
+        template <typename T>
+        std::optional<T> convert(std::string_view field)
+        {
+            if constexpr(has_from_chars_v<T> || std::is_same_v<T, bool>)
+            {
+                if(auto field_val = from_chars<T>(field); field_val)
+                    return field_val;
+            }
 
-                    if(end_of_row_)
-                    {
-                        row_ = nullptr;
-                    }
-                    else
-                    {
-                        obj_ = row_->read_field<T>();
+            T field_val{};
+            std::istringstream convert(std::string{field});
+            convert>>field_val;
+            if(!convert || convert.peek() != std::istream::traits_type::eof())
+                return std::nullopt;
 
-                        if(row_->end_of_row())
-                            end_of_row_ = true;
-                    }
+            return field_val;
+        }
 
-                    return *this;
-                }
+        // Structural character search. The parser only needs to look at the
+        // delimiter, quote, CR, and LF characters individually. Runs of anything
+        // else are ordinary field data, and can be skipped over in bulk. The
+        // Writer uses the same search to find fields that need quoting
 
-                /// Compare to another Reader::Row::Iterator
-                bool equals(const Iterator<T> & rhs) const
-                {
-                    return row_ == rhs.row_;
-                }
+        /// Find next structural character
 
-            private:
-                Reader::Row * row_; ///< Pointer to parent Row object, or \c nullptr if past end of row
-                T obj_{}; ///< Storage for current field
-                bool end_of_row_ = false; ///< Keeps track of when the Row has hit end-of-row
-            };
+        /// Dispatches to a SIMD implementation when supported by the CPU. The
+        /// implementations are shared with the C library, in simd.h
+        /// @param begin Start of data to search
+        /// @param end End of data to search
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @returns Pointer to first delimiter, quote, CR, or LF in [begin, end), or end if none found
+        inline const char * find_structural(const char * begin, const char * end, char delimiter, char quote)
+        {
+            static const CSV_find_structural_fun impl = CSV_select_find_structural();
+            return impl(begin, end, delimiter, quote);
+        }
 
-            /// Helper class for iterating over a Row. Use Row::range to obtain
+        // Structural index. For input that is entirely in memory, structural
+        // characters are located ahead of the parser 64 bytes at a time, using
+        // bitmasks. Quoted regions are found with a prefix-XOR of the quote
+        // mask, so delimiters and newlines inside them can be masked out
 
-            /// @tparam T Type to convert fields to. Defaults to std::string
-            template<typename T = std::string>
-            class Range
-            {
-            public:
-                /// @returns Iterator to current field in row
-                Row::Iterator<T> begin()
-                {
-                    return Row::Iterator<T>{row_};
-                }
+        /// Character class bitmasks for a 64 byte block. Bit \c i corresponds to byte \c i
+        struct Block_masks
+        {
+            std::uint64_t quote { 0 };     ///< Quote characters
+            std::uint64_t delimiter { 0 }; ///< Delimiter characters
+            std::uint64_t newline { 0 };   ///< CR and LF characters
+        };
 
-                /// @returns Iterator to end of row
-                Row::Iterator<T> end()
-                {
-                    return Row::Iterator<T>{};
-                }
-            private:
-                friend Row;
-                explicit Range(Row & row):row_{row} {} ///< Construct a Range. Only for use by Row::range
-                Row & row_; ///< Ref to parent Row object
-            };
+        /// Classify a block one byte at a time
 
-            /// @tparam T Type to convert fields to. Defaults to std::string
-            /// @returns Iterator to current field in row
-            template<typename T = std::string>
-            Row::Iterator<T> begin()
+        /// @param block Start of block
+        /// @param size Number of bytes in block. May be less than 64 at end of input
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @returns Character class bitmasks for block
+        inline Block_masks block_masks_scalar(const char * block, std::size_t size, char delimiter, char quote)
+        {
+            Block_masks masks;
+            for(std::size_t i = 0; i < size; ++i)
             {
-                return Row::Iterator<T>{*this};
+                auto bit = std::uint64_t{1} << i;
+                if(auto c = block[i]; c == quote)
+                    masks.quote |= bit;
+                else if(c == delimiter)
+                    masks.delimiter |= bit;
+                else if(c == '\r' || c == '\n')
+                    masks.newline |= bit;
             }
+            return masks;
+        }
 
-            /// @tparam T Type to convert fields to. Defaults to std::string
-            /// @returns Iterator to end of row
-            template<typename T = std::string>
-            Row::Iterator<T> end()
-            {
-                return Row::Iterator<T>{};
-            }
+#ifdef CSVPP_HAS_X86_SIMD
+        /// @returns Bitmask of bytes in 64 byte block equal to \c c
+        __attribute__((target("sse2")))
+        inline std::uint64_t eq_mask_sse2(const __m128i (&block)[4], char c)
+        {
+            const auto c_v = _mm_set1_epi8(c);
+            std::uint64_t mask = 0;
+            for(int i = 0; i < 4; ++i)
+                mask |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block[i], c_v)))) << (16 * i);
+            return mask;
+        }
 
-            /// Range helper
+        /// Classify a block 16 bytes at a time using SSE2
 
-            /// Useful when iterating over a row and converting to a specific type
-            /// @tparam T Type to convert fields to. Defaults to std::string
-            /// @returns A Range object containing begin and end methods corresponding to this Row
-            template<typename T = std::string>
-            Range<T> range()
-            {
-                return Range<T>{*this};
-            }
+        /// @param block Start of block. Must have 64 readable bytes
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @returns Character class bitmasks for block
+        __attribute__((target("sse2")))
+        inline Block_masks block_masks_sse2(const char * block, char delimiter, char quote)
+        {
+            const __m128i data[4] = {
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(block)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 16)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 32)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 48))
+            };
+            return {eq_mask_sse2(data, quote), eq_mask_sse2(data, delimiter), eq_mask_sse2(data, '\r') | eq_mask_sse2(data, '\n')};
+        }
 
-            /// Read a single field from the row
+        /// @returns Bitmask of bytes in 64 byte block equal to \c c
+        __attribute__((target("avx2")))
+        inline std::uint64_t eq_mask_avx2(__m256i lo, __m256i hi, char c)
+        {
+            const auto c_v = _mm256_set1_epi8(c);
+            return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, c_v)))
+                | static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, c_v)))) << 32;
+        }
 
-            /// @tparam T Type to convert fields to. Defaults to std::string
-            /// @returns The next field from the row, or a default-initialized object if past the end of the row
-            /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
-            /// @throws IO_error if error reading CSV data
-            /// @throws Type_conversion_error if error converting to type T. Caller may call this again with a different type to try again
-            template<typename T = std::string>
-            T read_field()
-            {
-                assert(reader_);
+        /// Classify a block 32 bytes at a time using AVX2
 
-                if(end_of_row_)
-                {
-                    past_end_of_row_ = true;
-                    return T{};
-                }
+        /// @copydetails block_masks_sse2
+        __attribute__((target("avx2")))
+        inline Block_masks block_masks_avx2(const char * block, char delimiter, char quote)
+        {
+            auto lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+            auto hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + 32));
+            return {eq_mask_avx2(lo, hi, quote), eq_mask_avx2(lo, hi, delimiter), eq_mask_avx2(lo, hi, '\r') | eq_mask_avx2(lo, hi, '\n')};
+        }
+#endif
 
-                auto field = reader_->read_field<T>();
+        /// Find structural characters in a block
 
-                if(reader_->end_of_row())
-                    end_of_row_ = true;
+        /// @param masks Character class bitmasks for block
+        /// @param[in,out] quote_carry All ones if block starts inside a quoted
+        /// region, otherwise 0. Updated for the following block
+        /// @returns Bitmask of all quotes, and delimiters and newlines outside of quoted regions
+        inline std::uint64_t structural_mask(const Block_masks & masks, std::uint64_t & quote_carry)
+        {
+            // prefix-XOR: each bit becomes the parity of the quotes up to and including it
+            auto in_quote = masks.quote;
+            in_quote ^= in_quote << 1;
+            in_quote ^= in_quote << 2;
+            in_quote ^= in_quote << 4;
+            in_quote ^= in_quote << 8;
+            in_quote ^= in_quote << 16;
+            in_quote ^= in_quote << 32;
+            in_quote ^= quote_carry;
+
+            quote_carry = std::uint64_t{0} - (in_quote >> 63);
+
+            return ((masks.delimiter | masks.newline) & ~in_quote) | masks.quote;
+        }
 
-                return field;
-            }
+        /// @returns Index of lowest set bit in \c mask, which must not be 0
+        inline int count_trailing_zeros(std::uint64_t mask)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return __builtin_ctzll(mask);
+#else
+            int count = 0;
+            for(; (mask & 1) == 0; mask >>= 1)
+                ++count;
+            return count;
+#endif
+        }
 
-            /// Read a single field from the row
+        /// Append positions of set bits to an index
 
-            /// @param[out] data Variable to to write field to. Will store a
-            ///                  default initialized object if past the end of the row
-            /// @returns This Row object
-            /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
-            /// @throws IO_error if error reading CSV data
-            /// @throws Type_conversion_error if error converting to type T. Caller may call this again with a different type to try again
-            template<typename T>
-            Row & operator>>(T & data)
+        /// @param mask Structural bitmask for block
+        /// @param offset Offset of block
+        /// @param positions Output position array
+        /// @returns Pointer past last position written
+        inline std::uint32_t * append_positions(std::uint64_t mask, std::uint32_t offset, std::uint32_t * positions)
+        {
+            for(; mask != 0; mask &= mask - 1)
+                *positions++ = offset + static_cast<std::uint32_t>(count_trailing_zeros(mask));
+            return positions;
+        }
+
+        /// Index whole blocks, one byte at a time
+
+        /// @param begin Start of input
+        /// @param blocks Number of 64 byte blocks to index
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @param[in,out] quote_carry Quote state, as in structural_mask
+        /// @param positions Output position array. Must have room for 64 positions per block
+        /// @returns Pointer past last position written
+        inline std::uint32_t * index_blocks_scalar(const char * begin, std::size_t blocks, char delimiter, char quote, std::uint64_t & quote_carry, std::uint32_t * positions)
+        {
+            for(std::size_t i = 0; i < blocks; ++i)
+                positions = append_positions(structural_mask(block_masks_scalar(begin + 64 * i, 64, delimiter, quote), quote_carry), static_cast<std::uint32_t>(64 * i), positions);
+            return positions;
+        }
+
+#ifdef CSVPP_HAS_X86_SIMD
+        /// Index whole blocks using SSE2
+
+        /// @copydetails index_blocks_scalar
+        __attribute__((target("sse2")))
+        inline std::uint32_t * index_blocks_sse2(const char * begin, std::size_t blocks, char delimiter, char quote, std::uint64_t & quote_carry, std::uint32_t * positions)
+        {
+            for(std::size_t i = 0; i < blocks; ++i)
+                positions = append_positions(structural_mask(block_masks_sse2(begin + 64 * i, delimiter, quote), quote_carry), static_cast<std::uint32_t>(64 * i), positions);
+            return positions;
+        }
+
+        /// Index whole blocks using AVX2
+
+        /// @copydetails index_blocks_scalar
+        __attribute__((target("avx2")))
+        inline std::uint32_t * index_blocks_avx2(const char * begin, std::size_t blocks, char delimiter, char quote, std::uint64_t & quote_carry, std::uint32_t * positions)
+        {
+            for(std::size_t i = 0; i < blocks; ++i)
+                positions = append_positions(structural_mask(block_masks_avx2(begin + 64 * i, delimiter, quote), quote_carry), static_cast<std::uint32_t>(64 * i), positions);
+            return positions;
+        }
+#endif
+
+        /// Signature shared by index_blocks implementations
+        using Index_blocks_fun = std::uint32_t * (*)(const char *, std::size_t, char, char, std::uint64_t &, std::uint32_t *);
+
+        /// Select the fastest index_blocks implementation the CPU supports
+        inline Index_blocks_fun select_index_blocks()
+        {
+#ifdef CSVPP_HAS_X86_SIMD
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx2"))
+                return index_blocks_avx2;
+            if(__builtin_cpu_supports("sse2"))
+                return index_blocks_sse2;
+#endif
+            return index_blocks_scalar;
+        }
+
+        /// Index of structural character positions in in-memory input
+
+        /// Built incrementally in windows ahead of the parser. Quote positions
+        /// are always included, so the parser can check that each one is where
+        /// a well-formed field would put it. If not, the parser must handle
+        /// that field itself, then reset() the index
+        class Structural_index
+        {
+        public:
+            /// Restart indexing
+
+            /// @param pos Position to start indexing from. Must not be inside a quoted field
+            void reset(const char * pos)
             {
-                data = read_field<T>();
-                return * this;
+                base_ = end_ = pos;
+                cursor_ = size_ = 0;
+                quote_carry_ = 0;
+                window_ = min_window;
             }
 
-            /// Reads row into an output iterator
-
-            /// @tparam T Type to convert fields to. Defaults to std::string
-            /// @param it an output iterator to receive the row data
-            /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
-            /// @throws IO_error if error reading CSV data
-            /// @throws Type_conversion_error if error converting to type T
-            template<typename T = std::string, typename OutputIter>
-            void read(OutputIter it)
+            /// Find next structural character
+
+            /// Delimiters and newlines inside quoted fields are skipped
+            /// @param from Position to search from. Must not be before the
+            /// position passed to the last call
+            /// @param input_end End of input
+            /// @param delimiter Delimiter character
+            /// @param quote Quote character
+            /// @returns Pointer to the first structural character at or after
+            /// \c from, or \c input_end if there are none
+            const char * next(const char * from, const char * input_end, char delimiter, char quote)
             {
-                std::copy(begin<T>(), end<T>(), it);
+                while(true)
+                {
+                    for(; cursor_ < size_; ++cursor_)
+                    {
+                        if(auto pos = base_ + positions_[cursor_]; pos >= from)
+                            return pos;
+                    }
+
+                    if(end_ == input_end)
+                        return input_end;
+
+                    build(input_end, delimiter, quote);
+                }
             }
 
-            /// Reads row into a std::vector
+        private:
+            /// Index the next window of input
 
-            /// @tparam T Type to convert fields to. Defaults to std::string
-            /// @returns std::vector containing the fields from the Row
-            /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
-            /// @throws IO_error if error reading CSV data
-            /// @throws Type_conversion_error if error converting to type T
-            template<typename T = std::string>
-            std::vector<T> read_vec()
+            /// Windows start small, so a parser that has to reset often does
+            /// not waste much work, and grow while the index stays in use
+            void build(const char * input_end, char delimiter, char quote)
             {
-                std::vector<T> vec;
-                std::copy(begin<T>(), end<T>(), std::back_inserter(vec));
-                return vec;
+                static const Index_blocks_fun index_blocks = select_index_blocks();
+
+                if(!positions_)
+                    positions_.reset(new std::uint32_t[max_window]); // no need to zero-fill
+
+                base_ = end_;
+                auto remaining = static_cast<std::size_t>(input_end - base_);
+                auto blocks = std::min(remaining, window_) / 64;
+
+                auto positions_end = index_blocks(base_, blocks, delimiter, quote, quote_carry_, positions_.get());
+                end_ = base_ + 64 * blocks;
+
+                // last partial block at end of input
+                if(remaining <= window_)
+                {
+                    positions_end = append_positions(structural_mask(block_masks_scalar(end_, static_cast<std::size_t>(input_end - end_), delimiter, quote), quote_carry_),
+                            static_cast<std::uint32_t>(64 * blocks), positions_end);
+                    end_ = input_end;
+                }
+
+                cursor_ = 0;
+                size_ = static_cast<std::size_t>(positions_end - positions_.get());
+                window_ = std::min(2 * window_, max_window);
             }
 
-            /// Reads row into a tuple
+            static constexpr std::size_t min_window = 1024;      ///< Initial window size, in bytes. Multiple of 64
+            static constexpr std::size_t max_window = 64 * 1024; ///< Maximum window size, in bytes. Multiple of 64
 
-            /// @tparam Args types to convert fields to
-            /// @returns std::tuple containing the fields from the Row.
-            /// If Args contains more elements than there are fields in the row,
-            /// the remaining elements of the tuple will be default initialized
-            /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
-            /// @throws IO_error if error reading CSV data
-            /// @throws Type_conversion_error if error converting to specified types
-            template <typename ... Args>
-            std::tuple<Args...> read_tuple()
+            std::unique_ptr<std::uint32_t[]> positions_; ///< Structural character offsets from base_. Has room for max_window positions
+            std::size_t cursor_ { 0 };                   ///< Index into positions_ of next unread position
+            std::size_t size_ { 0 };                     ///< Number of valid positions in positions_
+            const char * base_ { nullptr };              ///< Start of indexed window
+            const char * end_ { nullptr };               ///< End of indexed window
+            std::uint64_t quote_carry_ { 0 };            ///< Quote state at end_. See structural_mask
+            std::size_t window_ { min_window };          ///< Size of next window
+        };
+
+        /// Input source for Reader
+
+        /// Provides blocks of raw CSV data to Reader's input buffer
+        class Input_source
+        {
+        public:
+            virtual ~Input_source() = default;
+
+            /// Read a block of data
+
+            /// @param data Buffer to read into
+            /// @param size Maximum number of bytes to read
+            /// @returns Number of bytes read. Returns 0 only at end of input
+            /// @throws IO_error if there is an error reading
+            virtual std::size_t read(char * data, std::size_t size) = 0;
+
+            /// Access in-memory input
+
+            /// Sources that already hold the entire input in memory return it
+            /// here, allowing Reader to parse it in place instead of copying it
+            /// through read()
+            /// @returns Pointer to start of input, or \c nullptr if not in memory
+            virtual const char * contents() const { return nullptr; }
+
+            /// @returns Size of data returned by contents()
+            virtual std::size_t contents_size() const { return 0; }
+
+            /// Move to a position in the input
+
+            /// Not used for in-memory input
+            /// @param offset Byte offset to read from next
+            /// @returns \c false if the input can not be repositioned
+            virtual bool seek(std::uint64_t offset) { (void)offset; return false; }
+        };
+
+        /// Reads blocks from a std::istream
+        class Stream_source final: public Input_source
+        {
+        public:
+            /// @param input_stream std::istream to read from
+            explicit Stream_source(std::istream & input_stream): input_stream_{&input_stream} {}
+
+            /// @param input_stream std::istream to read from. Ownership is taken
+            explicit Stream_source(std::unique_ptr<std::istream> input_stream):
+                internal_input_stream_{std::move(input_stream)},
+                input_stream_{internal_input_stream_.get()}
+            {}
+
+            std::size_t read(char * data, std::size_t size) override
             {
-                std::tuple<Args...> ret;
-                read_tuple_helper(ret, std::index_sequence_for<Args...>{});
-                return ret;
-            }
+                input_stream_->read(data, static_cast<std::streamsize>(size));
+                if(input_stream_->bad() && !input_stream_->eof())
+                    throw IO_error{"Error reading from input", errno};
 
-            /// Reads row into variadic arguments
+                return static_cast<std::size_t>(input_stream_->gcount());
+            }
 
-            /// @param[out] data Variables to read into.
-            /// If more parameters are passed than there are fields in the row,
-            /// the remaining parameters will be default initialized
-            /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
-            /// @throws IO_error if error reading CSV data
-            /// @throws Type_conversion_error if error converting to specified types
-            template <typename ... Data>
-            void read_v(Data & ... data)
+            bool seek(std::uint64_t offset) override
             {
-                (void)(*this >> ... >> data);
+                input_stream_->clear();
+                return static_cast<bool>(input_stream_->seekg(static_cast<std::streamoff>(offset)));
             }
 
-            /// @returns \c true if the last field in the row has been read
-            bool end_of_row() const { return end_of_row_; }
+        private:
+            std::unique_ptr<std::istream> internal_input_stream_; ///< Owns the istream, if given ownership
+            std::istream * input_stream_;                         ///< Points to input istream
+        };
 
-            /// @returns \c true if more fields can be read
-            operator bool() { return reader_ && !past_end_of_row_; }
+        /// Parses a string in place
+        class String_source final: public Input_source
+        {
+        public:
+            /// @param input_data CSV data. A copy is stored
+            explicit String_source(std::string input_data): input_data_{std::move(input_data)} {}
+
+            std::size_t read(char *, std::size_t) override { return 0; }
+            const char * contents() const override { return std::data(input_data_); }
+            std::size_t contents_size() const override { return std::size(input_data_); }
 
         private:
-            friend Reader;
+            std::string input_data_; ///< Copy of input data
+        };
 
-            /// Helper function for read_tuple
+        /// Parses memory owned by the caller in place
+        class Memory_source final: public Input_source
+        {
+        public:
+            /// @param data CSV data. Must remain valid for the lifetime of this object
+            /// @param size Size of data
+            Memory_source(const char * data, std::size_t size): data_{data}, size_{size} {}
 
-            /// Uses a std::index_sequence to generate indexes for std::get
-            /// @param t tuple to load data into
-            template <typename Tuple, std::size_t ... Is>
-            void read_tuple_helper(Tuple & t, std::index_sequence<Is...>)
+            std::size_t read(char *, std::size_t) override { return 0; }
+            const char * contents() const override { return data_; }
+            std::size_t contents_size() const override { return size_; }
+
+        private:
+            const char * data_; ///< Start of input data
+            std::size_t size_;  ///< Size of input data
+        };
+
+#ifdef CSVPP_HAS_MMAP
+        /// Memory-maps a regular file, so it can be parsed in place
+        class Mapped_file_source final: public Input_source
+        {
+        public:
+            /// Open and map a file
+
+            /// @param filename Path to file
+            /// @returns Mapped file, or \c nullptr if the file is not a regular
+            /// file or could not be mapped. Caller should fall back to reading
+            /// it as a stream
+            /// @throws IO_error if the file could not be opened
+            static std::unique_ptr<Mapped_file_source> open(const std::string & filename)
             {
-                ((*this >> std::get<Is>(t)), ...);
+                int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+                if(fd < 0)
+                    throw IO_error("Could not open file '" + filename + "'", errno);
+
+                std::unique_ptr<Mapped_file_source> source;
+
+                struct stat st;
+                if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+                {
+                    auto size = static_cast<std::size_t>(st.st_size);
+                    if(size == 0)
+                    {
+                        source.reset(new Mapped_file_source{nullptr, 0});
+                    }
+                    else if(auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0); data != MAP_FAILED)
+                    {
+                        madvise(data, size, MADV_SEQUENTIAL);
+                        source.reset(new Mapped_file_source{static_cast<const char *>(data), size});
+                    }
+                }
+
+                ::close(fd);
+                return source;
             }
 
-            /// Empty constructor
+            ~Mapped_file_source() override
+            {
+                if(size_ > 0)
+                    munmap(const_cast<char *>(data_), size_);
+            }
 
-            /// Used to denote that no rows remain
-            Row(): reader_{nullptr} {}
+            Mapped_file_source(const Mapped_file_source &) = delete;
+            Mapped_file_source & operator=(const Mapped_file_source &) = delete;
 
-            /// Construct a Row from a Reader
+            std::size_t read(char *, std::size_t) override { return 0; }
+            const char * contents() const override { return data_; }
+            std::size_t contents_size() const override { return size_; }
 
-            /// For use by Reader::get_row only
-            explicit Row(Reader & reader): reader_{&reader} {}
+        private:
+            /// @param data Mapped file contents, or \c nullptr for an empty file
+            /// @param size Size of mapping
+            Mapped_file_source(const char * data, std::size_t size): data_{data ? data : ""}, size_{size} {}
 
-            Reader * reader_ { nullptr }; ///< Pointer to parent Reader object or nullptr if no rows remain
-            bool end_of_row_ { false }; ///< Tracks if the end of the current row has been reacehd
-            bool past_end_of_row_ { false }; ///< Tracks if past the end of the row, and prevents reading from the next row
+            const char * data_; ///< Start of mapping
+            std::size_t size_;  ///< Size of mapping
         };
+#endif
 
-        /// Iterates over Rows in CSV data
-        class Iterator
+#ifdef CSVPP_HAS_URING
+        /// Settings for Uring_file_source
+
+        /// Only changed by tests, to read small files in many blocks
+        struct Uring_settings
         {
-        public:
-            using value_type        = Row;
-            using difference_type   = std::ptrdiff_t;
-            using pointer           = const value_type*;
-            using reference         = const value_type&;
-            using iterator_category = std::input_iterator_tag;
+            std::size_t block_size { CSV_URING_BLOCK_SIZE }; ///< Size of each read
+            unsigned depth { CSV_URING_DEPTH };             ///< Number of reads to keep in flight
+            bool use_ring { true };                         ///< Use io_uring where available. Otherwise always read with pread
+        };
 
-            /// Empty constructor
+        /// Settings for files opened after they are changed
+        inline Uring_settings uring_settings;
 
-            /// Denotes the end of iteration
-            Iterator(): reader_{nullptr} {}
+        /// Reads a regular file in large blocks, with several reads in flight
 
-            /// Creates an iterator from a Reader object
+        /// Uses io_uring where the kernel supports and permits it, otherwise
+        /// pread. Only available when built with \c CSVPP_USE_IO_URING
+        class Uring_file_source final: public Input_source
+        {
+        public:
+            /// Open a file
 
-            /// @param r Reader object to iterate over
-            /// @warning \c r must not be destroyed or read from during iteration
-            explicit Iterator(Reader & r): reader_{&r}
+            /// @param filename Path to file
+            /// @returns File source, or \c nullptr if the file is not a regular
+            /// file. Caller should fall back to reading it as a stream
+            /// @throws IO_error if the file could not be opened
+            static std::unique_ptr<Uring_file_source> open(const std::string & filename)
             {
-                obj_ = reader_->get_row();
+                int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+                if(fd < 0)
+                    throw IO_error("Could not open file '" + filename + "'", errno);
 
-                if(!*reader_)
-                    reader_ = nullptr;
+                struct stat st;
+                if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+                {
+                    ::close(fd);
+                    return nullptr;
+                }
+
+                return std::unique_ptr<Uring_file_source>{new Uring_file_source{fd}};
             }
 
-            /// @returns Current row
-            const value_type & operator*() const { return obj_; }
+            ~Uring_file_source() override
+            {
+                CSV_uring_free(&uring_);
+                ::close(fd_);
+            }
 
-            /// @returns Current row
-            value_type & operator*() { return obj_; }
+            Uring_file_source(const Uring_file_source &) = delete;
+            Uring_file_source & operator=(const Uring_file_source &) = delete;
 
-            /// @returns Pointer to current row
-            const value_type * operator->() const { return &obj_; }
+            std::size_t read(char * data, std::size_t size) override
+            {
+                if(block_pos_ == block_end_)
+                {
+                    auto block_size = CSV_uring_next(&uring_, &block_pos_);
+                    if(block_size < 0)
+                        throw IO_error{"Error reading from input", errno};
+                    block_end_ = block_pos_ + block_size;
+                }
 
-            /// @returns pointer to current row
-            value_type * operator->() { return &obj_; }
+                auto read_size = std::min(size, static_cast<std::size_t>(block_end_ - block_pos_));
+                std::memcpy(data, block_pos_, read_size);
+                block_pos_ += read_size;
+                return read_size;
+            }
 
-            /// Iterate to next Row
-            Iterator & operator++()
+            bool seek(std::uint64_t offset) override
             {
-                // discard any remaining fields
-                while(!obj_.end_of_row())
-                    obj_.read_field();
+                block_pos_ = block_end_ = nullptr;
+                return CSV_uring_seek(&uring_, offset);
+            }
 
-                assert(reader_);
-                obj_ = reader_->get_row();
+        private:
+            /// @param fd Open file. Ownership is taken, and it is closed if this throws
+            /// @throws std::bad_alloc if the read buffers could not be allocated
+            explicit Uring_file_source(int fd): fd_{fd}
+            {
+                if(!CSV_uring_init(&uring_, fd, 0, uring_settings.block_size, uring_settings.depth))
+                {
+                    ::close(fd);
+                    throw std::bad_alloc{};
+                }
 
-                if(!*reader_)
-                    reader_ = nullptr;
+                if(!uring_settings.use_ring)
+                    CSV_uring_use_pread(&uring_);
+            }
 
-                return *this;
+            int fd_;                             ///< Open file
+            CSV_uring uring_;                    ///< Block reader
+            const char * block_pos_ { nullptr }; ///< Next unread character of current block
+            const char * block_end_ { nullptr }; ///< End of current block
+        };
+#endif
+
+        /// Replays bytes already read from another source, then continues reading from it
+        class Prefix_source final: public Input_source
+        {
+        public:
+            /// @param prefix Bytes read from \c source
+            /// @param source Source to continue reading from
+            Prefix_source(std::string prefix, std::unique_ptr<Input_source> source):
+                prefix_{std::move(prefix)},
+                source_{std::move(source)}
+            {}
+
+            std::size_t read(char * data, std::size_t size) override
+            {
+                if(prefix_pos_ == std::size(prefix_))
+                    return source_->read(data, size);
+
+                auto read_size = prefix_.copy(data, size, prefix_pos_);
+                prefix_pos_ += read_size;
+                return read_size;
+            }
+
+            bool seek(std::uint64_t offset) override
+            {
+                prefix_pos_ = std::size(prefix_);
+                return source_->seek(offset);
             }
 
-            /// Compare to another Reader::Iterator
-            bool equals(const Iterator & rhs) const
-            {
-                return reader_ == rhs.reader_;
+        private:
+            std::string prefix_;                   ///< Bytes read from source_
+            std::size_t prefix_pos_ { 0 };         ///< Next byte of prefix_ to read
+            std::unique_ptr<Input_source> source_; ///< Source to continue reading from
+        };
+
+        /// Holds compressed input for a decompressing source
+        class Compressed_input
+        {
+        public:
+            /// @param source Source of compressed data
+            explicit Compressed_input(std::unique_ptr<Input_source> source): source_{std::move(source)}
+            {
+                if(auto contents = source_->contents(); contents)
+                {
+                    pos_ = contents;
+                    end_ = contents + source_->contents_size();
+                    in_memory_ = true;
+                }
+            }
+
+            /// Read more compressed data, once all current data has been used
+
+            /// @returns \c false at end of input
+            bool refill()
+            {
+                if(in_memory_)
+                    return false;
+
+                if(!buffer_)
+                    buffer_ = std::make_unique<char[]>(buffer_size);
+
+                pos_ = buffer_.get();
+                end_ = pos_ + source_->read(buffer_.get(), buffer_size);
+                return pos_ != end_;
+            }
+
+            const char * pos_ { nullptr }; ///< Next unused compressed byte
+            const char * end_ { nullptr }; ///< End of available compressed data
+
+        private:
+            static constexpr std::size_t buffer_size = 64 * 1024;
+
+            std::unique_ptr<Input_source> source_; ///< Source of compressed data
+            std::unique_ptr<char[]> buffer_;       ///< Buffer for compressed data, if not in memory
+            bool in_memory_ { false };             ///< All compressed data is held by source_
+        };
+
+#ifdef CSVPP_USE_ZLIB
+        /// Decompresses gzip or zlib input
+
+        /// Concatenated gzip members are read as one stream
+        class Gzip_source final: public Input_source
+        {
+        public:
+            /// @param source Source of compressed data
+            /// @throws IO_error if the decompressor could not be initialized
+            explicit Gzip_source(std::unique_ptr<Input_source> source): input_{std::move(source)}
+            {
+                // +32 detects a gzip or zlib header
+                if(inflateInit2(&stream_, 15 + 32) != Z_OK)
+                    throw IO_error{"Could not initialize gzip decompression", ENOMEM};
+            }
+
+            ~Gzip_source() override { inflateEnd(&stream_); }
+
+            Gzip_source(const Gzip_source &) = delete;
+            Gzip_source & operator=(const Gzip_source &) = delete;
+
+            std::size_t read(char * data, std::size_t size) override
+            {
+                auto out_size = static_cast<uInt>(std::min<std::size_t>(size, std::numeric_limits<uInt>::max()));
+                stream_.next_out = reinterpret_cast<Bytef *>(data);
+                stream_.avail_out = out_size;
+
+                while(stream_.avail_out == out_size)
+                {
+                    // decompressed data may be pending from the last read, even with no input left
+                    if(input_.pos_ == input_.end_ && !pending_ && !input_.refill())
+                    {
+                        if(in_member_)
+                            throw IO_error{"Truncated gzip input", EIO};
+                        break;
+                    }
+
+                    auto in_size = static_cast<uInt>(std::min<std::size_t>(input_.end_ - input_.pos_, std::numeric_limits<uInt>::max()));
+                    stream_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input_.pos_));
+                    stream_.avail_in = in_size;
+
+                    auto ret = inflate(&stream_, Z_NO_FLUSH);
+                    input_.pos_ += in_size - stream_.avail_in;
+                    pending_ = stream_.avail_out == 0;
+
+                    if(ret == Z_STREAM_END)
+                    {
+                        // another member may follow
+                        in_member_ = false;
+                        inflateReset(&stream_);
+                    }
+                    else if(ret == Z_OK)
+                        in_member_ = true;
+                    else if(ret != Z_BUF_ERROR) // no progress
+                        throw IO_error{std::string{"Error decompressing gzip input: "} + (stream_.msg ? stream_.msg : "invalid data"), EIO};
+                }
+
+                return out_size - stream_.avail_out;
+            }
+
+        private:
+            Compressed_input input_;     ///< Compressed data
+            z_stream stream_ {};         ///< zlib state
+            bool in_member_ { false };   ///< Part way through a gzip member
+            bool pending_ { false };     ///< Output filled on last call, so more may be pending
+        };
+#endif
+
+#ifdef CSVPP_USE_ZSTD
+        /// Decompresses Zstandard input
+
+        /// Concatenated frames are read as one stream
+        class Zstd_source final: public Input_source
+        {
+        public:
+            /// @param source Source of compressed data
+            /// @throws IO_error if the decompressor could not be initialized
+            explicit Zstd_source(std::unique_ptr<Input_source> source):
+                input_{std::move(source)},
+                stream_{ZSTD_createDStream()}
+            {
+                if(!stream_ || ZSTD_isError(ZSTD_initDStream(stream_)))
+                {
+                    ZSTD_freeDStream(stream_);
+                    throw IO_error{"Could not initialize zstd decompression", ENOMEM};
+                }
+            }
+
+            ~Zstd_source() override { ZSTD_freeDStream(stream_); }
+
+            Zstd_source(const Zstd_source &) = delete;
+            Zstd_source & operator=(const Zstd_source &) = delete;
+
+            std::size_t read(char * data, std::size_t size) override
+            {
+                ZSTD_outBuffer out {data, size, 0};
+                while(out.pos == 0)
+                {
+                    // decompressed data may be pending from the last read, even with no input left
+                    if(input_.pos_ == input_.end_ && !pending_ && !input_.refill())
+                    {
+                        if(in_frame_)
+                            throw IO_error{"Truncated zstd input", EIO};
+                        break;
+                    }
+
+                    ZSTD_inBuffer in {input_.pos_, static_cast<std::size_t>(input_.end_ - input_.pos_), 0};
+                    auto ret = ZSTD_decompressStream(stream_, &out, &in);
+                    if(ZSTD_isError(ret))
+                        throw IO_error{std::string{"Error decompressing zstd input: "} + ZSTD_getErrorName(ret), EIO};
+
+                    input_.pos_ += in.pos;
+                    pending_ = out.pos == out.size;
+
+                    // with no progress, ret is a hint for the next frame
+                    if(in.pos != 0 || out.pos != 0)
+                        in_frame_ = ret != 0;
+                }
+
+                return out.pos;
+            }
+
+        private:
+            Compressed_input input_;  ///< Compressed data
+            ZSTD_DStream * stream_;   ///< zstd state
+            bool in_frame_ { false }; ///< Part way through a frame
+            bool pending_ { false };  ///< Output filled on last call, so more may be pending
+        };
+#endif
+
+        /// Detect compression format from the first bytes of input
+
+        /// Only formats that are enabled are detected
+        /// @param magic First bytes of input. 4 bytes are needed to detect all formats
+        /// @returns Compression format, or Compression::none if not recognized
+        inline Compression detect_compression([[maybe_unused]] std::string_view magic)
+        {
+#ifdef CSVPP_USE_ZLIB
+            if(magic.compare(0, 2, "\x1f\x8b") == 0)
+                return Compression::gzip;
+#endif
+#ifdef CSVPP_USE_ZSTD
+            // a frame, or a skippable frame such as a seek table
+            if(magic.compare(0, 4, "\x28\xb5\x2f\xfd") == 0 || (std::size(magic) >= 4 && (magic[0] & 0xf0) == 0x50 && magic.compare(1, 3, "\x2a\x4d\x18") == 0))
+                return Compression::zstd;
+#endif
+            return Compression::none;
+        }
+
+        /// Decompress input
+
+        /// @param source Source of input
+        /// @param compression Compression format of input
+        /// @returns Source of decompressed input. \c source itself if not compressed
+        /// @throws IO_error if error reading from \c source, or if \c
+        /// compression is a format that is not enabled
+        inline std::unique_ptr<Input_source> decompress(std::unique_ptr<Input_source> source, Compression compression)
+        {
+#if defined(CSVPP_USE_ZLIB) || defined(CSVPP_USE_ZSTD)
+            if(compression == Compression::detect)
+            {
+                constexpr std::size_t magic_size = 4;
+                std::string magic;
+                if(auto contents = source->contents(); contents)
+                {
+                    magic.assign(contents, std::min(magic_size, source->contents_size()));
+                }
+                else
+                {
+                    // read bytes are replayed by Prefix_source
+                    magic.resize(magic_size);
+                    std::size_t size = 0;
+                    for(std::size_t read_size; size < magic_size && (read_size = source->read(std::data(magic) + size, magic_size - size)) > 0;)
+                        size += read_size;
+                    magic.resize(size);
+
+                    source = std::make_unique<Prefix_source>(magic, std::move(source));
+                }
+
+                compression = detect_compression(magic);
+            }
+#endif
+
+            switch(compression)
+            {
+            case Compression::gzip:
+#ifdef CSVPP_USE_ZLIB
+                return std::make_unique<Gzip_source>(std::move(source));
+#else
+                throw IO_error{"gzip input requires CSVPP_USE_ZLIB", ENOTSUP};
+#endif
+            case Compression::zstd:
+#ifdef CSVPP_USE_ZSTD
+                return std::make_unique<Zstd_source>(std::move(source));
+#else
+                throw IO_error{"zstd input requires CSVPP_USE_ZSTD", ENOTSUP};
+#endif
+            case Compression::detect:
+            case Compression::none:
+                break;
+            }
+            return source;
+        }
+
+        /// Open a file for reading
+
+        /// Regular files are memory-mapped where supported, or read with
+        /// io_uring when built with \c CSVPP_USE_IO_URING. Other files are
+        /// read as a stream
+        /// @param filename Path to file
+        /// @returns Input source for the file
+        /// @throws IO_error if the file could not be opened
+        inline std::unique_ptr<Input_source> open_file(const std::string & filename)
+        {
+            std::unique_ptr<Input_source> source;
+#if defined(CSVPP_HAS_URING)
+            source = Uring_file_source::open(filename);
+#elif defined(CSVPP_HAS_MMAP)
+            source = Mapped_file_source::open(filename);
+#endif
+            if(!source)
+            {
+                auto file = std::make_unique<std::ifstream>(filename, std::ios::binary);
+                if(!(*file))
+                    throw IO_error("Could not open file '" + filename + "'", errno);
+
+                source = std::make_unique<Stream_source>(std::move(file));
+            }
+            return source;
+        }
+
+        /// Restricts another source to a byte range of its input
+        class Range_source final: public Input_source
+        {
+        public:
+            /// @param source Source to read from
+            /// @param begin Offset of start of range
+            /// @param end Offset of end of range. Clamped to the end of in-memory input
+            /// @throws IO_error if \c source can not be positioned at \c begin
+            Range_source(std::unique_ptr<Input_source> source, std::uint64_t begin, std::uint64_t end):
+                source_{std::move(source)}
+            {
+                if(source_->contents())
+                {
+                    auto size = static_cast<std::uint64_t>(source_->contents_size());
+                    begin_ = std::min(begin, size);
+                    end_ = std::clamp(end, begin_, size);
+                }
+                else
+                {
+                    begin_ = begin;
+                    end_ = std::max(begin, end);
+                    if(!seek(0))
+                        throw IO_error("Could not seek in input", ESPIPE);
+                }
+            }
+
+            std::size_t read(char * data, std::size_t size) override
+            {
+                if(remaining_ == 0 || source_->contents())
+                    return 0;
+
+                auto read_size = source_->read(data, static_cast<std::size_t>(std::min<std::uint64_t>(size, remaining_)));
+                remaining_ -= read_size;
+                return read_size;
+            }
+
+            const char * contents() const override
+            {
+                auto contents = source_->contents();
+                return contents ? contents + begin_ : nullptr;
+            }
+
+            std::size_t contents_size() const override { return static_cast<std::size_t>(end_ - begin_); }
+
+            bool seek(std::uint64_t offset) override
+            {
+                if(offset > end_ - begin_ || !source_->seek(begin_ + offset))
+                    return false;
+
+                remaining_ = end_ - begin_ - offset;
+                return true;
+            }
+
+        private:
+            std::unique_ptr<Input_source> source_; ///< Source to read from
+            std::uint64_t begin_ { 0 };            ///< Offset of start of range
+            std::uint64_t end_ { 0 };              ///< Offset of end of range
+            std::uint64_t remaining_ { 0 };        ///< Bytes left to read, for sources not in memory
+        };
+
+        /// Compresses output in independent blocks
+
+        /// gzip output is written as BGZF: a series of gzip members of up to
+        /// 64KiB each, with the member size recorded in its header, followed by
+        /// an empty end-of-file member. zstd output is written as frames of up
+        /// to 1MiB each, followed by a seek table in the zstd seekable format.
+        /// Both can be read by any gzip or zstd decompressor, and their blocks
+        /// can be found and decompressed in parallel by Parallel_reader
+        class Block_compress_buf final: public std::streambuf
+        {
+        public:
+            /// Maximum size of uncompressed data in a BGZF block
+            static constexpr std::size_t gzip_block_size = 0xff00;
+
+            /// Maximum size of uncompressed data in a zstd frame
+            static constexpr std::size_t zstd_block_size = 1024 * 1024;
+
+            /// @param output Stream to write compressed output to
+            /// @param compression Compression format. Must be Compression::gzip or Compression::zstd
+            /// @throws IO_error if \c compression is a format that is not enabled
+            Block_compress_buf(std::ostream & output, Compression compression):
+                output_{output},
+                compression_{compression}
+            {
+                switch(compression_)
+                {
+                case Compression::gzip:
+#ifdef CSVPP_USE_ZLIB
+                    // raw deflate, for a custom gzip header
+                    if(deflateInit2(&zstream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                        throw IO_error{"Could not initialize gzip compression", ENOMEM};
+                    buffer_.resize(gzip_block_size);
+                    break;
+#else
+                    throw IO_error{"gzip output requires CSVPP_USE_ZLIB", ENOTSUP};
+#endif
+                case Compression::zstd:
+#ifdef CSVPP_USE_ZSTD
+                    zstd_ = ZSTD_createCCtx();
+                    if(!zstd_)
+                        throw IO_error{"Could not initialize zstd compression", ENOMEM};
+                    buffer_.resize(zstd_block_size);
+                    break;
+#else
+                    throw IO_error{"zstd output requires CSVPP_USE_ZSTD", ENOTSUP};
+#endif
+                case Compression::detect:
+                case Compression::none:
+                    assert(false);
+                    break;
+                }
+
+                setp(std::data(buffer_), std::data(buffer_) + std::size(buffer_));
+            }
+
+            /// Writes remaining data and the end of the stream. Errors are ignored
+            ~Block_compress_buf() override
+            {
+                finish();
+#ifdef CSVPP_USE_ZLIB
+                if(compression_ == Compression::gzip)
+                    deflateEnd(&zstream_);
+#endif
+#ifdef CSVPP_USE_ZSTD
+                if(compression_ == Compression::zstd)
+                    ZSTD_freeCCtx(zstd_);
+#endif
+            }
+
+            Block_compress_buf(const Block_compress_buf &) = delete;
+            Block_compress_buf & operator=(const Block_compress_buf &) = delete;
+
+            /// Write remaining data and the end of the stream
+
+            /// Nothing more may be written afterwards
+            /// @returns \c false on error
+            bool finish()
+            {
+                if(finished_)
+                    return true;
+                finished_ = true;
+
+                if(!write_block())
+                    return false;
+
+#ifdef CSVPP_USE_ZLIB
+                if(compression_ == Compression::gzip)
+                {
+                    // empty block marking the end of a BGZF file
+                    static constexpr char eof_block[] = "\x1f\x8b\x08\x04\0\0\0\0\0\xff\x06\0BC\x02\0\x1b\0\x03\0\0\0\0\0\0\0\0\0";
+                    output_.write(eof_block, sizeof(eof_block) - 1);
+                }
+#endif
+#ifdef CSVPP_USE_ZSTD
+                if(compression_ == Compression::zstd)
+                {
+                    // skippable frame holding the compressed and decompressed size of each frame
+                    std::string seek_table;
+                    append_le32(seek_table, 0x184D2A5E);
+                    append_le32(seek_table, static_cast<std::uint32_t>(8 * std::size(frames_) + 9));
+                    for(auto [compressed, decompressed]: frames_)
+                    {
+                        append_le32(seek_table, compressed);
+                        append_le32(seek_table, decompressed);
+                    }
+                    append_le32(seek_table, static_cast<std::uint32_t>(std::size(frames_)));
+                    seek_table += '\0'; // no checksums
+                    append_le32(seek_table, 0x8F92EAB1);
+                    output_.write(std::data(seek_table), std::size(seek_table));
+                }
+#endif
+                return static_cast<bool>(output_.flush());
+            }
+
+        protected:
+            int_type overflow(int_type c) override
+            {
+                if(finished_ || !write_block())
+                    return traits_type::eof();
+
+                if(!traits_type::eq_int_type(c, traits_type::eof()))
+                {
+                    *pptr() = traits_type::to_char_type(c);
+                    pbump(1);
+                }
+                return traits_type::not_eof(c);
+            }
+
+            int sync() override
+            {
+                return write_block() && output_.flush() ? 0 : -1;
+            }
+
+        private:
+            /// Compress and write buffered data as one block
+            bool write_block()
+            {
+                auto size = static_cast<std::size_t>(pptr() - pbase());
+                if(size == 0)
+                    return true;
+
+                setp(std::data(buffer_), std::data(buffer_) + std::size(buffer_));
+
+#ifdef CSVPP_USE_ZLIB
+                if(compression_ == Compression::gzip)
+                {
+                    constexpr std::size_t header_size = 18, trailer_size = 8;
+
+                    deflateReset(&zstream_);
+                    compressed_.resize(header_size + deflateBound(&zstream_, size) + trailer_size);
+
+                    zstream_.next_in = reinterpret_cast<Bytef *>(std::data(buffer_));
+                    zstream_.avail_in = static_cast<uInt>(size);
+                    zstream_.next_out = reinterpret_cast<Bytef *>(std::data(compressed_) + header_size);
+                    zstream_.avail_out = static_cast<uInt>(std::size(compressed_) - header_size - trailer_size);
+                    if(deflate(&zstream_, Z_FINISH) != Z_STREAM_END)
+                        return false;
+
+                    // gzip header with a BC extra field holding the block size - 1
+                    auto block_size = header_size + zstream_.total_out + trailer_size;
+                    compressed_.replace(0, header_size - 2, "\x1f\x8b\x08\x04\0\0\0\0\0\xff\x06\0BC\x02\0", header_size - 2);
+                    compressed_[header_size - 2] = static_cast<char>((block_size - 1) & 0xff);
+                    compressed_[header_size - 1] = static_cast<char>((block_size - 1) >> 8);
+                    compressed_.resize(header_size + zstream_.total_out);
+
+                    append_le32(compressed_, static_cast<std::uint32_t>(crc32(crc32(0, nullptr, 0), reinterpret_cast<const Bytef *>(std::data(buffer_)), static_cast<uInt>(size))));
+                    append_le32(compressed_, static_cast<std::uint32_t>(size));
+                }
+#endif
+#ifdef CSVPP_USE_ZSTD
+                if(compression_ == Compression::zstd)
+                {
+                    compressed_.resize(ZSTD_compressBound(size));
+                    auto compressed_size = ZSTD_compressCCtx(zstd_, std::data(compressed_), std::size(compressed_), std::data(buffer_), size, ZSTD_CLEVEL_DEFAULT);
+                    if(ZSTD_isError(compressed_size))
+                        return false;
+
+                    compressed_.resize(compressed_size);
+                    frames_.emplace_back(static_cast<std::uint32_t>(compressed_size), static_cast<std::uint32_t>(size));
+                }
+#endif
+                return static_cast<bool>(output_.write(std::data(compressed_), static_cast<std::streamsize>(std::size(compressed_))));
+            }
+
+            /// Append a little-endian 32-bit integer
+            static void append_le32(std::string & str, std::uint32_t value)
+            {
+                for(int i = 0; i < 4; ++i)
+                    str += static_cast<char>((value >> (8 * i)) & 0xff);
+            }
+
+            std::ostream & output_;   ///< Stream to write compressed output to
+            Compression compression_; ///< Compression format
+            std::string buffer_;      ///< Uncompressed data for the current block
+            std::string compressed_;  ///< Compressed data for the current block
+            bool finished_ { false }; ///< End of stream has been written
+#ifdef CSVPP_USE_ZLIB
+            z_stream zstream_ {};     ///< zlib state
+#endif
+#ifdef CSVPP_USE_ZSTD
+            ZSTD_CCtx * zstd_ { nullptr }; ///< zstd state
+
+            /// Compressed and decompressed size of each frame written, for the seek table
+            std::vector<std::pair<std::uint32_t, std::uint32_t>> frames_;
+#endif
+        };
+
+        /// Output stream compressing to another stream in independent blocks
+        class Block_compress_stream final: public std::ostream
+        {
+        public:
+            /// @param output Stream to write compressed output to
+            /// @param compression Compression format. Must be Compression::gzip or Compression::zstd
+            /// @param owned_output Stream to take ownership of, if \c output is owned by this stream
+            /// @throws IO_error if \c compression is a format that is not enabled
+            Block_compress_stream(std::ostream & output, Compression compression, std::unique_ptr<std::ostream> owned_output = nullptr):
+                std::ostream{nullptr},
+                owned_output_{std::move(owned_output)},
+                buf_{output, compression}
+            {
+                rdbuf(&buf_);
+            }
+
+        private:
+            std::unique_ptr<std::ostream> owned_output_; ///< Output stream, if owned. Destroyed after buf_ is finished
+            Block_compress_buf buf_;                     ///< Compressing buffer
+        };
+
+        /// Destination for Writer output
+
+        /// Writer collects output in its own buffer, and passes it here in large blocks
+        class Output_sink
+        {
+        public:
+            virtual ~Output_sink() = default;
+
+            /// Write a block of output
+
+            /// @param data Data to write
+            /// @param size Size of \c data in bytes
+            /// @throws IO_error if there is an error writing
+            virtual void write(const char * data, std::size_t size) = 0;
+
+            /// Flush any output held by the destination
+
+            /// @throws IO_error if there is an error writing
+            virtual void flush() {}
+        };
+
+        /// Writes to a std::ostream
+        class Stream_sink final: public Output_sink
+        {
+        public:
+            /// @param output Stream to write to
+            explicit Stream_sink(std::ostream & output): output_{output} {}
+
+            void write(const char * data, std::size_t size) override
+            {
+                output_.write(data, static_cast<std::streamsize>(size));
+                if(output_.bad())
+                    throw IO_error{"Error writing to output", errno};
+            }
+
+            void flush() override
+            {
+                output_.flush();
+                if(output_.bad())
+                    throw IO_error{"Error writing to output", errno};
+            }
+
+        private:
+            std::ostream & output_;
+        };
+
+        /// Appends to a std::string
+        class String_sink final: public Output_sink
+        {
+        public:
+            /// @param output String to append to
+            explicit String_sink(std::string & output): output_{output} {}
+
+            void write(const char * data, std::size_t size) override
+            {
+                output_.append(data, size);
+            }
+
+        private:
+            std::string & output_;
+        };
+
+#ifdef CSVPP_HAS_MMAP
+        /// Writes directly to a file descriptor
+
+        /// Writer already buffers its output, so going through an ofstream
+        /// would only add another copy
+        class File_sink final: public Output_sink
+        {
+        public:
+            /// Open a file for writing
+
+            /// @param filename Path to file. Any existing file will be overwritten
+            /// @returns File sink
+            /// @throws IO_error if the file could not be opened
+            static std::unique_ptr<File_sink> open(const std::string & filename)
+            {
+                int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+                if(fd < 0)
+                    throw IO_error("Could not open file '" + filename + "'", errno);
+
+                return std::unique_ptr<File_sink>{new File_sink{fd}};
+            }
+
+            ~File_sink() override { ::close(fd_); }
+
+            File_sink(const File_sink &) = delete;
+            File_sink & operator=(const File_sink &) = delete;
+
+            void write(const char * data, std::size_t size) override
+            {
+                while(size > 0)
+                {
+                    auto written = ::write(fd_, data, size);
+                    if(written < 0)
+                    {
+                        if(errno == EINTR)
+                            continue;
+                        throw IO_error{"Error writing to output", errno};
+                    }
+                    data += written;
+                    size -= static_cast<std::size_t>(written);
+                }
+            }
+
+        private:
+            explicit File_sink(int fd): fd_{fd} {}
+
+            int fd_;
+        };
+#else
+        /// Writes to a file with std::ofstream
+        class File_sink final: public Output_sink
+        {
+        public:
+            /// Open a file for writing
+
+            /// @param filename Path to file. Any existing file will be overwritten
+            /// @returns File sink
+            /// @throws IO_error if the file could not be opened
+            static std::unique_ptr<File_sink> open(const std::string & filename)
+            {
+                std::unique_ptr<File_sink> sink{new File_sink{filename}};
+                if(!sink->output_)
+                    throw IO_error("Could not open file '" + filename + "'", errno);
+                return sink;
+            }
+
+            void write(const char * data, std::size_t size) override { sink_.write(data, size); }
+            void flush() override { sink_.flush(); }
+
+        private:
+            explicit File_sink(const std::string & filename): output_{filename, std::ios::binary}, sink_{output_} {}
+
+            std::ofstream output_;
+            Stream_sink sink_;
+        };
+#endif
+
+        /// Stream buffer appending to a std::string
+
+        /// Lets Writer format fields with `ostream::operator<<` without creating
+        /// a std::ostringstream for each one
+        class String_append_buf final: public std::streambuf
+        {
+        public:
+            /// @param output String to append to
+            explicit String_append_buf(std::string & output): output_{output} {}
+
+        protected:
+            int_type overflow(int_type c) override
+            {
+                if(!traits_type::eq_int_type(c, traits_type::eof()))
+                    output_ += traits_type::to_char_type(c);
+                return traits_type::not_eof(c);
+            }
+
+            std::streamsize xsputn(const char * s, std::streamsize n) override
+            {
+                output_.append(s, static_cast<std::size_t>(n));
+                return n;
+            }
+
+        private:
+            std::string & output_;
+        };
+    };
+
+    /// String conversion
+
+    /// Convert a given type to std::string, using conversion, std::to_chars,
+    /// to_string, or std::ostream insertion. Numbers are written with
+    /// std::to_chars where available, so floating point numbers use the
+    /// shortest representation that reads back as the same value
+    /// @param t Data to convert to std::string
+    /// @returns Input converted to std::string
+    template <typename T, typename std::enable_if_t<std::is_convertible_v<T, std::string>, int> = 0>
+    std::string str(const T & t)
+    {
+        return t;
+    }
+
+    template <typename T, typename std::enable_if_t<!std::is_convertible_v<T, std::string> && detail::has_to_chars_v<T>, int> = 0>
+    std::string str(const T & t)
+    {
+        std::array<char, detail::max_number_size<T>(-1)> buffer;
+        return {std::data(buffer), detail::format_number(std::data(buffer), std::data(buffer) + std::size(buffer), t, -1).ptr};
+    }
+
+    template <typename T, typename std::enable_if_t<!std::is_convertible_v<T, std::string> && !detail::has_to_chars_v<T> && detail::has_std_to_string_v<T>, int> = 0>
+    std::string str(const T & t)
+    {
+        return std::to_string(t);
+    }
+
+    template <typename T, typename std::enable_if_t<!std::is_convertible_v<T, std::string> && !detail::has_std_to_string_v<T> && detail::has_to_string_v<T>, int> = 0>
+    std::string str(const T & t)
+    {
+        return to_string(t);
+    }
+
+    template <typename T, typename std::enable_if_t<!std::is_convertible_v<T, std::string> && !detail::has_std_to_string_v<T> && !detail::has_to_string_v<T> && detail::has_ostr_v<T>, int> = 0>
+    std::string str(const T & t)
+    {
+        std::ostringstream os;
+        os<<t;
+        return os.str();
+    }
+
+    // special conversion for char using std::string's initializer list ctor
+    std::string str(char c)
+    {
+        return {c};
+    }
+
+    class Parallel_reader;
+    class Parallel_writer;
+    class Read_ahead_reader;
+    class Reader;
+
+    /// Row offset index
+
+    /// Records where every Nth row of a CSV file starts, so Reader::seek_to_row
+    /// can jump close to any row and parse forward from there, rather than
+    /// parsing the whole file up to that row. Rows are counted as Reader reads
+    /// them: blank lines are not rows, and a header row is row 0.
+    ///
+    /// An index can be saved to a sidecar file alongside the CSV file. The
+    /// sidecar records the CSV file's size and modification time, and is only
+    /// loaded if they still match. Sidecar files use the host's byte order,
+    /// and are not meant to be moved between machines
+    class Row_index
+    {
+    public:
+        /// Position of a row
+        struct Checkpoint
+        {
+            std::uint64_t offset; ///< Byte offset of the row's first character
+            std::uint64_t line;   ///< Line number of the row's first character
+            std::uint64_t col;    ///< Column number of the row's first character
+        };
+
+        /// Default number of rows between checkpoints
+        static constexpr std::size_t default_interval = 1024;
+
+        /// Build an index by parsing a CSV file
+
+        /// @param filename Path to CSV file
+        /// @param interval Number of rows between checkpoints. Must be greater than 0
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
+        /// @returns Index of the file
+        /// @throws Parse_error if error parsing the file (*only when not parsing in lenient mode*)
+        /// @throws IO_error if error reading the file
+        static Row_index build(const std::string & filename, std::size_t interval = default_interval,
+                const char delimiter = ',', const char quote = '"',
+                const bool lenient = false);
+
+        /// Load an index from a sidecar file
+
+        /// @param sidecar_filename Path to sidecar file
+        /// @param filename Path to the CSV file that was indexed
+        /// @returns Loaded index, or empty optional if the sidecar could not be
+        /// read or is corrupt, or if \c filename has changed since it was indexed
+        static std::optional<Row_index> load(const std::string & sidecar_filename, const std::string & filename)
+        {
+            std::ifstream sidecar{sidecar_filename, std::ios::binary};
+
+            char magic[sizeof(sidecar_magic)];
+            if(!sidecar.read(magic, sizeof(magic)) || std::memcmp(magic, sidecar_magic, sizeof(magic)) != 0)
+                return {};
+
+            Row_index index;
+            std::uint64_t interval = 0, num_checkpoints = 0;
+            std::uint8_t lenient = 0;
+            if(!read_value(sidecar, index.file_size_) || !read_value(sidecar, index.file_time_)
+                    || !read_value(sidecar, interval) || !read_value(sidecar, index.delimiter_)
+                    || !read_value(sidecar, index.quote_) || !read_value(sidecar, lenient)
+                    || !read_value(sidecar, index.rows_) || !read_value(sidecar, num_checkpoints)
+                    || interval == 0 || interval > std::numeric_limits<std::size_t>::max() || lenient > 1
+                    || num_checkpoints != index.rows_ / interval + (index.rows_ % interval != 0))
+                return {};
+            index.lenient_ = lenient;
+
+            // check the checkpoint count against the sidecar's size before allocating for them
+            auto checkpoints_start = sidecar.tellg();
+            if(checkpoints_start < 0 || !sidecar.seekg(0, std::ios::end))
+                return {};
+            auto checkpoints_end = sidecar.tellg();
+            if(checkpoints_end < checkpoints_start || !sidecar.seekg(checkpoints_start))
+                return {};
+            auto checkpoints_size = static_cast<std::uint64_t>(checkpoints_end - checkpoints_start);
+            if(checkpoints_size % sizeof(Checkpoint) != 0 || num_checkpoints != checkpoints_size / sizeof(Checkpoint))
+                return {};
+
+            auto stat = file_stat(filename);
+            if(!stat || stat->first != index.file_size_ || stat->second != index.file_time_)
+                return {};
+
+            index.interval_ = static_cast<std::size_t>(interval);
+            index.checkpoints_.resize(static_cast<std::size_t>(num_checkpoints));
+            if(!sidecar.read(reinterpret_cast<char *>(std::data(index.checkpoints_)),
+                        static_cast<std::streamsize>(num_checkpoints * sizeof(Checkpoint))))
+                return {};
+
+            return index;
+        }
+
+        /// Load an index from a sidecar file, or build and save a new one
+
+        /// The index is rebuilt if the sidecar is missing, unreadable, out of
+        /// date, or was built with a different interval, delimiter, quote, or
+        /// lenient setting
+        /// @param filename Path to CSV file
+        /// @param sidecar_filename Path to sidecar file
+        /// @param interval Number of rows between checkpoints. Must be greater than 0
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
+        /// @returns Index of the file
+        /// @throws Parse_error if error parsing the file (*only when not parsing in lenient mode*)
+        /// @throws IO_error if error reading the file or writing the sidecar
+        static Row_index open(const std::string & filename, const std::string & sidecar_filename,
+                std::size_t interval = default_interval,
+                const char delimiter = ',', const char quote = '"',
+                const bool lenient = false)
+        {
+            if(auto index = load(sidecar_filename, filename); index && index->interval() == interval
+                    && index->delimiter() == delimiter && index->quote() == quote && index->lenient() == lenient)
+                return std::move(*index);
+
+            auto index = build(filename, interval, delimiter, quote, lenient);
+            index.save(sidecar_filename);
+            return index;
+        }
+
+        /// Save to a sidecar file
+
+        /// @param sidecar_filename Path to sidecar file
+        /// @throws IO_error if error writing file
+        void save(const std::string & sidecar_filename) const
+        {
+            std::ofstream sidecar{sidecar_filename, std::ios::binary};
+            std::uint64_t interval = interval_, num_checkpoints = std::size(checkpoints_);
+            std::uint8_t lenient = lenient_;
+
+            sidecar.write(sidecar_magic, sizeof(sidecar_magic));
+            write_value(sidecar, file_size_);
+            write_value(sidecar, file_time_);
+            write_value(sidecar, interval);
+            write_value(sidecar, delimiter_);
+            write_value(sidecar, quote_);
+            write_value(sidecar, lenient);
+            write_value(sidecar, rows_);
+            write_value(sidecar, num_checkpoints);
+            sidecar.write(reinterpret_cast<const char *>(std::data(checkpoints_)),
+                    static_cast<std::streamsize>(num_checkpoints * sizeof(Checkpoint)));
+
+            if(!sidecar.flush())
+                throw IO_error("Could not write row index to '" + sidecar_filename + "'", errno);
+        }
+
+        /// @returns Number of rows between checkpoints
+        std::size_t interval() const { return interval_; }
+
+        /// @returns Delimiter character the index was built with
+        char delimiter() const { return delimiter_; }
+
+        /// @returns Quote character the index was built with
+        char quote() const { return quote_; }
+
+        /// @returns \c true if the index was built with lenient parsing
+        bool lenient() const { return lenient_; }
+
+        /// @returns Number of rows in the indexed file
+        std::uint64_t rows() const { return rows_; }
+
+        /// @returns Size of the indexed file, in bytes
+        std::uint64_t file_size() const { return file_size_; }
+
+        /// @returns Position of every interval()th row, in order
+        const std::vector<Checkpoint> & checkpoints() const { return checkpoints_; }
+
+        /// Find the nearest checkpoint at or before a row
+
+        /// @param row Row number
+        /// @returns Checkpoint for row `row - row % interval()`
+        /// @throws Out_of_range_error if \c row is not less than rows()
+        const Checkpoint & checkpoint(std::uint64_t row) const
+        {
+            if(row >= rows_)
+                throw Out_of_range_error("Row not in index");
+            return checkpoints_[static_cast<std::size_t>(row / interval_)];
+        }
+
+    private:
+        static_assert(sizeof(Checkpoint) == 3 * sizeof(std::uint64_t), "Checkpoint is saved as raw bytes");
+
+        friend Reader;
+
+        /// Identifies a sidecar file, and its format version
+        static constexpr char sidecar_magic[8] = {'C', 'S', 'V', 'P', 'P', 'I', 'X', '2'};
+
+        template <typename T>
+        static bool read_value(std::istream & in, T & value)
+        {
+            return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(value)));
+        }
+
+        template <typename T>
+        static void write_value(std::ostream & out, const T & value)
+        {
+            out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+        }
+
+        /// Get a file's size and modification time
+
+        /// @param filename Path to file
+        /// @returns File size and modification time, or empty optional if they could not be read
+        static std::optional<std::pair<std::uint64_t, std::int64_t>> file_stat(const std::string & filename)
+        {
+            std::error_code ec;
+            auto size = std::filesystem::file_size(filename, ec);
+            if(ec)
+                return {};
+            auto time = std::filesystem::last_write_time(filename, ec);
+            if(ec)
+                return {};
+
+            return std::pair{static_cast<std::uint64_t>(size), static_cast<std::int64_t>(time.time_since_epoch().count())};
+        }
+
+        std::uint64_t file_size_ { 0 };             ///< Size of indexed file
+        std::int64_t file_time_ { 0 };              ///< Modification time of indexed file
+        std::size_t interval_ { default_interval }; ///< Number of rows between checkpoints
+        char delimiter_ { ',' };                    ///< Delimiter character used to build the index
+        char quote_ { '"' };                        ///< Quote character used to build the index
+        bool lenient_ { false };                    ///< Lenient parsing used to build the index
+        std::uint64_t rows_ { 0 };                  ///< Number of rows in indexed file
+        std::vector<Checkpoint> checkpoints_;       ///< Position of every interval_th row
+    };
+
+    /// Byte range of a CSV file, for reading part of a file
+
+    /// \c begin and \c end are both row starts (or the end of the file), so
+    /// shards planned for one file with the same \c end and \c begin for
+    /// adjacent shards cover every row exactly once. A row belongs to the
+    /// shard containing its first character.
+    ///
+    /// Construct a Reader with Reader(const std::string &, const Shard &, char, char, bool)
+    /// to read a shard. Create shards with resolve_shard or plan_shards
+    struct Shard
+    {
+        std::uint64_t begin { 0 }; ///< Byte offset of the shard's first row
+        std::uint64_t end { 0 };   ///< Byte offset just past the shard's last row
+        std::uint64_t line { 1 };  ///< Line number of \c begin
+        std::uint64_t col { 0 };   ///< Column number of \c begin
+    };
+
+    namespace detail
+    {
+        /// Finds where rows start, by tracking quoting and line breaks
+
+        /// Assumes that quotes only appear in quoted fields, which is always
+        /// true of valid CSV, but may not be of input read with lenient parsing
+        class Row_start_scanner
+        {
+        public:
+            /// @param quote Quote character
+            /// @param start Position of a row start to begin scanning from
+            Row_start_scanner(char quote, const Row_index::Checkpoint & start):
+                quote_{quote},
+                offset_{start.offset},
+                line_{start.line},
+                line_start_{start.offset - start.col}
+            {}
+
+            /// Scan a block of input for a row start
+
+            /// Blocks must be contiguous, starting from the \c start position
+            /// given to the constructor
+            /// @param data Start of data to scan. Updated to the row start if
+            /// one is found, so scanning may be continued for a later target
+            /// @param end End of data to scan
+            /// @param target Offset to find the first row start at or after
+            /// @param found Set to position of the row start
+            /// @returns \c true if a row start was found in [data, end)
+            bool find(const char *& data, const char * end, std::uint64_t target, Row_index::Checkpoint & found)
+            {
+                while(data != end)
+                {
+                    if(quoted_)
+                    {
+                        auto close = static_cast<const char *>(std::memchr(data, quote_, static_cast<std::size_t>(end - data)));
+                        auto run_end = close ? close : end;
+                        while(auto newline = static_cast<const char *>(std::memchr(data, '\n', static_cast<std::size_t>(run_end - data))))
+                        {
+                            advance(data, newline + 1);
+                            ++line_;
+                            line_start_ = offset_;
+                        }
+                        advance(data, run_end);
+                        if(close)
+                        {
+                            advance(data, close + 1);
+                            quoted_ = false;
+                        }
+                        continue;
+                    }
+
+                    auto c = *data;
+                    if(c == '\r' || c == '\n')
+                    {
+                        advance(data, data + 1);
+                        after_newline_ = true;
+                        if(c == '\n')
+                        {
+                            ++line_;
+                            line_start_ = offset_;
+                        }
+                        continue;
+                    }
+
+                    if(after_newline_ && offset_ >= target)
+                    {
+                        found = {offset_, line_, offset_ - line_start_};
+                        return true;
+                    }
+
+                    after_newline_ = false;
+                    if(c == quote_)
+                    {
+                        advance(data, data + 1);
+                        quoted_ = true;
+                    }
+                    else
+                    {
+                        // '\n' passed as the delimiter, so only quotes and line breaks stop the search
+                        advance(data, find_structural(data + 1, end, '\n', quote_));
+                    }
+                }
+                return false;
+            }
+
+            /// @returns Position of the end of the scanned input
+            Row_index::Checkpoint position() const { return {offset_, line_, offset_ - line_start_}; }
+
+        private:
+            void advance(const char *& data, const char * to)
+            {
+                offset_ += static_cast<std::uint64_t>(to - data);
+                data = to;
+            }
+
+            char quote_;                   ///< Quote character
+            bool quoted_ { false };        ///< In a quoted field
+            bool after_newline_ { true };  ///< No characters other than line breaks since the last row start or line break
+            std::uint64_t offset_;         ///< Offset of next character to scan
+            std::uint64_t line_;           ///< Line number of next character to scan
+            std::uint64_t line_start_;     ///< Offset of the start of the current line
+        };
+
+        /// Find the first row start at or after each of a list of offsets
+
+        /// @param filename Path to CSV file
+        /// @param start Position of a row start at or before the first target
+        /// @param targets Offsets to search from, in ascending order
+        /// @param quote Quote character
+        /// @returns Position of a row start for each target. Targets with no
+        /// row start after them are given the end of the file
+        /// @throws IO_error if error opening or reading the file
+        inline std::vector<Row_index::Checkpoint> find_row_starts(const std::string & filename,
+                const Row_index::Checkpoint & start, const std::vector<std::uint64_t> & targets, char quote)
+        {
+            std::vector<Row_index::Checkpoint> row_starts;
+            row_starts.reserve(std::size(targets));
+
+            Row_start_scanner scanner{quote, start};
+            auto source = open_file(filename);
+
+            auto scan = [&](const char * data, const char * end)
+            {
+                Row_index::Checkpoint found;
+                while(std::size(row_starts) < std::size(targets)
+                        && scanner.find(data, end, targets[std::size(row_starts)], found))
+                    row_starts.push_back(found);
+            };
+
+            if(auto contents = source->contents(); contents)
+            {
+                if(start.offset > source->contents_size())
+                    throw Out_of_range_error("Row index does not match input");
+                scan(contents + start.offset, contents + source->contents_size());
+            }
+            else
+            {
+                if(!source->seek(start.offset))
+                    throw IO_error("Could not seek in input", ESPIPE);
+
+                std::vector<char> buffer(1 << 16);
+                while(std::size(row_starts) < std::size(targets))
+                {
+                    auto read_size = source->read(std::data(buffer), std::size(buffer));
+                    if(read_size == 0)
+                        break;
+                    scan(std::data(buffer), std::data(buffer) + read_size);
+                }
+            }
+
+            row_starts.resize(std::size(targets), scanner.position());
+            return row_starts;
+        }
+
+        /// @param filename Path to file
+        /// @returns Size of file
+        /// @throws IO_error if the size could not be read
+        inline std::uint64_t file_size(const std::string & filename)
+        {
+            std::error_code ec;
+            auto size = std::filesystem::file_size(filename, ec);
+            if(ec)
+                throw IO_error("Could not get size of file '" + filename + "'", ec.value());
+            return static_cast<std::uint64_t>(size);
+        }
+
+        /// Build shards from their boundaries
+
+        /// @param boundaries Start of each shard, followed by the end of the last shard
+        /// @returns Shards between each pair of boundaries
+        inline std::vector<Shard> make_shards(const std::vector<Row_index::Checkpoint> & boundaries)
+        {
+            std::vector<Shard> shards;
+            for(std::size_t i = 0; i + 1 < std::size(boundaries); ++i)
+                shards.push_back({boundaries[i].offset, boundaries[i + 1].offset, boundaries[i].line, boundaries[i].col});
+            return shards;
+        }
+    };
+
+    /// Find the rows within a byte range of a CSV file
+
+    /// The shard begins at the first row that starts at or after \c begin,
+    /// and ends at the first row that starts at or after \c end. Processes
+    /// given adjacent byte ranges of the same file, such as equal splits of its
+    /// size, get shards that cover every row exactly once without having to
+    /// coordinate.
+    ///
+    /// The file is scanned from the beginning to track quoted fields, so a
+    /// field containing line breaks is never mistaken for the end of a row.
+    /// This assumes quotes only appear in quoted fields, as in any valid CSV
+    /// @param filename Path to CSV file
+    /// @param begin Byte offset of start of range
+    /// @param end Byte offset of end of range
+    /// @param quote Quote character
+    /// @returns Shard for the range
+    /// @throws IO_error if error opening or reading the file
+    inline Shard resolve_shard(const std::string & filename, std::uint64_t begin, std::uint64_t end, const char quote = '"')
+    {
+        return detail::make_shards(detail::find_row_starts(filename, {0, 1, 0}, {begin, std::max(begin, end)}, quote)).front();
+    }
+
+    /// Find the rows within a byte range of an indexed CSV file
+
+    /// As resolve_shard(const std::string &, std::uint64_t, std::uint64_t, char),
+    /// but scanning starts from the nearest checkpoint before \c begin rather
+    /// than the beginning of the file
+    /// @param filename Path to CSV file
+    /// @param index Index of \c filename
+    /// @param begin Byte offset of start of range
+    /// @param end Byte offset of end of range
+    /// @param quote Quote character
+    /// @returns Shard for the range
+    /// @throws IO_error if error opening or reading the file
+    inline Shard resolve_shard(const std::string & filename, const Row_index & index,
+            std::uint64_t begin, std::uint64_t end, const char quote = '"')
+    {
+        auto & checkpoints = index.checkpoints();
+        auto next = std::upper_bound(std::begin(checkpoints), std::end(checkpoints), begin,
+                [](std::uint64_t offset, const Row_index::Checkpoint & checkpoint) { return offset < checkpoint.offset; });
+        auto start = next == std::begin(checkpoints) ? Row_index::Checkpoint{0, 1, 0} : *std::prev(next);
+
+        return detail::make_shards(detail::find_row_starts(filename, start, {begin, std::max(begin, end)}, quote)).front();
+    }
+
+    /// Split a CSV file into shards of about equal size
+
+    /// Scans the file once to find row starts near each split point. See
+    /// resolve_shard for details
+    /// @param filename Path to CSV file
+    /// @param count Number of shards. Must be greater than 0
+    /// @param quote Quote character
+    /// @returns \c count shards, in order. Shards may be empty if there are
+    /// fewer rows than shards, or if some rows are very long
+    /// @throws IO_error if error opening or reading the file
+    inline std::vector<Shard> plan_shards(const std::string & filename, std::size_t count, const char quote = '"')
+    {
+        assert(count > 0);
+
+        auto size = detail::file_size(filename);
+        std::vector<std::uint64_t> targets;
+        for(std::size_t i = 0; i <= count; ++i)
+            targets.push_back(i == count ? size : static_cast<std::uint64_t>(static_cast<long double>(size) * i / count));
+
+        return detail::make_shards(detail::find_row_starts(filename, {0, 1, 0}, targets, quote));
+    }
+
+    /// Split an indexed CSV file into shards of about equal size
+
+    /// Shards are split at the index's checkpoints, so the file is not read.
+    /// Shard sizes are only as even as the checkpoint interval allows
+    /// @param index Index of the CSV file
+    /// @param count Number of shards. Must be greater than 0
+    /// @returns \c count shards, in order. Shards may be empty
+    inline std::vector<Shard> plan_shards(const Row_index & index, std::size_t count)
+    {
+        assert(count > 0);
+
+        auto & checkpoints = index.checkpoints();
+        Row_index::Checkpoint file_end {index.file_size(), 1, 0};
+
+        std::vector<Row_index::Checkpoint> boundaries;
+        for(std::size_t i = 0; i <= count; ++i)
+        {
+            auto target = static_cast<std::uint64_t>(static_cast<long double>(index.file_size()) * i / count);
+            auto next = std::lower_bound(std::begin(checkpoints), std::end(checkpoints), target,
+                    [](const Row_index::Checkpoint & checkpoint, std::uint64_t offset) { return checkpoint.offset < offset; });
+            boundaries.push_back(i == count || next == std::end(checkpoints) ? file_end : *next);
+        }
+
+        return detail::make_shards(boundaries);
+    }
+
+    /// Parses CSV data
+
+    /// By default, parses according to RFC 4180 rules, and throws a Parse_error
+    /// when given non-conformant input. The field delimiter and quote
+    /// characters may be changed, and there is a lenient parsing option to ignore
+    /// violations.
+    ///
+    /// Blank rows are ignored and skipped over.
+    ///
+    /// Most methods operate on rows, but some read field-by-field. Mixing
+    /// row-wise and field-wise methods is not recommended, but is possible.
+    /// Row-wise methods will act as if the current position is the start of a
+    /// row, regardless of any fields that have been read from the current row so
+    /// far.
+    ///
+    /// Input from strings and memory-mapped files is parsed with a structural
+    /// index, which locates delimiters, quotes and newlines 64 bytes at a time
+    /// before fields are read. Malformed fields fall back to character-by-character
+    /// parsing, so errors are reported identically for all input types.
+    class Reader
+    {
+    public:
+        /// Represents a single row of CSV data
+
+        /// A Row may be obtained from Reader::get_row or Reader::Iterator
+        /// @warning Reader object must not be destroyed or read from during Row lifetime
+        class Row
+        {
+        public:
+            /// Iterates over the fields within a Row
+
+            /// @tparam T Type to convert fields to. Defaults to std::string
+            template <typename T = std::string> class Iterator
+            {
+            public:
+                using value_type        = T;
+                using difference_type   = std::ptrdiff_t;
+                using pointer           = const T*;
+                using reference         = const T&;
+                using iterator_category = std::input_iterator_tag;
+
+                /// Empty constructor
+
+                /// Denotes the end of iteration
+                Iterator(): row_{nullptr} {}
+
+                /// Creates an iterator from a Row, and parses the first field
+
+                /// @param row Row to iterate over.
+                /// @warning \c row must not be destroyed or read from during iteration
+                /// @throws Parse_error if error parsing first field (*only when not parsing in lenient mode*)
+                /// @throws IO_error if error reading CSV data
+                /// @throws Type_conversion_error if error converting to type T. Caller may call this again with a different type to try again
+                explicit Iterator(Reader::Row & row): row_{&row}
+                {
+                    ++*this;
+                }
+
+                /// @returns Current field
+                const T & operator*() const { return obj_; }
+
+                /// @returns Pointer to current field
+                const T * operator->() const { return &obj_; }
+
+                /// Parse and iterate to next field
+
+                /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+                /// @throws IO_error if error reading CSV data
+                /// @throws Type_conversion_error if error converting to type T. Caller may call this again with a different type to try again
+                Iterator & operator++()
+                {
+                    assert(row_);
+
+                    if(end_of_row_)
+                    {
+                        row_ = nullptr;
+                    }
+                    else
+                    {
+                        obj_ = row_->read_field<T>();
+
+                        if(row_->end_of_row())
+                            end_of_row_ = true;
+                    }
+
+                    return *this;
+                }
+
+                /// Compare to another Reader::Row::Iterator
+                bool equals(const Iterator<T> & rhs) const
+                {
+                    return row_ == rhs.row_;
+                }
+
+            private:
+                Reader::Row * row_; ///< Pointer to parent Row object, or \c nullptr if past end of row
+                T obj_{}; ///< Storage for current field
+                bool end_of_row_ = false; ///< Keeps track of when the Row has hit end-of-row
+            };
+
+            /// Helper class for iterating over a Row. Use Row::range to obtain
+
+            /// @tparam T Type to convert fields to. Defaults to std::string
+            template<typename T = std::string>
+            class Range
+            {
+            public:
+                /// @returns Iterator to current field in row
+                Row::Iterator<T> begin()
+                {
+                    return Row::Iterator<T>{row_};
+                }
+
+                /// @returns Iterator to end of row
+                Row::Iterator<T> end()
+                {
+                    return Row::Iterator<T>{};
+                }
+            private:
+                friend Row;
+                explicit Range(Row & row):row_{row} {} ///< Construct a Range. Only for use by Row::range
+                Row & row_; ///< Ref to parent Row object
+            };
+
+            /// @tparam T Type to convert fields to. Defaults to std::string
+            /// @returns Iterator to current field in row
+            template<typename T = std::string>
+            Row::Iterator<T> begin()
+            {
+                return Row::Iterator<T>{*this};
+            }
+
+            /// @tparam T Type to convert fields to. Defaults to std::string
+            /// @returns Iterator to end of row
+            template<typename T = std::string>
+            Row::Iterator<T> end()
+            {
+                return Row::Iterator<T>{};
+            }
+
+            /// Range helper
+
+            /// Useful when iterating over a row and converting to a specific type
+            /// @tparam T Type to convert fields to. Defaults to std::string
+            /// @returns A Range object containing begin and end methods corresponding to this Row
+            template<typename T = std::string>
+            Range<T> range()
+            {
+                return Range<T>{*this};
+            }
+
+            /// Read a single field from the row
+
+            /// @tparam T Type to convert fields to. Defaults to std::string
+            /// @returns The next field from the row, or a default-initialized object if past the end of the row
+            /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+            /// @throws IO_error if error reading CSV data
+            /// @throws Type_conversion_error if error converting to type T. Caller may call this again with a different type to try again
+            template<typename T = std::string>
+            T read_field()
+            {
+                assert(reader_);
+
+                if(end_of_row_)
+                {
+                    past_end_of_row_ = true;
+                    return T{};
+                }
+
+                auto field = reader_->read_field<T>();
+
+                if(reader_->end_of_row())
+                    end_of_row_ = true;
+
+                return field;
+            }
+
+            /// Read a single field from the row
+
+            /// @param[out] data Variable to to write field to. Will store a
+            ///                  default initialized object if past the end of the row
+            /// @returns This Row object
+            /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+            /// @throws IO_error if error reading CSV data
+            /// @throws Type_conversion_error if error converting to type T. Caller may call this again with a different type to try again
+            template<typename T>
+            Row & operator>>(T & data)
+            {
+                data = read_field<T>();
+                return * this;
+            }
+
+            /// Reads row into an output iterator
+
+            /// @tparam T Type to convert fields to. Defaults to std::string
+            /// @param it an output iterator to receive the row data
+            /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+            /// @throws IO_error if error reading CSV data
+            /// @throws Type_conversion_error if error converting to type T
+            template<typename T = std::string, typename OutputIter>
+            void read(OutputIter it)
+            {
+                std::copy(begin<T>(), end<T>(), it);
+            }
+
+            /// Reads row into a std::vector
+
+            /// @tparam T Type to convert fields to. Defaults to std::string
+            /// @returns std::vector containing the fields from the Row
+            /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+            /// @throws IO_error if error reading CSV data
+            /// @throws Type_conversion_error if error converting to type T
+            template<typename T = std::string>
+            std::vector<T> read_vec()
+            {
+                std::vector<T> vec;
+                std::copy(begin<T>(), end<T>(), std::back_inserter(vec));
+                return vec;
+            }
+
+            /// Reads row into a tuple
+
+            /// @tparam Args types to convert fields to
+            /// @returns std::tuple containing the fields from the Row.
+            /// If Args contains more elements than there are fields in the row,
+            /// the remaining elements of the tuple will be default initialized
+            /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+            /// @throws IO_error if error reading CSV data
+            /// @throws Type_conversion_error if error converting to specified types
+            template <typename ... Args>
+            std::tuple<Args...> read_tuple()
+            {
+                std::tuple<Args...> ret;
+                read_tuple_helper(ret, std::index_sequence_for<Args...>{});
+                return ret;
+            }
+
+            /// Reads row into variadic arguments
+
+            /// @param[out] data Variables to read into.
+            /// If more parameters are passed than there are fields in the row,
+            /// the remaining parameters will be default initialized
+            /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+            /// @throws IO_error if error reading CSV data
+            /// @throws Type_conversion_error if error converting to specified types
+            template <typename ... Data>
+            void read_v(Data & ... data)
+            {
+                (void)(*this >> ... >> data);
+            }
+
+            /// @returns \c true if the last field in the row has been read
+            bool end_of_row() const { return end_of_row_; }
+
+            /// @returns \c true if more fields can be read
+            operator bool() { return reader_ && !past_end_of_row_; }
+
+        private:
+            friend Reader;
+
+            /// Helper function for read_tuple
+
+            /// Uses a std::index_sequence to generate indexes for std::get
+            /// @param t tuple to load data into
+            template <typename Tuple, std::size_t ... Is>
+            void read_tuple_helper(Tuple & t, std::index_sequence<Is...>)
+            {
+                ((*this >> std::get<Is>(t)), ...);
+            }
+
+            /// Empty constructor
+
+            /// Used to denote that no rows remain
+            Row(): reader_{nullptr} {}
+
+            /// Construct a Row from a Reader
+
+            /// For use by Reader::get_row only
+            explicit Row(Reader & reader): reader_{&reader} {}
+
+            Reader * reader_ { nullptr }; ///< Pointer to parent Reader object or nullptr if no rows remain
+            bool end_of_row_ { false }; ///< Tracks if the end of the current row has been reacehd
+            bool past_end_of_row_ { false }; ///< Tracks if past the end of the row, and prevents reading from the next row
+        };
+
+        /// Read-only view of the fields in a row
+
+        /// Returned by Reader::read_row_view.
+        /// @warning Only valid until the next row is read from the parent Reader
+        class Row_view
+        {
+        public:
+            using value_type      = std::string_view;
+            using size_type       = std::size_t;
+            using const_reference = const std::string_view &;
+            using const_iterator  = const std::string_view *;
+
+            /// @returns Iterator to first field
+            const_iterator begin() const { return data_; }
+            /// @returns Iterator past the last field
+            const_iterator end() const { return data_ + size_; }
+
+            /// @returns Number of fields
+            size_type size() const { return size_; }
+            /// @returns \c true if there are no fields
+            bool empty() const { return size_ == 0; }
+
+            /// @returns Pointer to array of fields
+            const std::string_view * data() const { return data_; }
+
+            /// @param i Index of field
+            /// @returns Field at index \c i. No bounds checking is performed
+            const_reference operator[](size_type i) const { return data_[i]; }
+
+            /// @param i Index of field
+            /// @returns Field at index \c i
+            /// @throws Out_of_range_error if \c i is not a valid index
+            const_reference at(size_type i) const
+            {
+                if(i >= size_)
+                    throw Out_of_range_error("Field index out of range");
+                return data_[i];
+            }
+
+        private:
+            friend Reader;
+            friend Parallel_reader;
+            Row_view(const std::string_view * data, size_type size): data_{data}, size_{size} {} ///< Only for use by Reader and Parallel_reader
+
+            const std::string_view * data_; ///< Fields
+            size_type size_;                ///< Number of fields
+        };
+
+        /// Iterates over Rows in CSV data
+        class Iterator
+        {
+        public:
+            using value_type        = Row;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = const value_type*;
+            using reference         = const value_type&;
+            using iterator_category = std::input_iterator_tag;
+
+            /// Empty constructor
+
+            /// Denotes the end of iteration
+            Iterator(): reader_{nullptr} {}
+
+            /// Creates an iterator from a Reader object
+
+            /// @param r Reader object to iterate over
+            /// @warning \c r must not be destroyed or read from during iteration
+            explicit Iterator(Reader & r): reader_{&r}
+            {
+                obj_ = reader_->get_row();
+
+                if(!*reader_)
+                    reader_ = nullptr;
+            }
+
+            /// @returns Current row
+            const value_type & operator*() const { return obj_; }
+
+            /// @returns Current row
+            value_type & operator*() { return obj_; }
+
+            /// @returns Pointer to current row
+            const value_type * operator->() const { return &obj_; }
+
+            /// @returns pointer to current row
+            value_type * operator->() { return &obj_; }
+
+            /// Iterate to next Row
+            Iterator & operator++()
+            {
+                // discard any remaining fields
+                while(!obj_.end_of_row())
+                    obj_.read_field();
+
+                assert(reader_);
+                obj_ = reader_->get_row();
+
+                if(!*reader_)
+                    reader_ = nullptr;
+
+                return *this;
+            }
+
+            /// Compare to another Reader::Iterator
+            bool equals(const Iterator & rhs) const
+            {
+                return reader_ == rhs.reader_;
+            }
+
+        private:
+            Reader * reader_ { nullptr }; ///< pointer to parent Reader object or nullptr if no rows remain
+            value_type obj_; ///< Storage for the current Row
+        };
+
+        /// Use a std::istream for CSV parsing
+
+        /// @param input_stream std::istream to read from
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
+        /// @warning \c input_stream must not be destroyed or read from during the lifetime of this Reader
+        /// @note Input is read from \c input_stream in blocks (see
+        ///       set_buffer_size), so its position may be ahead of the data parsed so far
+        explicit Reader(std::istream & input_stream,
+                const char delimiter = ',', const char quote = '"',
+                const bool lenient = false):
+            source_{std::make_unique<detail::Stream_source>(input_stream)},
+            delimiter_{delimiter},
+            quote_{quote},
+            lenient_{lenient}
+        {}
+
+        /// Use a compressed std::istream for CSV parsing
+
+        /// @param input_stream std::istream to read from
+        /// @param compression Compression format of \c input_stream
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
+        /// @throws IO_error if \c compression is a format that is not enabled
+        /// @warning \c input_stream must not be destroyed or read from during the lifetime of this Reader
+        Reader(std::istream & input_stream, Compression compression,
+                const char delimiter = ',', const char quote = '"',
+                const bool lenient = false):
+            source_{detail::decompress(std::make_unique<detail::Stream_source>(input_stream), compression)},
+            delimiter_{delimiter},
+            quote_{quote},
+            lenient_{lenient}
+        {}
+
+        /// Open a file for CSV parsing
+
+        /// Regular files are memory-mapped where supported and parsed in place.
+        /// Other files (pipes, devices, etc.) are read as a stream. When built
+        /// with \c CSVPP_USE_ZLIB or \c CSVPP_USE_ZSTD, compressed files are
+        /// detected and decompressed
+        /// @param filename Path to a file to parse
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
+        /// @throws IO_error if there is an error opening the file
+        explicit Reader(const std::string & filename,
+                const char delimiter = ',', const char quote = '"',
+                const bool lenient = false):
+            Reader{filename, Compression::detect, delimiter, quote, lenient}
+        {}
+
+        /// Open a compressed file for CSV parsing
+
+        /// @param filename Path to a file to parse
+        /// @param compression Compression format of the file
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
+        /// @throws IO_error if there is an error opening the file, or if \c
+        /// compression is a format that is not enabled
+        Reader(const std::string & filename, Compression compression,
+                const char delimiter = ',', const char quote = '"',
+                const bool lenient = false):
+            source_{detail::decompress(detail::open_file(filename), compression)},
+            delimiter_{delimiter},
+            quote_{quote},
+            lenient_{lenient}
+        {}
+
+        /// Open part of a file for CSV parsing
+
+        /// Only the rows in \c shard are read. Line and column numbers are
+        /// those of the full file. Row_index and seek_to_row can not be used
+        /// with a shard
+        /// @param filename Path to a file to parse
+        /// @param shard Range of rows to read, from resolve_shard or plan_shards
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
+        /// @throws IO_error if there is an error opening the file
+        Reader(const std::string & filename, const Shard & shard,
+                const char delimiter = ',', const char quote = '"',
+                const bool lenient = false):
+            source_{std::make_unique<detail::Range_source>(detail::open_file(filename), shard.begin, shard.end)},
+            delimiter_{delimiter},
+            quote_{quote},
+            lenient_{lenient},
+            line_no_{static_cast<unsigned int>(shard.line)},
+            col_no_{static_cast<unsigned int>(shard.col)}
+        {}
+
+        /// Default size of input buffer, in bytes
+        static inline constexpr std::size_t default_buffer_size = 64 * 1024;
+
+        /// Disambiguation tag type
+
+        /// Distinguishes opening a Reader with a filename from opening a Reader
+        /// with a string
+        struct input_string_t{};
+
+        /// Disambiguation tag
+
+        /// Distinguishes opening a Reader with a filename from opening a Reader
+        /// with a string
+        static inline constexpr input_string_t input_string{};
+
+        /// Parse CSV from memory
+
+        /// Use Reader::input_string to distinguish this constructor from the
+        /// constructor accepting a filename
+        /// @param input_data \c std::string containing CSV to parse
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
+        Reader(input_string_t, const std::string & input_data,
+                const char delimiter = ',', const char quote = '"',
+                const bool lenient = false):
+            source_{std::make_unique<detail::String_source>(input_data)},
+            delimiter_{delimiter},
+            quote_{quote},
+            lenient_{lenient}
+        {}
+
+        ~Reader() = default;
+
+        Reader(const Reader &) = delete;
+        Reader & operator=(const Reader &) = delete;
+        Reader(Reader &&) = default;
+        Reader & operator=(Reader &&) = default;
+
+        /// Check for end of input
+
+        /// @returns \c true if the last field in the row has been read
+        bool end_of_row() const { return end_of_row_ || eof(); }
+
+        /// Check for end of row
+
+        /// @returns \c true if no fields remain in the current row
+        bool eof() const { return state_ == State::eof; }
+
+        /// @returns \c true if there is more data to be read
+        operator bool() { return !eof(); }
+
+        /// Change the delimiter character
+
+        /// @param delimiter New delimiter character
+        void set_delimiter(const char delimiter) { delimiter_ = delimiter; index_.reset(pos_); }
+        /// Change the quote character
+
+        /// @param quote New quote character
+        void set_quote(const char quote) { quote_ = quote; index_.reset(pos_); }
+
+        /// Enable / disable lenient parsing
+
+        /// Lenient parsing will attempt to ignore syntax errors in CSV input.
+        /// @param lenient \c true for lenient parsing
+        void set_lenient(const bool lenient) { lenient_ = lenient; }
+
+        /// Select the columns to read
+
+        /// Rows are read as if they only contained the selected columns, in
+        /// the order given. This applies to every method of reading, including
+        /// rows and row iterators. Other fields are skipped over without being
+        /// unescaped or copied, and once the last selected column has been read,
+        /// parsing moves directly to the next row. Errors in skipped fields are
+        /// still reported.
+        ///
+        /// Rows too short to contain a selected column are cut short after the
+        /// last selected column they do contain. Any earlier missing columns
+        /// are read as empty fields.
+        ///
+        /// Should be called between rows
+        /// @param columns Indexes of the columns to read. Pass an empty vector
+        /// to read all columns again
+        void set_projection(const std::vector<std::size_t> & columns)
+        {
+            projection_ = columns;
+            projection_last_ = std::empty(columns) ? 0 : *std::max_element(std::begin(columns), std::end(columns));
+            projection_columns_.assign(projection_last_ + 1, false);
+            for(auto col: columns)
+                projection_columns_[col] = true;
+        }
+
+        /// Skip rows that do not match a predicate
+
+        /// The predicate is checked as soon as \c column has been read from
+        /// each row. Rows it rejects are skipped over without copying or
+        /// unescaping any further fields, and are never returned by any method
+        /// of reading. Rows too short to contain \c column are checked as if
+        /// the field were empty.
+        ///
+        /// May be combined with set_projection. \c column is always an index
+        /// into the full row, regardless of the projection.
+        ///
+        /// Should be called between rows
+        /// @param column Index of the column to check
+        /// @param predicate Called with the field (unescaped, as by
+        /// `read_field<std::string_view>()`). Return \c true to keep the row.
+        /// Pass an empty function to read all rows again
+        void set_filter(std::size_t column, std::function<bool(std::string_view)> predicate)
+        {
+            filter_column_ = column;
+            filter_ = std::move(predicate);
+        }
+
+        /// Select the columns to read by header
+
+        /// Reads the next row as a header row, and selects the columns with
+        /// the given headers, as if by set_projection. If a header is repeated,
+        /// its first column is used
+        /// @param headers Headers of the columns to read, in the order to be read
+        /// @throws Parse_error if error parsing field (*only when not parsing
+        /// in lenient mode*), or if there is no header row
+        /// @throws IO_error if error reading CSV data
+        /// @throws Out_of_range_error if one of \c headers is not in the header row
+        void set_projection_by_header(const std::vector<std::string> & headers)
+        {
+            set_projection(std::vector<std::size_t>{});
+
+            // the header row would not pass the filter
+            auto filter = std::exchange(filter_, nullptr);
+            auto header_row = read_row_vec();
+            filter_ = std::move(filter);
+            if(!header_row)
+                throw Parse_error("Can't get header row", 0, 0);
+
+            std::vector<std::size_t> columns;
+            for(auto & header: headers)
+            {
+                auto col = std::find(std::begin(*header_row), std::end(*header_row), header);
+                if(col == std::end(*header_row))
+                    throw Out_of_range_error("Header not found");
+                columns.push_back(static_cast<std::size_t>(col - std::begin(*header_row)));
+            }
+
+            set_projection(columns);
+        }
+
+        /// Change the input buffer size
+
+        /// Input is read from streams and files in blocks of this size. Takes
+        /// effect the next time the buffer is refilled. Has no effect when
+        /// parsing from memory
+        /// @param size New buffer size in bytes. Must be greater than 0
+        void set_buffer_size(const std::size_t size) { assert(size > 0); buffer_size_ = size; }
+
+        /// @returns Iterator to current row
+        Iterator begin()
+        {
+            return Iterator(*this);
+        }
+
+        /// @returns Iterator to end of CSV data
+        auto end()
+        {
+            return Iterator();
+        }
+
+        /// Read a single field
+
+        /// Check end_of_row() to see if this is the last field in the current row
+        /// @tparam T Type to convert fields to. Defaults to std::string. Use
+        /// std::string_view to avoid copying the field. The view remains valid
+        /// until the next row is read
+        /// @returns The next field from the row, or a default-initialized object if past the end of the input data
+        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+        /// @throws IO_error if error reading CSV data
+        /// @throws Type_conversion_error if error converting to type T. Caller may call this again with a different type to try again
+        template<typename T = std::string>
+        T read_field()
+        {
+            if(eof())
+                return {};
+
+            end_of_row_ = false;
+
+            std::string_view field;
+            if(conversion_retry_)
+            {
+                auto & storage = new_field_storage();
+                storage = std::move(*conversion_retry_);
+                conversion_retry_.reset();
+                field = storage;
+            }
+            else
+            {
+                field = parse();
+            }
+
+            if constexpr(std::is_same_v<T, std::string_view>)
+            {
+                return field;
+            }
+            // no conversion needed for strings
+            else if constexpr(std::is_convertible_v<std::string, T>)
+            {
+                return std::string{field};
+            }
+            else
+            {
+                auto field_val = detail::convert<T>(field);
+                if(!field_val)
+                    conversion_error(field);
+
+                return std::move(*field_val);
+            }
+        }
+
+        /// Read a single field without throwing
+
+        /// Non-throwing version of read_field(). Check end_of_row() to see if
+        /// this is the last field in the current row. After a parse error, the
+        /// row ends at the error, and reading resumes with the character
+        /// following it as a new row. Unlike read_field(), a field that fails
+        /// to convert is not kept for retrying. Exceptions thrown by a
+        /// user-defined conversion or filter are returned as Error_kind::other
+        /// @tparam T Type to convert fields to. Defaults to std::string. Use
+        /// std::string_view to avoid copying the field. The view remains valid
+        /// until the next row is read
+        /// @returns The next field from the row, a default-initialized object
+        /// if past the end of the input data, or a Read_error. Parse errors
+        /// are only reported when not parsing in lenient mode
+        template<typename T = std::string>
+        Read_result<T> try_read_field() noexcept
+        {
+            std::string_view field;
+            if(auto error = try_read([&]{ field = read_field<std::string_view>(); }); error)
+                return std::move(*error);
+
+            try
+            {
+                if(eof())
+                    return T{};
+
+                if constexpr(std::is_same_v<T, std::string_view>)
+                {
+                    return field;
+                }
+                // no conversion needed for strings
+                else if constexpr(std::is_convertible_v<std::string, T>)
+                {
+                    return T{std::string{field}};
+                }
+                else
+                {
+                    auto field_val = detail::convert<T>(field);
+                    if(!field_val)
+                        return Read_error{Error_kind::type_conversion, "", field, static_cast<int>(line_no_), static_cast<int>(col_no_)};
+
+                    return std::move(*field_val);
+                }
+            }
+            catch(...)
+            {
+                return Read_error{std::current_exception(), Error_kind::other};
+            }
+        }
+
+        /// Read a single field
+
+        /// Check end_of_row() to see if this is the last field in the current row
+        /// @param[out] data Variable to to write field to
+        /// @returns This Reader object
+        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+        /// @throws IO_error if error reading CSV data
+        /// @throws Type_conversion_error if error converting to type T. Caller may call this again with a different type to try again
+        template<typename T>
+        Reader & operator>>(T & data)
+        {
+            data = read_field<T>();
+            return * this;
+        }
+
+        /// Reads fields into variadic arguments
+
+        /// @warning This may be used to fields from multiple rows at a time.
+        /// Use with caution if the number of fields per row is not known
+        /// beforehand.
+        /// @param[out] data Variables to read into.
+        /// If more parameters are passed than there are fields remaining,
+        /// the remaining parameters will be default initialized
+        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+        /// @throws IO_error if error reading CSV data
+        /// @throws Type_conversion_error if error converting to specified types
+        template <typename ... Data>
+        void read_v(Data & ... data)
+        {
+            (void)(*this >> ... >> data);
+        }
+
+        /// Get the current Row
+
+        /// @returns Row object for the current row
+        Row get_row()
+        {
+            consume_newlines();
+            if(eof())
+                return Row{};
+            else
+                return Row{*this};
+        }
+
+        /// Reads current row into an output iterator
+
+        /// @tparam T Type to convert fields to. Defaults to std::string
+        /// @param it An output iterator to receive the row data
+        /// @returns \c false if this is the last row
+        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+        /// @throws IO_error if error reading CSV data
+        /// @throws Type_conversion_error if error converting to type T
+        template <typename T = std::string, typename OutputIter>
+        bool read_row(OutputIter it)
+        {
+            auto row = get_row();
+            if(!row)
+                return false;
+
+            row.read<T>(it);
+            return true;
+        }
+
+        /// Reads current row into a std::vector
+
+        /// @tparam T Type to convert fields to. Defaults to std::string
+        /// @returns std::vector containing the fields from the row or empty optional if no rows remain
+        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+        /// @throws IO_error if error reading CSV data
+        /// @throws Type_conversion_error if error converting to type T
+        template <typename T = std::string>
+        std::optional<std::vector<T>> read_row_vec()
+        {
+            auto row = get_row();
+            if(!row)
+                return {};
+
+            return row.read_vec<T>();
+        }
+
+        /// Reads current row into an existing std::vector
+
+        /// Overwrites the elements of \c row in place, so a vector reused
+        /// for every row only needs to allocate when a row is wider, or a field
+        /// longer, than any before it. Elements past the end of the row are
+        /// removed.
+        /// @tparam T Type to convert fields to. Defaults to std::string
+        /// @param[out] row Vector to store fields in. If an exception is thrown,
+        /// it may contain a mix of fields from this and previous rows
+        /// @returns \c false if no rows remain, leaving \c row unchanged
+        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+        /// @throws IO_error if error reading CSV data
+        /// @throws Type_conversion_error if error converting to type T
+        template <typename T = std::string>
+        bool read_row_into(std::vector<T> & row)
+        {
+            consume_newlines();
+            if(eof())
+                return false;
+
+            std::size_t size = 0;
+            do
+            {
+                if constexpr(std::is_same_v<T, std::string>)
+                {
+                    // assign to reuse the existing string's capacity
+                    auto field = read_field<std::string_view>();
+                    if(size < std::size(row))
+                        row[size].assign(field);
+                    else
+                        row.emplace_back(field);
+                }
+                else
+                {
+                    auto field = read_field<T>();
+                    if(size < std::size(row))
+                        row[size] = std::move(field);
+                    else
+                        row.push_back(std::move(field));
+                }
+                ++size;
+            } while(!end_of_row());
+
+            row.resize(size);
+            return true;
+        }
+
+        /// Reads current row as views
+
+        /// Fields are not copied unless they need to be unescaped
+        /// @returns Row_view of the fields in the row, or empty optional if no
+        /// rows remain. The Row_view and the fields it contains remain valid
+        /// until the next row is read
+        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+        /// @throws IO_error if error reading CSV data
+        std::optional<Row_view> read_row_view()
+        {
+            auto row = get_row();
+            if(!row)
+                return {};
+
+            row_view_.clear();
+            do
+            {
+                row_view_.push_back(read_field<std::string_view>());
+            } while(!end_of_row());
+
+            return Row_view{std::data(row_view_), std::size(row_view_)};
+        }
+
+        /// Reads current row as views without throwing
+
+        /// Non-throwing version of read_row_view(). After a parse error, the
+        /// row ends at the error, and reading resumes with the character
+        /// following it as a new row. Exceptions thrown by a filter are
+        /// returned as Error_kind::other
+        /// @returns Row_view of the fields in the row, empty optional if no
+        /// rows remain, or a Read_error. Parse errors are only reported when
+        /// not parsing in lenient mode
+        Read_result<std::optional<Row_view>> try_read_row_view() noexcept
+        {
+            std::optional<Row_view> row;
+            if(auto error = try_read([&]{ row = read_row_view(); }); error)
+                return std::move(*error);
+
+            return row;
+        }
+
+        /// Reads current row into a tuple
+
+        /// @tparam Args types to convert fields to
+        /// @returns std::tuple containing the fields from the row or empty
+        /// optional if no rows remain. If Args contains more elements than there
+        /// are fields in the row, the remaining elements of the tuple will be
+        /// default initialized
+        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+        /// @throws IO_error if error reading CSV data
+        /// @throws Type_conversion_error if error converting to specified types
+        template <typename ... Args>
+        std::optional<std::tuple<Args...>> read_row_tuple()
+        {
+            auto row = get_row();
+            if(!row)
+                return {};
+
+            return row.read_tuple<Args...>();
+        }
+
+        /// Read entire CSV data into a vector of vectors
+
+        /// @tparam T Type to convert fields to. Defaults to std::string
+        /// @returns 2D vector of CSV data.
+        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+        /// @throws IO_error if error reading CSV data
+        /// @throws Type_conversion_error if error converting to type T
+        template <typename T = std::string>
+        std::vector<std::vector<T>> read_all()
+        {
+            std::vector<std::vector<T>> data;
+            while(true)
+            {
+                auto row = read_row_vec<T>();
+                if(row)
+                    data.push_back(std::move(*row));
+                else
+                    break;
+            }
+            return data;
+        }
+
+        /// Read entire CSV data into a vector per column
+
+        /// Fields are gathered a batch of rows at a time, and then converted one
+        /// column at a time, so each column's values end up in one contiguous
+        /// vector instead of being spread across a vector per row.
+        /// @tparam Ts Types to convert each column to. Fields past the last
+        /// column are ignored. Rows with fewer fields than there are columns
+        /// get default initialized values for the missing columns
+        /// @returns std::tuple containing a vector for each column
+        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+        /// @throws IO_error if error reading CSV data
+        /// @throws Type_conversion_error if error converting to specified types.
+        /// Unlike read_field, the conversion can not be retried, as the
+        /// remainder of the batch has already been read
+        template <typename ... Ts>
+        std::tuple<std::vector<Ts>...> read_columns()
+        {
+            static_assert(sizeof...(Ts) > 0, "read_columns requires at least one column type");
+            static_assert((!std::is_same_v<Ts, std::string_view> && ...), "std::string_view columns would not outlive the rows they were read from");
+
+            return read_columns<Ts...>(std::index_sequence_for<Ts...>{});
+        }
+
+        /// Move to a row
+
+        /// Jumps to the closest checkpoint in \c index at or before \c row,
+        /// and skips forward from there, so the next row read will be \c row.
+        /// Line and column numbers in error messages are those of the full input.
+        ///
+        /// Projection and filtering apply to the rows read after seeking, but
+        /// not to the rows skipped over to reach \c row. If \c row does not
+        /// pass the filter, the next row that does will be read instead
+        /// @param index Index built from the same input, with the same delimiter, quote, and lenient settings
+        /// @param row Row number to move to
+        /// @returns \c false if \c row is beyond the end of the input. The
+        /// Reader is then at the end of the input
+        /// @throws Parse_error if error parsing the skipped rows (*only when not parsing in lenient mode*)
+        /// @throws IO_error if error reading CSV data, or if the input can not be repositioned
+        bool seek_to_row(const Row_index & index, std::uint64_t row)
+        {
+            auto skip = row;
+            if(std::empty(index.checkpoints_))
+            {
+                seek({0, 1, 0});
+            }
+            else
+            {
+                auto i = std::min(row / index.interval_, static_cast<std::uint64_t>(std::size(index.checkpoints_) - 1));
+                seek(index.checkpoints_[static_cast<std::size_t>(i)]);
+                skip -= i * index.interval_;
+            }
+
+            for(; skip > 0; --skip)
+            {
+                skip_newlines();
+                if(eof())
+                    return false;
+
+                end_of_row_ = false;
+                skip_to_row_end();
+            }
+
+            // start the target row now, so eof() is accurate
+            consume_newlines();
+            return !eof();
+        }
+
+    private:
+        friend Parallel_reader;
+        friend Read_ahead_reader;
+        friend Row_index;
+
+        // Raw field data for one column of a read_columns batch
+        struct Column_batch
+        {
+            // offset into data of a field that was missing from its row
+            static constexpr auto missing = std::string::npos;
+
+            std::string data;
+            std::vector<std::pair<std::size_t, std::size_t>> fields; // offset, size
+
+            void clear()
+            {
+                data.clear();
+                fields.clear();
+            }
+
+            void append(std::string_view field)
+            {
+                fields.emplace_back(std::size(data), std::size(field));
+                data.append(field);
+            }
+
+            void append_missing()
+            {
+                fields.emplace_back(missing, 0);
+            }
+
+            // convert every field in the batch, appending them to column
+            template <typename T>
+            void convert_to(std::vector<T> & column) const
+            {
+                column.reserve(std::size(column) + std::size(fields));
+                for(auto [offset, size]: fields)
+                {
+                    if(offset == missing)
+                    {
+                        column.emplace_back();
+                        continue;
+                    }
+
+                    auto field = std::string_view{std::data(data) + offset, size};
+                    if constexpr(std::is_convertible_v<std::string, T>)
+                    {
+                        column.push_back(std::string{field});
+                    }
+                    else
+                    {
+                        auto field_val = detail::convert<T>(field);
+                        if(!field_val)
+                            throw Type_conversion_error(std::string{field});
+                        column.push_back(std::move(*field_val));
+                    }
+                }
+            }
+        };
+
+        // read_columns, with an index for each column
+        template <typename ... Ts, std::size_t ... Is>
+        std::tuple<std::vector<Ts>...> read_columns(std::index_sequence<Is...>)
+        {
+            // large enough to amortize the per-batch overhead, small enough
+            // that the raw fields of a batch stay in cache while converting
+            constexpr std::size_t batch_rows = 4096;
+            constexpr std::size_t num_columns = sizeof...(Ts);
+
+            std::tuple<std::vector<Ts>...> columns;
+            std::array<Column_batch, num_columns> batch;
+
+            while(true)
+            {
+                for(auto & column: batch)
+                    column.clear();
+
+                std::size_t rows = 0;
+                for(; rows < batch_rows; ++rows)
+                {
+                    consume_newlines();
+                    if(eof())
+                        break;
+
+                    std::size_t col = 0;
+                    do
+                    {
+                        auto field = read_field<std::string_view>();
+                        if(col < num_columns)
+                            batch[col].append(field);
+                        ++col;
+                    } while(!end_of_row());
+
+                    for(; col < num_columns; ++col)
+                        batch[col].append_missing();
+                }
+
+                (batch[Is].convert_to(std::get<Is>(columns)), ...);
+
+                if(rows < batch_rows)
+                    break;
             }
 
-        private:
-            Reader * reader_ { nullptr }; ///< pointer to parent Reader object or nullptr if no rows remain
-            value_type obj_; ///< Storage for the current Row
-        };
+            return columns;
+        }
 
-        /// Use a std::istream for CSV parsing
+        /// Parse CSV from an input source
 
-        /// @param input_stream std::istream to read from
+        /// @param source Input source
         /// @param delimiter Delimiter character
         /// @param quote Quote character
         /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
-        /// @warning \c input_stream must not be destroyed or read from during the lifetime of this Reader
-        explicit Reader(std::istream & input_stream,
-                const char delimiter = ',', const char quote = '"',
-                const bool lenient = false):
-            input_stream_{&input_stream},
+        Reader(std::unique_ptr<detail::Input_source> source,
+                const char delimiter, const char quote, const bool lenient):
+            source_{std::move(source)},
             delimiter_{delimiter},
             quote_{quote},
             lenient_{lenient}
         {}
 
-        /// Open a file for CSV parsing
+        /// Get next character from input
 
-        /// @param filename Path to a file to parse
-        /// @param delimiter Delimiter character
-        /// @param quote Quote character
-        /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
-        /// @throws IO_error if there is an error opening the file
-        explicit Reader(const std::string & filename,
-                const char delimiter = ',', const char quote = '"',
-                const bool lenient = false):
-            internal_input_stream_{std::make_unique<std::ifstream>(filename)},
-            input_stream_{internal_input_stream_.get()},
-            delimiter_{delimiter},
-            quote_{quote},
-            lenient_{lenient}
+        /// Updates line and column position, and checks for IO error
+        /// @returns Next character
+        /// @throws IO_error
+        int getc()
         {
-            if(!(*internal_input_stream_))
-                throw IO_error("Could not open file '" + filename + "'", errno);
-        }
+            if(pos_ == end_ && !refill())
+                return std::istream::traits_type::eof();
 
-        /// Disambiguation tag type
-
-        /// Distinguishes opening a Reader with a filename from opening a Reader
-        /// with a string
-        struct input_string_t{};
+            int c = std::istream::traits_type::to_int_type(*pos_++);
 
-        /// Disambiguation tag
+            if(c == '\n')
+            {
+                ++line_no_;
+                col_no_ = 0;
+            }
+            else if(c != std::istream::traits_type::eof())
+                ++col_no_;
 
-        /// Distinguishes opening a Reader with a filename from opening a Reader
-        /// with a string
-        static inline constexpr input_string_t input_string{};
+            return c;
+        }
 
-        /// Parse CSV from memory
+        /// Refill the input buffer
+
+        /// Reads the next block of data from the input source. Data before the
+        /// start of the current row is discarded, so this should only be
+        /// called once the buffer has been consumed.
+        ///
+        /// Fields of the current row may have been handed out as views, so
+        /// the row is never moved within the buffer that holds it. Instead, it is
+        /// copied to a spare buffer, and the old buffer is retired until the
+        /// next row starts
+        /// @returns \c false if no data remains in the input
+        /// @throws IO_error
+        bool refill()
+        {
+            if(source_eof_)
+                return false;
 
-        /// Use Reader::input_string to distinguish this constructor from the
-        /// constructor accepting a filename
-        /// @param input_data \c std::string containing CSV to parse
-        /// @param delimiter Delimiter character
-        /// @param quote Quote character
-        /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
-        Reader(input_string_t, const std::string & input_data,
-                const char delimiter = ',', const char quote = '"',
-                const bool lenient = false):
-            internal_input_stream_{std::make_unique<std::istringstream>(input_data)},
-            input_stream_{internal_input_stream_.get()},
-            delimiter_{delimiter},
-            quote_{quote},
-            lenient_{lenient}
-        {}
+            if(auto contents = source_->contents(); contents)
+            {
+                // input is already in memory. Parse it in place
+                pos_ = contents;
+                end_ = contents + source_->contents_size();
+                source_eof_ = true;
+
+                indexed_ = true;
+                index_.reset(pos_);
+                synced_pos_ = pos_;
+            }
+            else
+            {
+                const char * keep = row_start_ ? row_start_ : end_;
+                std::size_t keep_size = end_ - keep;
 
-        ~Reader() = default;
+                // grow the buffer if the kept data would leave less than half of it free
+                auto capacity = std::max(buffer_size_, 2 * keep_size);
 
-        Reader(const Reader &) = delete;
-        Reader & operator=(const Reader &) = delete;
-        Reader(Reader &&) = default;
-        Reader & operator=(Reader &&) = default;
+                if(keep_size > 0)
+                {
+                    Buffer next;
+                    if(spare_buffer_.capacity >= capacity)
+                        next = std::exchange(spare_buffer_, Buffer{});
+                    else
+                        next = Buffer{std::make_unique<char[]>(capacity), capacity};
 
-        /// Check for end of input
+                    std::memcpy(next.data.get(), keep, keep_size);
 
-        /// @returns \c true if the last field in the row has been read
-        bool end_of_row() const { return end_of_row_ || eof(); }
+                    auto offset = next.data.get() - keep;
+                    row_start_ += offset;
+                    if(field_start_)
+                        field_start_ += offset;
 
-        /// Check for end of row
+                    retired_buffers_.emplace_back(std::move(buffer_));
+                    buffer_ = std::move(next);
+                }
+                else if(buffer_.capacity != buffer_size_)
+                {
+                    buffer_ = Buffer{std::make_unique<char[]>(buffer_size_), buffer_size_};
+                }
 
-        /// @returns \c true if no fields remain in the current row
-        bool eof() const { return state_ == State::eof; }
+                auto size = source_->read(buffer_.data.get() + keep_size, buffer_.capacity - keep_size);
+                pos_ = buffer_.data.get() + keep_size;
+                end_ = pos_ + size;
+                input_offset_ += size;
 
-        /// @returns \c true if there is more data to be read
-        operator bool() { return !eof(); }
+                if(size == 0)
+                    source_eof_ = true;
+            }
 
-        /// Change the delimiter character
+            return pos_ != end_;
+        }
 
-        /// @param delimiter New delimiter character
-        void set_delimiter(const char delimiter) { delimiter_ = delimiter; }
-        /// Change the quote character
+        /// Start a new row
 
-        /// @param quote New quote character
-        void set_quote(const char quote) { quote_ = quote; }
+        /// Invalidates any views handed out for the previous row, and allows
+        /// their storage to be reused
+        void release_row()
+        {
+            row_start_ = nullptr;
+            field_storage_used_ = 0;
 
-        /// Enable / disable lenient parsing
+            if(!std::empty(retired_buffers_))
+            {
+                if(retired_buffers_.back().capacity > spare_buffer_.capacity)
+                    spare_buffer_ = std::move(retired_buffers_.back());
+                retired_buffers_.clear();
+            }
+        }
 
-        /// Lenient parsing will attempt to ignore syntax errors in CSV input.
-        /// @param lenient \c true for lenient parsing
-        void set_lenient(const bool lenient) { lenient_ = lenient; }
+        /// Get storage for an unescaped field
 
-        /// @returns Iterator to current row
-        Iterator begin()
+        /// @returns An empty string that remains valid until the next row starts
+        std::string & new_field_storage()
         {
-            return Iterator(*this);
+            if(field_storage_used_ == std::size(field_storage_))
+                field_storage_.emplace_back();
+
+            auto & storage = field_storage_[field_storage_used_++];
+            storage.clear();
+            return storage;
         }
 
-        /// @returns Iterator to end of CSV data
-        auto end()
+        /// Start the next row
+
+        /// Consumes newlines up to the next row. When projecting or filtering,
+        /// also reads the row's buffered fields, passing over any rows that do
+        /// not match the filter
+        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+        /// @throws IO_error
+        void consume_newlines()
         {
-            return Iterator();
+            if(state_ != State::consume_newlines)
+                return;
+
+            do
+            {
+                skip_newlines();
+            } while(!eof() && (!std::empty(projection_) || filter_) && !read_buffered_row());
         }
 
-        /// Read a single field
+        /// Consume newline characters
 
-        /// Check end_of_row() to see if this is the last field in the current row
-        /// @tparam T Type to convert fields to. Defaults to std::string
-        /// @returns The next field from the row, or a default-initialized object if past the end of the input data
-        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
-        /// @throws IO_error if error reading CSV data
-        /// @throws Type_conversion_error if error converting to type T. Caller may call this again with a different type to try again
-        template<typename T = std::string>
-        T read_field()
+        /// Advance stream position until first non-newline character
+        /// @throws IO_error
+        void skip_newlines()
         {
-            if(eof())
-                return {};
+            if(state_ != State::consume_newlines)
+                return;
 
-            end_of_row_ = false;
+            release_row();
+            buffered_fields_.clear();
+            buffered_next_ = 0;
+            row_tail_ = false;
 
-            std::string field;
-            if(conversion_retry_)
-            {
-                field = *conversion_retry_;
-                conversion_retry_.reset();
-            }
-            else
-            {
-                field = parse();
-            }
+            if(pos_ == end_)
+                refill();
 
-            // no conversion needed for strings
-            if constexpr(std::is_convertible_v<std::string, T>)
+            if(indexed_)
             {
-                return field;
+                // line and column are updated lazily. See sync_position
+                while(pos_ != end_ && (*pos_ == '\r' || *pos_ == '\n'))
+                    ++pos_;
+
+                if(pos_ == end_)
+                {
+                    end_of_row_ = true;
+                    state_ = State::eof;
+                }
+                else
+                {
+                    state_ = State::read;
+                    row_start_ = pos_;
+                }
+                return;
             }
-            else
+
+            while(true)
             {
-                T field_val{};
-                std::istringstream convert(field);
-                convert>>field_val;
-                if(!convert || convert.peek() != std::istream::traits_type::eof())
+                if(int c = getc(); c == std::istream::traits_type::eof())
+                {
+                    end_of_row_ = true;
+                    state_ = State::eof;
+                    break;
+                }
+                else if(c != '\r' && c != '\n')
                 {
-                    conversion_retry_ = field;
-                    throw Type_conversion_error(field);
+                    state_ = State::read;
+                    --pos_; // always valid, as refill only happens before reading a character
+                    --col_no_;
+                    row_start_ = pos_;
+                    break;
                 }
-
-                return field_val;
             }
         }
 
-        /// Read a single field
+        /// Core parsing method
 
-        /// Check end_of_row() to see if this is the last field in the current row
-        /// @param[out] data Variable to to write field to
-        /// @returns This Reader object
+        /// Reads and parses character stream to obtain next field
+        /// @returns Next field, or empty string if at EOF. The returned view
+        /// points into the input buffer when the field could be taken as-is, or
+        /// to field storage when it needed to be unescaped. It is valid until
+        /// the next row starts
         /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
-        /// @throws IO_error if error reading CSV data
-        /// @throws Type_conversion_error if error converting to type T. Caller may call this again with a different type to try again
-        template<typename T>
-        Reader & operator>>(T & data)
+        /// @throws IO_error if error reading from stream
+        std::string_view parse()
         {
-            data = read_field<T>();
-            return * this;
+            if(!std::empty(projection_) || filter_)
+                return parse_buffered();
+
+            return parse_field(false);
         }
 
-        /// Reads fields into variadic arguments
+        /// Parse next field from the input
 
-        /// @warning This may be used to fields from multiple rows at a time.
-        /// Use with caution if the number of fields per row is not known
-        /// beforehand.
-        /// @param[out] data Variables to read into.
-        /// If more parameters are passed than there are fields remaining,
-        /// the remaining parameters will be default initialized
+        /// @param skip Skip over the field without unescaping it. The returned
+        /// view is not meaningful, but errors are reported as usual
+        /// @returns Next field, or empty string if at EOF
         /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
-        /// @throws IO_error if error reading CSV data
-        /// @throws Type_conversion_error if error converting to specified types
-        template <typename ... Data>
-        void read_v(Data & ... data)
+        /// @throws IO_error if error reading from stream
+        std::string_view parse_field(bool skip)
         {
-            (void)(*this >> ... >> data);
+            if(state_ == State::consume_newlines)
+                consume_newlines();
+
+            if(eof())
+                return {};
+
+            if(indexed_ && index_usable())
+            {
+                if(auto field = parse_indexed(skip); field)
+                    return *field;
+            }
+
+            return parse_chars(skip);
         }
 
-        /// Get the current Row
+        /// Return the next field when projecting or filtering
 
-        /// @returns Row object for the current row
-        Row get_row()
+        /// Fields buffered by read_buffered_row are returned first. When
+        /// filtering without a projection, the rest of the row follows
+        /// @returns Next field, or empty string if at EOF
+        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+        /// @throws IO_error if error reading from stream
+        std::string_view parse_buffered()
         {
-            consume_newlines();
-            if(eof())
-                return Row{};
-            else
-                return Row{*this};
+            if(buffered_next_ == std::size(buffered_fields_))
+            {
+                if(row_tail_)
+                {
+                    auto field = parse_field(false);
+                    row_tail_ = !end_of_row_;
+                    return field;
+                }
+
+                consume_newlines();
+                if(eof())
+                    return {};
+
+                // the row was started before projecting or filtering was enabled
+                while(std::empty(buffered_fields_) && !read_buffered_row())
+                {
+                    consume_newlines();
+                    if(eof())
+                        return {};
+                }
+            }
+
+            auto field = buffered_fields_[buffered_next_++];
+            end_of_row_ = buffered_next_ == std::size(buffered_fields_) && !row_tail_;
+            return field;
         }
 
-        /// Reads current row into an output iterator
+        /// Read the start of the current row into buffered_fields_
 
-        /// @tparam T Type to convert fields to. Defaults to std::string
-        /// @param it An output iterator to receive the row data
-        /// @returns \c false if this is the last row
+        /// Fields are read up to the last projected column and the filter
+        /// column. Unprojected fields are skipped, and once the filter
+        /// has rejected a row, the remainder is skipped with skip_to_row_end.
+        /// Projected rows are always skipped to the end, while filtered rows
+        /// without a projection continue to be read by parse_buffered
+        /// @returns \c false if the row was rejected by the filter
         /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
-        /// @throws IO_error if error reading CSV data
-        /// @throws Type_conversion_error if error converting to type T
-        template <typename T = std::string, typename OutputIter>
-        bool read_row(OutputIter it)
+        /// @throws IO_error if error reading from stream
+        bool read_buffered_row()
         {
-            auto row = get_row();
-            if(!row)
+            bool projecting = !std::empty(projection_);
+            if(projecting)
+                buffered_fields_.assign(std::size(projection_), std::string_view{});
+            else
+                buffered_fields_.clear();
+            buffered_next_ = 0;
+            row_tail_ = false;
+
+            auto last = projecting ? projection_last_ : 0;
+            if(filter_)
+                last = std::max(last, filter_column_);
+
+            end_of_row_ = false;
+            std::size_t col = 0;
+            for(; col <= last && !end_of_row_; ++col)
+            {
+                bool projected = !projecting || (col < std::size(projection_columns_) && projection_columns_[col]);
+                bool filtered = filter_ && col == filter_column_;
+                if(!projected && !filtered)
+                {
+                    parse_field(true);
+                    continue;
+                }
+
+                auto field = parse_field(false);
+                if(filtered && !filter_(field))
+                {
+                    skip_to_row_end();
+                    return false;
+                }
+
+                if(!projecting)
+                {
+                    buffered_fields_.push_back(field);
+                    continue;
+                }
+
+                for(std::size_t i = 0; i < std::size(projection_); ++i)
+                {
+                    if(projection_[i] == col)
+                        buffered_fields_[i] = field;
+                }
+            }
+
+            // rows too short to have the filter column are checked as if it were empty
+            if(filter_ && col <= filter_column_ && !filter_({}))
+            {
+                skip_to_row_end();
                 return false;
+            }
+
+            if(projecting)
+            {
+                // drop trailing columns the row was too short to contain, so
+                // short rows stay short
+                auto size = std::size(projection_);
+                while(size > 1 && projection_[size - 1] >= col)
+                    --size;
+                buffered_fields_.resize(size);
+
+                skip_to_row_end();
+            }
+            else
+            {
+                row_tail_ = !end_of_row_;
+            }
 
-            row.read<T>(it);
             return true;
         }
 
-        /// Reads current row into a std::vector
+        /// Skip any remaining fields in the current row
 
-        /// @tparam T Type to convert fields to. Defaults to std::string
-        /// @returns std::vector containing the fields from the row or empty optional if no rows remain
+        /// With the structural index, unquoted fields are passed over by
+        /// following delimiters in the index until reaching a newline. Quoted
+        /// fields, and all fields from streams, are skipped with parse_field,
+        /// so errors are reported identically
         /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
-        /// @throws IO_error if error reading CSV data
-        /// @throws Type_conversion_error if error converting to type T
-        template <typename T = std::string>
-        std::optional<std::vector<T>> read_row_vec()
+        /// @throws IO_error if error reading from stream
+        void skip_to_row_end()
         {
-            auto row = get_row();
-            if(!row)
-                return {};
+            while(!end_of_row_)
+            {
+                if(indexed_ && index_usable() && pos_ != end_ && *pos_ != quote_)
+                {
+                    auto terminator = index_.next(pos_, end_, delimiter_, quote_);
+                    if(terminator == end_)
+                    {
+                        pos_ = end_;
+                        end_of_row_ = true;
+                        state_ = State::consume_newlines;
+                        break;
+                    }
+                    else if(*terminator == delimiter_)
+                    {
+                        pos_ = terminator + 1;
+                        continue;
+                    }
+                    else if(*terminator != quote_)
+                    {
+                        pos_ = terminator + 1;
+                        end_of_row_ = true;
+                        state_ = State::consume_newlines;
+                        break;
+                    }
+                    // a quote in an unquoted field is an error. Let parse_field report it
+                }
 
-            return row.read_vec<T>();
+                parse_field(true);
+            }
         }
 
-        /// Reads current row into a tuple
+        /// Report a parse error
 
-        /// @tparam Args types to convert fields to
-        /// @returns std::tuple containing the fields from the row or empty
-        /// optional if no rows remain. If Args contains more elements than there
-        /// are fields in the row, the remaining elements of the tuple will be
-        /// default initialized
-        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
-        /// @throws IO_error if error reading CSV data
-        /// @throws Type_conversion_error if error converting to specified types
-        template <typename ... Args>
-        std::optional<std::tuple<Args...>> read_row_tuple()
+        /// Throws Parse_error, unless a non-throwing method is reading, in
+        /// which case the first error is recorded in error_sink_. The caller
+        /// ends the row at the error when this returns
+        /// @param type Parsing error type. Must be a string literal
+        /// @param line_no Line that the error occured on
+        /// @param col_no Column that the error occured on
+        /// @throws Parse_error if not reading from a non-throwing method
+        CSVPP_COLD void parse_error(const char * type, int line_no, int col_no)
         {
-            auto row = get_row();
-            if(!row)
-                return {};
+            if(!error_sink_)
+                throw Parse_error(type, line_no, col_no);
 
-            return row.read_tuple<Args...>();
+            if(!*error_sink_)
+                error_sink_->emplace(Error_kind::parse, type, std::string_view{}, line_no, col_no);
         }
 
-        /// Read entire CSV data into a vector of vectors
+        /// Report a type conversion error
 
-        /// @tparam T Type to convert fields to. Defaults to std::string
-        /// @returns 2D vector of CSV data.
-        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
-        /// @throws IO_error if error reading CSV data
-        /// @throws Type_conversion_error if error converting to type T
-        template <typename T = std::string>
-        std::vector<std::vector<T>> read_all()
+        /// Saves the field so the caller may retry with another type
+        /// @param field Field that failed to convert
+        /// @throws Type_conversion_error always
+        [[noreturn]] CSVPP_COLD void conversion_error(std::string_view field)
         {
-            std::vector<std::vector<T>> data;
-            while(true)
-            {
-                auto row = read_row_vec<T>();
-                if(row)
-                    data.push_back(*row);
-                else
-                    break;
-            }
-            return data;
+            conversion_retry_ = std::string{field};
+            throw Type_conversion_error(*conversion_retry_);
         }
 
-    private:
-
-        /// Get next character from input
+        /// Run a read without throwing
 
-        /// Updates line and column position, and checks for IO error
-        /// @returns Next character
-        /// @throws IO_error
-        int getc()
+        /// Parse errors are recorded instead of thrown, and all exceptions are caught
+        /// @param read Function performing the read
+        /// @returns The first error that occured, if any
+        template <typename F>
+        std::optional<Read_error> try_read(F && read) noexcept
         {
-            int c = input_stream_->get();
-            if(input_stream_->bad() && !input_stream_->eof())
-                throw IO_error{"Error reading from input", errno};
-
-            if(c == '\n')
+            std::optional<Read_error> error;
+            error_sink_ = &error;
+            try
             {
-                ++line_no_;
-                col_no_ = 0;
+                read();
             }
-            else if(c != std::istream::traits_type::eof())
-                ++col_no_;
-
-            return c;
-        }
-
-        /// Consume newline characters
-
-        /// Advance stream position until first non-newline character
-        /// @throws IO_error
-        void consume_newlines()
-        {
-            if(state_ != State::consume_newlines)
-                return;
-
-            while(true)
+            catch(const IO_error &)
             {
-                if(int c = getc(); c == std::istream::traits_type::eof())
-                {
-                    end_of_row_ = true;
-                    state_ = State::eof;
-                    break;
-                }
-                else if(c != '\r' && c != '\n')
-                {
-                    state_ = State::read;
-                    input_stream_->unget();
-                    --col_no_;
-                    break;
-                }
+                if(!error)
+                    error.emplace(std::current_exception());
+            }
+            catch(...)
+            {
+                if(!error)
+                    error.emplace(std::current_exception(), Error_kind::other);
             }
+            error_sink_ = nullptr;
+            return error;
         }
 
-        /// Core parsing method
+        /// Parse next field character-by-character
 
-        /// Reads and parses character stream to obtain next field
-        /// @returns Next field, or empty string if at EOF
+        /// Handles any field, including malformed ones. Used for all fields
+        /// from streams, and when parse_indexed() can not handle a field
+        /// @param skip Skip over the field without unescaping it
+        /// @returns Next field. Valid until the next row starts. Not
+        /// meaningful when \c skip is set
         /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
         /// @throws IO_error if error reading from stream
-        std::string parse()
+        std::string_view parse_chars(bool skip)
         {
-            consume_newlines();
-
-            if(eof())
-                return {};
+            // restart the index after this field
+            if(indexed_)
+                sync_position();
 
             bool quoted = false;
-            std::string field;
+
+            // The field's contents are tracked as offsets from field_start_,
+            // which refill() keeps in the buffer. Contents are only copied into
+            // separate storage when they stop being contiguous in the input (ie.
+            // when unescaping a quote)
+            field_start_ = pos_;
+            std::size_t field_begin = 0;
+            std::size_t field_end = 0;
+            std::string * materialized = nullptr;
+            bool escaped = false; // contents are no longer contiguous. Same as materialized, unless skipping
+
+            auto append = [&](std::size_t begin, std::size_t end)
+            {
+                if(!escaped && begin == field_end)
+                {
+                    field_end = end;
+                }
+                else if(!skip)
+                {
+                    escaped = true;
+                    if(!materialized)
+                    {
+                        materialized = &new_field_storage();
+                        materialized->assign(field_start_ + field_begin, field_end - field_begin);
+                    }
+                    materialized->append(field_start_ + begin, end - begin);
+                }
+                else
+                {
+                    escaped = true;
+                }
+            };
 
             bool field_done = false;
             while(!field_done)
             {
                 int c = getc();
+                std::size_t c_pos = pos_ - field_start_ - 1; // not meaningful at EOF, but not used there either
+
                 bool c_done = false;
                 while(!c_done)
                 {
@@ -940,21 +4125,26 @@ namespace csv
                         // if it's not an escaped quote, then it's an error
                         else if(c == quote_)
                         {
-                            field += c;
+                            append(c_pos, c_pos + 1);
                             state_ = State::read;
                             c_done = true;
                             break;
                         }
                         else if(lenient_)
                         {
-                            field += quote_;
-                            field += c;
+                            // previous character was the quote
+                            append(c_pos - 1, c_pos + 1);
                             state_ = State::read;
                             c_done = true;
                             break;
                         }
                         else
-                            throw Parse_error("Unescaped quote", line_no_, col_no_ - 1);
+                        {
+                            parse_error("Unescaped quote", line_no_, col_no_ - 1);
+                            end_of_row_ = field_done = c_done = true;
+                            state_ = State::consume_newlines;
+                            break;
+                        }
 
                     case State::read:
                         // we need special handling for quotes
@@ -968,16 +4158,20 @@ namespace csv
                             }
                             else
                             {
-                                if(field.empty())
+                                if(!escaped && field_begin == field_end)
                                 {
                                     quoted = true;
+                                    field_begin = field_end = c_pos + 1;
                                     c_done = true;
                                     break;
                                 }
                                 else if(!lenient_)
                                 {
                                     // quotes are not allowed inside of an unquoted field
-                                    throw Parse_error("quote found in unquoted field", line_no_, col_no_);
+                                    parse_error("quote found in unquoted field", line_no_, col_no_);
+                                    end_of_row_ = field_done = c_done = true;
+                                    state_ = State::consume_newlines;
+                                    break;
                                 }
                             }
                         }
@@ -991,7 +4185,12 @@ namespace csv
                                 break;
                             }
                             else
-                                throw Parse_error("Unterminated quoted field - reached end-of-file", line_no_, col_no_);
+                            {
+                                parse_error("Unterminated quoted field - reached end-of-file", line_no_, col_no_);
+                                end_of_row_ = field_done = c_done = true;
+                                state_ = State::consume_newlines;
+                                break;
+                            }
                         }
                         else if(!quoted && c == delimiter_)
                         {
@@ -1005,7 +4204,19 @@ namespace csv
                             break;
                         }
 
-                        field += c;
+                        append(c_pos, c_pos + 1);
+
+                        // skip over the run of ordinary characters that follows.
+                        // It contains no newlines, so only the column changes
+                        if(auto run_end = detail::find_structural(pos_, end_, delimiter_, quote_); run_end != pos_)
+                        {
+                            auto run_begin = static_cast<std::size_t>(pos_ - field_start_);
+                            auto run_size = static_cast<std::size_t>(run_end - pos_);
+                            append(run_begin, run_begin + run_size);
+                            col_no_ += static_cast<unsigned int>(run_size);
+                            pos_ = run_end;
+                        }
+
                         c_done = true;
                         break;
 
@@ -1015,24 +4226,233 @@ namespace csv
                     }
                 }
             }
+
+            auto field = materialized ? std::string_view{*materialized} : std::string_view{field_start_ + field_begin, field_end - field_begin};
+            field_start_ = nullptr;
+
+            if(indexed_)
+            {
+                synced_pos_ = pos_;
+                index_.reset(pos_);
+            }
+
+            return field;
+        }
+
+        /// Check if the structural index can be used with the current delimiter and quote
+
+        /// @returns \c false if the delimiter and quote are not distinct from each other and from newlines
+        bool index_usable() const
+        {
+            return delimiter_ != quote_
+                && delimiter_ != '\r' && delimiter_ != '\n'
+                && quote_ != '\r' && quote_ != '\n';
+        }
+
+        /// Parse next field using the structural index
+
+        /// Only handles well-formed fields. Anything that could be an error,
+        /// or that lenient parsing would have to recover from, is left for
+        /// parse() to handle character-by-character
+        /// @param skip Skip over the field without unescaping it
+        /// @returns Next field, or \c std::nullopt if the field was not
+        /// well-formed. Parsing state is unchanged in that case. The field is
+        /// not meaningful when \c skip is set
+        std::optional<std::string_view> parse_indexed(bool skip)
+        {
+            auto next = [this](const char * from) { return index_.next(from, end_, delimiter_, quote_); };
+
+            std::string_view field;
+            const char * terminator = nullptr;
+
+            if(pos_ != end_ && *pos_ == quote_)
+            {
+                // delimiters and newlines inside the quotes are not indexed, so
+                // each structural character is either an escaped quote or the
+                // closing quote
+                std::string * materialized = nullptr;
+                auto segment = pos_ + 1;
+                auto quote = next(segment);
+
+                while(true)
+                {
+                    if(quote == end_ || *quote != quote_)
+                        return std::nullopt;
+
+                    auto after = quote + 1;
+                    if(after != end_ && *after == quote_)
+                    {
+                        if(skip)
+                        {
+                            segment = after + 1;
+                            quote = next(segment);
+                            continue;
+                        }
+
+                        if(!materialized)
+                            materialized = &new_field_storage();
+
+                        materialized->append(segment, after); // keep one of the two quotes
+                        segment = after + 1;
+                        quote = next(segment);
+                        continue;
+                    }
+
+                    if(after != end_ && *after != delimiter_ && *after != '\r' && *after != '\n')
+                        return std::nullopt;
+
+                    if(materialized)
+                    {
+                        materialized->append(segment, quote);
+                        field = *materialized;
+                    }
+                    else
+                    {
+                        field = std::string_view{segment, static_cast<std::size_t>(quote - segment)};
+                    }
+
+                    terminator = after;
+                    break;
+                }
+            }
+            else
+            {
+                terminator = next(pos_);
+                if(terminator != end_ && *terminator == quote_)
+                    return std::nullopt;
+
+                field = std::string_view{pos_, static_cast<std::size_t>(terminator - pos_)};
+            }
+
+            if(terminator == end_)
+            {
+                pos_ = end_;
+                end_of_row_ = true;
+                state_ = State::consume_newlines;
+            }
+            else
+            {
+                pos_ = terminator + 1;
+                if(*terminator != delimiter_)
+                {
+                    end_of_row_ = true;
+                    state_ = State::consume_newlines;
+                }
+            }
+
             return field;
         }
 
-        /// Owns an istream created by this Reader (either an ifstream when
-        /// constructed by filename or a istringstream when constructed by input
-        /// string)
-        std::unique_ptr<std::istream> internal_input_stream_;
+        /// Update line and column numbers to the current position
+
+        /// When using the structural index, positions are not tracked for
+        /// each character, so this must be called before anything that
+        /// relies on them
+        void sync_position()
+        {
+            auto p = synced_pos_;
+            while(auto newline = static_cast<const char *>(std::memchr(p, '\n', static_cast<std::size_t>(pos_ - p))))
+            {
+                ++line_no_;
+                col_no_ = 0;
+                p = newline + 1;
+            }
+            col_no_ += static_cast<unsigned int>(pos_ - p);
+            synced_pos_ = pos_;
+        }
+
+        /// Move to the start of a row
+
+        /// Discards the current row, and any buffered input
+        /// @param checkpoint Position to move to
+        /// @throws IO_error if the input can not be repositioned
+        /// @throws Out_of_range_error if the position is beyond the end of in-memory input
+        void seek(const Row_index::Checkpoint & checkpoint)
+        {
+            release_row();
+            conversion_retry_.reset();
+
+            if(auto contents = source_->contents(); contents)
+            {
+                if(!indexed_)
+                    refill();
+
+                if(checkpoint.offset > source_->contents_size())
+                    throw Out_of_range_error("Row index does not match input");
+
+                pos_ = contents + checkpoint.offset;
+                synced_pos_ = pos_;
+                index_.reset(pos_);
+            }
+            else
+            {
+                if(!source_->seek(checkpoint.offset))
+                    throw IO_error("Could not seek in input", ESPIPE);
+
+                pos_ = end_ = row_start_ = nullptr;
+                source_eof_ = false;
+                input_offset_ = checkpoint.offset;
+            }
+
+            line_no_ = static_cast<unsigned int>(checkpoint.line);
+            col_no_ = static_cast<unsigned int>(checkpoint.col);
+            end_of_row_ = false;
+            state_ = State::consume_newlines;
+        }
+
+        /// @param p Position within the current input buffer
+        /// @returns Byte offset of \c p from the start of the input
+        std::uint64_t offset_of(const char * p) const
+        {
+            if(indexed_)
+                return static_cast<std::uint64_t>(p - source_->contents());
+            return input_offset_ - static_cast<std::uint64_t>(end_ - p);
+        }
+
+        /// Input data source. Wraps the input istream, file, or string
+        std::unique_ptr<detail::Input_source> source_;
+
+        /// Input buffer storage
+        struct Buffer
+        {
+            std::unique_ptr<char[]> data; ///< Buffer contents
+            std::size_t capacity { 0 };   ///< Allocated size of data
+        };
 
-        /// Points to input istream. Will point to *internal_input_stream_ if
-        /// constructed by filename or input string, or the istream passed when
-        /// constructed by istream
-        std::istream * input_stream_;
+        Buffer buffer_;                                   ///< Input buffer. Unused if source_ holds input in memory
+        Buffer spare_buffer_;                             ///< Reused when the current row needs to be moved to a new buffer
+        std::vector<Buffer> retired_buffers_;             ///< Buffers holding fields from the current row. Released when the next row starts
+        std::size_t buffer_size_ { default_buffer_size }; ///< Requested size of buffer_. Takes effect on next refill
+        const char * pos_ { nullptr };                    ///< Current read position
+        const char * end_ { nullptr };                    ///< End of valid data in input buffer
+        bool source_eof_ { false };                       ///< \c true when source_ has no data remaining
+        const char * row_start_ { nullptr };              ///< Start of current row. Preserved across refills
+        const char * field_start_ { nullptr };            ///< Start of field being parsed
+        std::uint64_t input_offset_ { 0 };                ///< Offset in the input of end_. Unused if source_ holds input in memory
+
+        bool indexed_ { false };              ///< \c true when parsing in-memory input using index_
+        detail::Structural_index index_;      ///< Structural character index for in-memory input
+        const char * synced_pos_ { nullptr }; ///< Position that line_no_ and col_no_ are up to date with, when indexed_
+
+        std::deque<std::string> field_storage_;   ///< Storage for unescaped fields in the current row. Deque elements never move
+        std::size_t field_storage_used_ { 0 };    ///< Number of elements in field_storage_ in use by the current row
+        std::vector<std::string_view> row_view_;  ///< Storage for read_row_view
+
+        std::vector<std::size_t> projection_;            ///< Columns to read, in the order returned. Empty when reading all columns
+        std::vector<bool> projection_columns_;           ///< Flags for each column up to projection_last_. \c true if projected
+        std::size_t projection_last_ { 0 };              ///< Highest projected column
+        std::size_t filter_column_ { 0 };                       ///< Column checked by filter_
+        std::function<bool(std::string_view)> filter_;          ///< Row filter. Empty when reading all rows
+        std::vector<std::string_view> buffered_fields_;         ///< Fields read at the start of the current row when projecting or filtering
+        std::size_t buffered_next_ { 0 };                       ///< Next element of buffered_fields_ to return
+        bool row_tail_ { false };                               ///< Read the rest of the row after buffered_fields_
 
         char delimiter_ {','};   ///< Delimiter character
         char quote_ {'"'};       ///< Quote character
         bool lenient_ { false }; ///< Lenient parsing enabled / disabled
 
         std::optional<std::string> conversion_retry_; ///< Contains last field after type conversion error. Allows retrying conversion
+        std::optional<Read_error> * error_sink_ { nullptr }; ///< Where to record parse errors instead of throwing. Set while a non-throwing method is reading
         bool end_of_row_ { false }; ///< \c true if parsing is at the end of a row
 
         /// Parsing states
@@ -1051,6 +4471,44 @@ namespace csv
         unsigned int col_no_ { 0 };  ///< Current column number within input
     };
 
+    inline Row_index Row_index::build(const std::string & filename, std::size_t interval,
+            const char delimiter, const char quote,
+            const bool lenient)
+    {
+        assert(interval > 0);
+
+        Row_index index;
+        index.interval_ = interval;
+        index.delimiter_ = delimiter;
+        index.quote_ = quote;
+        index.lenient_ = lenient;
+
+        // taken before parsing, so a file modified while it is indexed is seen as out of date
+        if(auto stat = file_stat(filename); stat)
+            std::tie(index.file_size_, index.file_time_) = *stat;
+
+        Reader reader{filename, delimiter, quote, lenient};
+        while(true)
+        {
+            reader.consume_newlines();
+            if(reader.eof())
+                break;
+
+            if(index.rows_ % interval == 0)
+            {
+                if(reader.indexed_)
+                    reader.sync_position();
+                index.checkpoints_.push_back({reader.offset_of(reader.row_start_), reader.line_no_, reader.col_no_});
+            }
+
+            reader.end_of_row_ = false;
+            reader.skip_to_row_end();
+            ++index.rows_;
+        }
+
+        return index;
+    }
+
     /// Compare two Reader::Iterator objects
     inline bool operator==(const Reader::Iterator & lhs, const Reader::Iterator & rhs)
     {
@@ -1083,14 +4541,73 @@ namespace csv
     /// Map keys (headers) come from the first row unless specified by the header
     /// parameter to the constructor. If a row has more fields than the header,
     /// Out_of_range_error error will be thrown
+    ///
+    /// Each header's position is looked up once, when the headers are read.
+    /// Rows are stored as a flat vector of fields, so operator[] is a hash
+    /// table lookup and an index. The std::map returned by operator* and
+    /// operator-> is only built for rows where it is used
     template <typename Header = std::string, typename Value = std::string>
     class Map_reader_iter
     {
     private:
-        std::unique_ptr<Reader> reader_; ///< Reader object
-        Value default_val_;              ///< Default value
-        std::vector<Header> headers_;    ///< Headers
-        std::map<Header, Value> obj_;    ///< Current row storage
+        /// Header to field position lookup. Falls back to std::map for Header types without a std::hash
+        using Header_index = std::conditional_t<detail::is_hashable_v<Header>,
+              std::unordered_map<Header, std::size_t>,
+              std::map<Header, std::size_t>>;
+
+        std::unique_ptr<Reader> reader_;       ///< Reader object
+        Value default_val_;                    ///< Default value
+        std::vector<Header> headers_;          ///< Headers
+        Header_index header_index_;            ///< Position of each header
+        std::vector<Value> values_;            ///< Current row storage
+        std::vector<Value> next_values_;       ///< Next row storage. Swapped with values_ once the row has been read
+        mutable std::map<Header, Value> obj_;  ///< Current row as a map. Only valid when obj_current_ is set
+        mutable bool obj_current_ {false};     ///< Has obj_ been built for the current row
+
+        /// Read only the given columns
+
+        /// @param columns Headers of the columns to read. Pass an empty vector
+        /// to read all columns
+        /// @throws Out_of_range_error if one of \c columns is not a header
+        void project(const std::vector<Header> & columns)
+        {
+            if(std::empty(columns))
+                return;
+
+            std::vector<std::size_t> indices;
+            for(auto & header: columns)
+            {
+                auto col = std::find(std::begin(headers_), std::end(headers_), header);
+                if(col == std::end(headers_))
+                    throw Out_of_range_error("Header not found");
+                indices.push_back(static_cast<std::size_t>(col - std::begin(headers_)));
+            }
+
+            reader_->set_projection(indices);
+            headers_ = columns;
+        }
+
+        /// Look up the position of each header
+
+        /// When a header is repeated, its last position is used
+        void index_headers()
+        {
+            for(std::size_t i = 0; i < std::size(headers_); ++i)
+                header_index_[headers_[i]] = i;
+        }
+
+        /// Build the map view of the current row, if not yet built
+        std::map<Header, Value> & get_obj() const
+        {
+            if(!obj_current_)
+            {
+                obj_.clear();
+                for(std::size_t i = 0; i < std::size(values_); ++i)
+                    obj_[headers_[i]] = values_[i];
+                obj_current_ = true;
+            }
+            return obj_;
+        }
 
         /// Read header row from input (or use headers parameter)
 
@@ -1130,20 +4647,25 @@ namespace csv
         /// @param delimiter Delimiter character
         /// @param quote Quote character
         /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
+        /// @param columns Headers of the columns to read, as by
+        ///        Reader::set_projection. Pass an empty vector to read all columns
         /// @warning input_stream must not be destroyed or read from during the
         ///          lifetime of this Map_reader_iter
         /// @throws Parse_error if error parsing fields (*only when not parsing in lenient mode*)
         /// @throws IO_error if error reading CSV data
+        /// @throws Out_of_range_error if one of \c columns is not a header
         /// @throws Type_conversion_error if error converting 1st row to type
         /// Header (if headers param is empty), or 1st row to type Value (if
         /// header param is specified)
         explicit Map_reader_iter(std::istream & input_stream, const Value & default_val = {}, const std::vector<Header> & headers = {},
                 const char delimiter = ',', const char quote = '"',
-                const bool lenient = false):
+                const bool lenient = false, const std::vector<Header> & columns = {}):
             reader_{std::make_unique<Reader>(input_stream, delimiter, quote, lenient)},
             default_val_{default_val},
             headers_{get_header_row(headers)}
         {
+            project(columns);
+            index_headers();
             ++(*this);
         }
 
@@ -1156,18 +4678,23 @@ namespace csv
         /// @param delimiter Delimiter character
         /// @param quote Quote character
         /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
+        /// @param columns Headers of the columns to read, as by
+        ///        Reader::set_projection. Pass an empty vector to read all columns
         /// @throws Parse_error if error parsing fields (*only when not parsing in lenient mode*)
         /// @throws IO_error if error reading CSV data
+        /// @throws Out_of_range_error if one of \c columns is not a header
         /// @throws Type_conversion_error if error converting 1st row to type
         /// Header (if headers param is empty), or 1st row to type Value (if
         /// header param is specified)
         explicit Map_reader_iter(const std::string & filename, const Value & default_val = {}, const std::vector<Header> & headers = {},
                 const char delimiter = ',', const char quote = '"',
-                const bool lenient = false):
+                const bool lenient = false, const std::vector<Header> & columns = {}):
             reader_{std::make_unique<Reader>(filename, delimiter, quote, lenient)},
             default_val_{default_val},
             headers_{get_header_row(headers)}
         {
+            project(columns);
+            index_headers();
             ++(*this);
         }
 
@@ -1182,18 +4709,23 @@ namespace csv
         /// @param delimiter Delimiter character
         /// @param quote Quote character
         /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
+        /// @param columns Headers of the columns to read, as by
+        ///        Reader::set_projection. Pass an empty vector to read all columns
         /// @throws Parse_error if error parsing fields (*only when not parsing in lenient mode*)
         /// @throws IO_error if error reading CSV data
+        /// @throws Out_of_range_error if one of \c columns is not a header
         /// @throws Type_conversion_error if error converting 1st row to type
         /// Header (if headers param not specified), or 1st row to type Value (if
         /// header param is specified)
         Map_reader_iter(Reader::input_string_t, const std::string & input_data, const Value & default_val = {}, const std::vector<Header> & headers = {},
                 const char delimiter = ',', const char quote = '"',
-                const bool lenient = false):
+                const bool lenient = false, const std::vector<Header> & columns = {}):
             reader_{std::make_unique<Reader>(Reader::input_string, input_data, delimiter, quote, lenient)},
             default_val_{default_val},
             headers_{get_header_row(headers)}
         {
+            project(columns);
+            index_headers();
             ++(*this);
         }
 
@@ -1204,43 +4736,54 @@ namespace csv
         using iterator_category = std::input_iterator_tag;
 
         /// @returns Current row as a map
-        const value_type & operator*() const { return obj_; }
-        value_type & operator*() { return obj_; }
+        const value_type & operator*() const { return get_obj(); }
+        value_type & operator*() { return get_obj(); }
 
         /// @returns Pointer to current row map
-        const value_type * operator->() const { return &obj_; }
-        value_type * operator->() { return &obj_; }
+        const value_type * operator->() const { return &get_obj(); }
+        value_type * operator->() { return &get_obj(); }
 
         /// Get a field from the current row
 
-        /// This is a shortcut for `map_reader_iter->at(key)`
+        /// Equivalent to `map_reader_iter->at(key)`, without building the map
         /// @param key Header for the desired field
         /// @returns The requested field
         /// @throws std::out_or_range if the key is not a valid header
-        const typename value_type::mapped_type & operator[](const typename value_type::key_type & key) const { return obj_.at(key); }
-        typename value_type::mapped_type & operator[](const typename value_type::key_type & key) { return obj_.at(key); }
+        const typename value_type::mapped_type & operator[](const typename value_type::key_type & key) const
+        {
+            // once the map has been built, it may have been modified through operator*
+            if(obj_current_)
+                return obj_.at(key);
+            return values_[header_index_.at(key)];
+        }
+        typename value_type::mapped_type & operator[](const typename value_type::key_type & key)
+        {
+            if(obj_current_)
+                return obj_.at(key);
+            return values_[header_index_.at(key)];
+        }
 
         /// Iterate to next field
 
+        /// If an exception is thrown, the current row is left unchanged, and
+        /// iterating again continues with the row after the one that failed
         /// @throws Parse_error if error parsing fields (*only when not parsing in lenient mode*)
         /// @throws IO_error if error reading CSV data
         /// @throws Type_conversion_error if error converting fields to Value type
+        /// @throws Out_of_range_error if the row has more fields than the header
         Map_reader_iter & operator++()
         {
-            auto row = reader_->read_row_vec<Value>();
-            if(!row)
+            if(!reader_->read_row_into<Value>(next_values_))
                 reader_.reset();
             else
             {
-                if(std::size(*row) > std::size(headers_))
+                if(std::size(next_values_) > std::size(headers_))
                     throw Out_of_range_error("Too many fields");
 
-                for(std::size_t i = 0; i < std::size(*row); ++i)
-                    obj_[headers_[i]] = (*row)[i];
-
-                for(std::size_t i = std::size(*row); i < std::size(headers_); ++i)
-                    obj_[headers_[i]] = default_val_;
+                next_values_.resize(std::size(headers_), default_val_);
+                values_.swap(next_values_);
             }
+            obj_current_ = false;
 
             return *this;
         }
@@ -1259,6 +4802,14 @@ namespace csv
         {
             return headers_;
         }
+
+        /// Get the fields of the current row
+
+        /// @returns Fields, in the same order as the headers
+        const std::vector<Value> & get_values() const
+        {
+            return values_;
+        }
     };
 
     /// Compare two Map_reader_iter objects
@@ -1275,6 +4826,224 @@ namespace csv
         return !lhs.equals(rhs);
     }
 
+    /// Column index placeholder for Column
+
+    /// Places a column immediately after the previous column in the schema (or
+    /// at index 0 for the first column)
+    inline constexpr std::size_t next_column = static_cast<std::size_t>(-1);
+
+    /// Column of a Typed_reader schema
+
+    /// @tparam T Type to convert the column's fields to
+    /// @tparam Index Position of the column's field in each row
+    template <typename T, std::size_t Index = next_column>
+    struct Column
+    {
+        using type = T;
+        static constexpr std::size_t index = Index;
+    };
+
+    /// Reads rows with a fixed, compile-time schema
+
+    /// Each schema entry is either a type, or a Column specifying a type and
+    /// position. Plain types are placed immediately after the previous column.
+    /// Fields not named by the schema are skipped.
+    ///
+    /// Each row is read as a Reader::Row_view, its field count is checked once,
+    /// and then every column is converted directly to its destination, without
+    /// the per-field bookkeeping of Reader::read_field
+    ///
+    /// Example:
+    /// ```
+    /// // converts the 1st field to int, and the 4th and 5th to double
+    /// csv::Typed_reader<int, csv::Column<double, 3>, double> typed{reader};
+    /// ```
+    template <typename ... Columns>
+    class Typed_reader
+    {
+    private:
+        static_assert(sizeof...(Columns) > 0, "Typed_reader requires at least one column");
+
+        template <typename T>
+        struct Column_traits
+        {
+            using type = T;
+            static constexpr std::size_t index = next_column;
+        };
+        template <typename T, std::size_t Index>
+        struct Column_traits<Column<T, Index>>
+        {
+            using type = T;
+            static constexpr std::size_t index = Index;
+        };
+
+        /// @returns Position of each column in a row
+        static constexpr std::array<std::size_t, sizeof...(Columns)> get_indices()
+        {
+            constexpr std::size_t schema_indices[] = {Column_traits<Columns>::index...};
+
+            std::array<std::size_t, sizeof...(Columns)> indices{};
+            std::size_t next = 0;
+            for(std::size_t i = 0; i < sizeof...(Columns); ++i)
+            {
+                indices[i] = schema_indices[i] == next_column ? next : schema_indices[i];
+                next = indices[i] + 1;
+            }
+            return indices;
+        }
+
+        /// @returns Number of fields needed to fill every column
+        static constexpr std::size_t get_min_fields()
+        {
+            std::size_t min_fields = 0;
+            for(auto i: indices)
+                min_fields = std::max(min_fields, i + 1);
+            return min_fields;
+        }
+
+    public:
+        /// Tuple type of a row
+        using value_type = std::tuple<typename Column_traits<Columns>::type...>;
+
+        /// Position of each column in a row
+        static constexpr std::array<std::size_t, sizeof...(Columns)> indices = get_indices();
+
+        /// Minimum number of fields in a row
+        static constexpr std::size_t min_fields = get_min_fields();
+
+        /// Read rows with a fixed schema from a Reader
+
+        /// Any rows already read from \c reader (such as a header row) are not
+        /// read again
+        /// @param reader Reader to read rows from
+        /// @warning reader must not be destroyed during the lifetime of this
+        ///          Typed_reader
+        explicit Typed_reader(Reader & reader): reader_{reader} {}
+
+        /// Reads the current row into an existing tuple or struct
+
+        /// @param[out] row Tuple to store fields in. If an exception is thrown,
+        /// some columns may have been overwritten
+        /// @returns \c false if no rows remain, leaving \c row unchanged
+        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+        /// @throws IO_error if error reading CSV data
+        /// @throws Out_of_range_error if the row has fewer than min_fields fields
+        /// @throws Type_conversion_error if error converting to specified types
+        bool read_row(value_type & row)
+        {
+            auto fields = read_fields();
+            if(!fields)
+                return false;
+
+            read_row(*fields, row, std::index_sequence_for<Columns...>{});
+            return true;
+        }
+
+        /// Reads the current row as a tuple
+
+        /// @returns std::tuple containing the columns from the row or empty
+        /// optional if no rows remain
+        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+        /// @throws IO_error if error reading CSV data
+        /// @throws Out_of_range_error if the row has fewer than min_fields fields
+        /// @throws Type_conversion_error if error converting to specified types
+        std::optional<value_type> read_row()
+        {
+            return read_row_as<value_type>();
+        }
+
+        /// Reads the current row into a user-defined type
+
+        /// @tparam T Type to construct. Initialized with the schema's columns,
+        /// in order, as in `T{column_0, column_1, ...}`, so T may be an
+        /// aggregate struct with matching members
+        /// @returns The constructed row or empty optional if no rows remain
+        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+        /// @throws IO_error if error reading CSV data
+        /// @throws Out_of_range_error if the row has fewer than min_fields fields
+        /// @throws Type_conversion_error if error converting to specified types
+        template <typename T>
+        std::optional<T> read_row_as()
+        {
+            auto fields = read_fields();
+            if(!fields)
+                return {};
+
+            return read_row_as<T>(*fields, std::index_sequence_for<Columns...>{});
+        }
+
+        /// Read all remaining rows
+
+        /// @tparam T Type to construct from each row. See read_row_as
+        /// @returns Vector of each row
+        /// @throws Parse_error if error parsing field (*only when not parsing in lenient mode*)
+        /// @throws IO_error if error reading CSV data
+        /// @throws Out_of_range_error if a row has fewer than min_fields fields
+        /// @throws Type_conversion_error if error converting to specified types
+        template <typename T = value_type>
+        std::vector<T> read_all()
+        {
+            std::vector<T> data;
+            while(auto row = read_row_as<T>())
+                data.push_back(std::move(*row));
+            return data;
+        }
+
+    private:
+        /// Read the current row and check its field count
+
+        /// @returns Fields of the row, or empty optional if no rows remain
+        std::optional<Reader::Row_view> read_fields()
+        {
+            auto fields = reader_.read_row_view();
+            if(fields && std::size(*fields) < min_fields)
+                throw Out_of_range_error("Too few fields");
+            return fields;
+        }
+
+        /// Convert one column of the current row
+
+        /// @tparam I Position of the column in the schema
+        /// @param fields Fields from the current row
+        template <std::size_t I>
+        static auto convert(const Reader::Row_view & fields)
+        {
+            using T = std::tuple_element_t<I, value_type>;
+            auto field = fields[std::get<I>(indices)];
+
+            if constexpr(std::is_same_v<T, std::string_view>)
+            {
+                return field;
+            }
+            else if constexpr(std::is_convertible_v<std::string, T>)
+            {
+                return T(std::string{field});
+            }
+            else
+            {
+                auto field_val = detail::convert<T>(field);
+                if(!field_val)
+                    throw Type_conversion_error(std::string{field});
+                return std::move(*field_val);
+            }
+        }
+
+        template <std::size_t ... Is>
+        static void read_row(const Reader::Row_view & fields, value_type & row, std::index_sequence<Is...>)
+        {
+            ((std::get<Is>(row) = convert<Is>(fields)), ...);
+        }
+
+        template <typename T, std::size_t ... Is>
+        static T read_row_as(const Reader::Row_view & fields, std::index_sequence<Is...>)
+        {
+            // braced initialization guarantees left-to-right evaluation
+            return T{convert<Is>(fields)...};
+        }
+
+        Reader & reader_; ///< Reader to read rows from
+    };
+
     /// CSV writer
 
     /// Writes data in CSV format, with correct escaping as needed, according to RFC 4180 rules.
@@ -1326,52 +5095,131 @@ namespace csv
 
         /// Use a std::ostream for CSV output
 
+        /// Output is buffered, and written to \c output_stream in large
+        /// blocks. Call flush() to write it before the Writer is destroyed
         /// @param output_stream std::ostream to write to
         /// @param delimiter Delimiter character
         /// @param quote Quote character
         /// @warning \c output_stream must not be destroyed or written to during the lifetime of this Writer
         explicit Writer(std::ostream & output_stream,
                 const char delimiter = ',', const char quote = '"'):
-            output_stream_{&output_stream},
+            sink_{std::make_unique<detail::Stream_sink>(output_stream)},
             delimiter_{delimiter},
             quote_{quote}
-        {}
+        {
+            buffer_.reserve(buffer_size_);
+        }
 
         /// Open a file for CSV output
 
         /// @param filename Path to file to write to. Any existing file will be overwritten
         /// @param delimiter Delimiter character
         /// @param quote Quote character
-        /// @warning \c output_stream must not be destroyed or written to during the lifetime of this Writer
         /// @throws IO_error if there is an error opening the file
         explicit Writer(const std::string& filename,
                 const char delimiter = ',', const char quote = '"'):
-            internal_output_stream_{std::make_unique<std::ofstream>(filename, std::ios::binary)},
-            output_stream_{internal_output_stream_.get()},
+            sink_{detail::File_sink::open(filename)},
+            delimiter_{delimiter},
+            quote_{quote}
+        {
+            buffer_.reserve(buffer_size_);
+        }
+
+        /// Use a std::ostream for compressed CSV output
+
+        /// Output is compressed in independent blocks (BGZF for gzip, the zstd
+        /// seekable format for zstd), which can be decompressed in parallel by
+        /// Parallel_reader, as well as by any gzip or zstd decompressor. The
+        /// end of the compressed stream is written when the Writer is destroyed
+        /// @param output_stream std::ostream to write to
+        /// @param compression Compression format. Compression::none and
+        /// Compression::detect write uncompressed output
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @warning \c output_stream must not be destroyed or written to during the lifetime of this Writer
+        /// @throws IO_error if \c compression is a format that is not enabled
+        Writer(std::ostream & output_stream, Compression compression,
+                const char delimiter = ',', const char quote = '"'):
+            internal_output_stream_{compress(output_stream, compression)},
+            sink_{std::make_unique<detail::Stream_sink>(internal_output_stream_ ? *internal_output_stream_ : output_stream)},
+            delimiter_{delimiter},
+            quote_{quote}
+        {
+            buffer_.reserve(buffer_size_);
+        }
+
+        /// Open a file for compressed CSV output
+
+        /// Output is compressed in independent blocks (BGZF for gzip, the zstd
+        /// seekable format for zstd), which can be decompressed in parallel by
+        /// Parallel_reader, as well as by any gzip or zstd decompressor. The
+        /// end of the compressed stream is written when the Writer is destroyed
+        /// @param filename Path to file to write to. Any existing file will be overwritten
+        /// @param compression Compression format. Compression::none and
+        /// Compression::detect write uncompressed output
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @throws IO_error if there is an error opening the file, or if \c
+        /// compression is a format that is not enabled
+        Writer(const std::string& filename, Compression compression,
+                const char delimiter = ',', const char quote = '"'):
             delimiter_{delimiter},
             quote_{quote}
         {
-            if(!(*internal_output_stream_))
+            buffer_.reserve(buffer_size_);
+
+            if(compression == Compression::none || compression == Compression::detect)
+            {
+                sink_ = detail::File_sink::open(filename);
+                return;
+            }
+
+            auto file = std::make_unique<std::ofstream>(filename, std::ios::binary);
+            if(!(*file))
                 throw IO_error("Could not open file '" + filename + "'", errno);
+
+            auto & output = *file;
+            internal_output_stream_ = compress(output, compression, std::move(file));
+            sink_ = std::make_unique<detail::Stream_sink>(*internal_output_stream_);
         }
 
         /// Destructor
 
-        /// Writes a final newline sequence if needed to close current row
+        /// Writes a final newline sequence if needed to close current row, and
+        /// writes any buffered output
         ~Writer()
         {
-            if(!start_of_row_)
-            {
-                // try to end the row, but ignore any IO errors
-                try { end_row(); }
-                catch(const IO_error & e) {}
-            }
+            close();
         }
 
         Writer(const Writer &) = delete;
         Writer(Writer &&) = default;
         Writer & operator=(const Writer &) = delete;
-        Writer & operator=(Writer &&) = default;
+
+        /// Move assignment
+
+        /// Finishes output to this Writer's current destination, as if it had been destroyed
+        Writer & operator=(Writer && other)
+        {
+            if(this != &other)
+            {
+                close();
+                sink_ = std::move(other.sink_);
+                internal_output_stream_ = std::move(other.internal_output_stream_);
+                buffer_ = std::move(other.buffer_);
+                buffer_size_ = other.buffer_size_;
+                start_of_row_ = other.start_of_row_;
+                format_stream_ = std::move(other.format_stream_);
+                format_buffer_ = std::move(other.format_buffer_);
+                precision_ = other.precision_;
+                quoting_ = other.quoting_;
+                column_quoting_ = std::move(other.column_quoting_);
+                column_ = other.column_;
+                delimiter_ = other.delimiter_;
+                quote_ = other.quote_;
+            }
+            return *this;
+        }
 
         /// Get iterator
 
@@ -1392,26 +5240,97 @@ namespace csv
         /// @param quote New quote character
         void set_quote(const char quote) { quote_ = quote; }
 
+        /// Change the formatting of floating point fields
+
+        /// By default, floating point fields are written with the shortest
+        /// representation that reads back as the same value
+        /// @param precision Number of digits to write after the decimal point,
+        /// or negative for the shortest representation
+        void set_precision(const int precision) { precision_ = precision; }
+
+        /// Change the output buffer size
+
+        /// Output is written to the stream or file in blocks of about this size
+        /// @param size New buffer size in bytes. Must be greater than 0
+        void set_buffer_size(const std::size_t size) { assert(size > 0); buffer_size_ = size; buffer_.reserve(size); }
+
+        /// Write buffered output
+
+        /// Writes all output so far to the stream or file, and flushes it
+        /// @throws IO_error if there is an error writing
+        void flush()
+        {
+            flush_buffer();
+            sink_->flush();
+        }
+
+        /// Change the quoting policy
+
+        /// Applies to all columns without their own policy set by set_column_quoting()
+        /// @param policy New quoting policy
+        void set_quoting(const Quoting policy) { quoting_ = policy; }
+
+        /// Change the quoting policy for a column
+
+        /// @param column Index of column, starting at 0
+        /// @param policy New quoting policy for \c column
+        void set_column_quoting(const std::size_t column, const Quoting policy)
+        {
+            if(column >= std::size(column_quoting_))
+                column_quoting_.resize(column + 1);
+            column_quoting_[column] = policy;
+        }
+
         /// Writes a field to the CSV output
 
+        /// Quoted according to the quoting policy of the current column
         /// @param field Data to write. Type must be convertible to std::string
         /// either directly, by \c to_string, or by `ostream::operator<<`
         /// @throws IO_error if there is an error writing
         template<typename T>
         void write_field(const T & field)
         {
-            if(!start_of_row_)
+            auto policy = quoting_;
+            if(column_ < std::size(column_quoting_) && column_quoting_[column_])
+                policy = *column_quoting_[column_];
+
+            switch(policy)
             {
-                (*output_stream_)<<delimiter_;
-                if(output_stream_->bad())
-                    throw IO_error{"Error writing to output", errno};
+            case Quoting::minimal: write_field<Quoting::minimal>(field); break;
+            case Quoting::always:  write_field<Quoting::always>(field);  break;
+            case Quoting::never:   write_field<Quoting::never>(field);   break;
+            case Quoting::trusted: write_field<Quoting::trusted>(field); break;
             }
+        }
 
-            (*output_stream_)<<quote(field);
-            if(output_stream_->bad())
-                throw IO_error{"Error writing to output", errno};
+        /// Writes a field to the CSV output with the given quoting policy
+
+        /// Ignores the Writer's and column's quoting policies
+        /// @tparam policy Quoting policy for this field
+        /// @param field Data to write. Type must be convertible to std::string
+        /// either directly, by \c to_string, or by `ostream::operator<<`
+        /// @throws IO_error if there is an error writing
+        template<Quoting policy, typename T>
+        void write_field(const T & field)
+        {
+            if(!start_of_row_)
+                buffer_ += delimiter_;
+
+            // strings are quoted straight from the caller's data, and numbers
+            // and streamable types are formatted without a temporary string
+            if constexpr(std::is_convertible_v<const T &, std::string_view>)
+                append_field<policy>(field);
+            else if constexpr(std::is_same_v<T, char>)
+                append_field<policy>(std::string_view{&field, 1});
+            else if constexpr(!std::is_convertible_v<T, std::string> && detail::has_to_chars_v<T>)
+                append_number<policy>(field);
+            else if constexpr(!std::is_convertible_v<T, std::string> && !detail::has_std_to_string_v<T> && !detail::has_to_string_v<T> && detail::has_ostr_v<T>)
+                append_field<policy>(format(field));
+            else
+                append_field<policy>(str(field));
 
             start_of_row_ = false;
+            ++column_;
         }
 
         /// Writes a field to the CSV output
@@ -1441,10 +5360,12 @@ namespace csv
         /// @throws IO_error if there is an error writing
         void end_row()
         {
-            (*output_stream_)<<"\r\n";
-            if(output_stream_->bad())
-                throw IO_error{"Error writing to output", errno};
+            buffer_ += "\r\n";
             start_of_row_ = true;
+            column_ = 0;
+
+            if(std::size(buffer_) >= buffer_size_)
+                flush_buffer();
         }
 
         /// Write fields from iterators, without ending the row
@@ -1572,51 +5493,247 @@ namespace csv
             std::apply(&Writer::write_row_v<Args...>, std::tuple_cat(std::tuple(std::ref(*this)), data));
         }
 
+        /// Write a row from the given variadic parameters, with a quoting policy for each field
+
+        /// The policies are fixed at compile time, so no policy is looked up
+        /// for each field. Ignores the Writer's and columns' quoting policies
+        /// @tparam Policies Quoting policy for each field
+        /// @param data Fields to write. Each must be convertible to std::string
+        /// either directly, by \c to_string, or by `ostream::operator<<`
+        /// @throws IO_error if there is an error writing
+        template<Quoting ...Policies, typename ...Data>
+        void write_row_quoted(const Data & ...data)
+        {
+            static_assert(sizeof...(Policies) == sizeof...(Data), "A quoting policy is needed for each field");
+            (write_field<Policies>(data), ...);
+
+            end_row();
+        }
+
+        /// Write a row from a tuple, with a quoting policy for each field
+
+        /// The policies are fixed at compile time, so no policy is looked up
+        /// for each field. Ignores the Writer's and columns' quoting policies
+        /// @tparam Policies Quoting policy for each field
+        /// @param data tuple of fields to write. Each element must be convertible to
+        /// std::string either directly, by \c to_string, or by
+        /// `ostream::operator<<`
+        /// @throws IO_error if there is an error writing
+        template<Quoting ...Policies, typename ...Args>
+        void write_row_quoted(const std::tuple<Args...> & data)
+        {
+            std::apply([this](const Args & ...fields) { write_row_quoted<Policies...>(fields...); }, data);
+        }
+
     private:
-        /// Quote a field, if quotation is needed
+        /// Append a field to the output buffer, quoted according to a quoting policy
 
-        /// @oaram field Field to quote. Must be convertible to std::string by
-        /// csv::str
-        /// @returns \c field as a std::string, quoted if necessary
-        template<typename T>
-        std::string quote(const T & field)
+        /// @tparam policy Quoting policy
+        /// @param field Field to append
+        /// @throws IO_error if the buffer was full, and there is an error writing it
+        template<Quoting policy>
+        void append_field(std::string_view field)
         {
-            std::string field_str = str(field);
+            auto begin = std::data(field);
+            auto end = begin + std::size(field);
 
-            std::string ret{quote_};
-            ret.reserve(std::size(field_str) + 2);
-            bool quoted = false;
-            for(auto c: field_str)
+            if constexpr(policy == Quoting::trusted)
+                assert(detail::find_structural(begin, end, delimiter_, quote_) == end && "field in trusted column needs quoting");
+
+            // fields without any delimiters, quotes, or newlines are copied as-is
+            if(policy == Quoting::never || policy == Quoting::trusted
+                    || (policy == Quoting::minimal && detail::find_structural(begin, end, delimiter_, quote_) == end))
+            {
+                buffer_.append(begin, end);
+            }
+            else
+            {
+                // copy the runs between quotes, doubling each quote
+                buffer_ += quote_;
+                while(auto q = static_cast<const char *>(std::memchr(begin, quote_, static_cast<std::size_t>(end - begin))))
+                {
+                    buffer_.append(begin, q + 1);
+                    buffer_ += quote_;
+                    begin = q + 1;
+                }
+                buffer_.append(begin, end);
+                buffer_ += quote_;
+            }
+
+            if(std::size(buffer_) >= buffer_size_)
+                flush_buffer();
+        }
+
+        /// Append a number to the output buffer
+
+        /// Numbers are formatted on the stack, so only the characters written
+        /// are added to the buffer. They are only checked for quoting if the
+        /// delimiter or quote could be part of one
+        /// @tparam policy Quoting policy
+        /// @param value Number to append
+        /// @throws IO_error if the buffer was full, and there is an error writing it
+        template<Quoting policy, typename T>
+        void append_number(T value)
+        {
+            // nearly every number fits on the stack. Only large values with a
+            // high fixed precision need the worst case size
+            std::array<char, 64> small;
+            const char * begin = std::data(small);
+            auto [end, ec] = detail::format_number(std::data(small), std::data(small) + std::size(small), value, precision_);
+            if(ec == std::errc::value_too_large)
+            {
+                format_buffer_.resize(detail::max_number_size<T>(precision_));
+                begin = std::data(format_buffer_);
+                end = detail::format_number(std::data(format_buffer_), std::data(format_buffer_) + std::size(format_buffer_), value, precision_).ptr;
+            }
+            std::string_view number{begin, static_cast<std::size_t>(end - begin)};
+
+            if constexpr(policy != Quoting::never)
             {
-                if(c == quote_)
+                if((detail::is_number_char(delimiter_) || detail::is_number_char(quote_))
+                        && detail::find_structural(begin, end, delimiter_, quote_) != end)
                 {
-                    quoted = true;
-                    ret += quote_;
+                    append_field<policy>(number);
+                    return;
                 }
-                else if(c == delimiter_ || c == '\r' || c == '\n')
-                    quoted = true;
+            }
+
+            if constexpr(policy == Quoting::always)
+                buffer_ += quote_;
+            buffer_ += number;
+            if constexpr(policy == Quoting::always)
+                buffer_ += quote_;
+
+            if(std::size(buffer_) >= buffer_size_)
+                flush_buffer();
+        }
+
+        /// Format a field with `ostream::operator<<`
+
+        /// Reuses the same stream and string for every field
+        /// @param field Field to format
+        /// @returns Formatted field. Valid until the next field is formatted
+        template<typename T>
+        std::string_view format(const T & field)
+        {
+            if(!format_stream_)
+                format_stream_ = std::make_unique<Format_stream>();
+
+            // start each field with default formatting, as a new stream would
+            auto & stream = format_stream_->stream;
+            stream.clear();
+            stream.flags(std::ios_base::skipws | std::ios_base::dec);
+            stream.precision(6);
+            stream.width(0);
+            stream.fill(' ');
+
+            format_stream_->field.clear();
+            stream<<field;
+            return format_stream_->field;
+        }
+
+        /// Write the output buffer to the stream or file
+
+        /// @throws IO_error if there is an error writing
+        void flush_buffer()
+        {
+            if(std::empty(buffer_))
+                return;
+
+            sink_->write(std::data(buffer_), std::size(buffer_));
+            buffer_.clear();
+        }
 
-                ret += c;
+        /// End the current row, and write any buffered output, ignoring IO errors
+        void close()
+        {
+            if(!sink_) // moved from
+                return;
+
+            try
+            {
+                if(!start_of_row_)
+                    end_row();
+                flush();
             }
+            catch(const IO_error & e) {}
+        }
+
+        /// Wrap an output stream for compression
+
+        /// @param output Stream to write to
+        /// @param compression Compression format
+        /// @param owned_output Stream to take ownership of, if \c output is owned by the Writer
+        /// @returns Stream compressing to \c output, or \c owned_output if not compressing
+        static std::unique_ptr<std::ostream> compress(std::ostream & output, Compression compression, std::unique_ptr<std::ostream> owned_output = nullptr)
+        {
+            if(compression == Compression::none || compression == Compression::detect)
+                return owned_output;
+
+            return std::make_unique<detail::Block_compress_stream>(output, compression, std::move(owned_output));
+        }
+
+        /// Write to an output sink
+
+        /// Used by Parallel_writer to format batches into memory
+        /// @param sink Sink to write to
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        Writer(std::unique_ptr<detail::Output_sink> sink, const char delimiter, const char quote):
+            sink_{std::move(sink)},
+            delimiter_{delimiter},
+            quote_{quote}
+        {
+            buffer_.reserve(buffer_size_);
+        }
 
-            if(!quoted)
-                return field_str;
+        /// Write already formatted output
 
-            ret += quote_;
-            return ret;
+        /// Used by Parallel_writer to write formatted batches. Must be called at the start of a row
+        /// @param data Output to write
+        /// @throws IO_error if there is an error writing
+        void write_formatted(std::string_view data)
+        {
+            assert(start_of_row_);
+            flush_buffer();
+            sink_->write(std::data(data), std::size(data));
         }
 
         friend Writer &end_row(Writer & w);
+        friend class Parallel_writer;
 
-        /// Owns an ofstream created by this Reader when constructed by filename
+        /// Owns the compressing stream, and the ofstream it writes to when
+        /// constructed by filename, when writing compressed output
         std::unique_ptr<std::ostream> internal_output_stream_;
 
-        /// Points to output ostream. Will point to *internal_output_stream_ if
-        /// constructed by filename or the ostream passed when constructed by
-        /// ostream
-        std::ostream * output_stream_;
+        /// Where buffer_ is written to. Writes to *internal_output_stream_
+        /// when compressing, the ostream passed when constructed by ostream, or
+        /// directly to the file when constructed by filename
+        std::unique_ptr<detail::Output_sink> sink_;
+
+        static inline constexpr std::size_t default_buffer_size = 64 * 1024;
+        std::string buffer_;                              ///< Output not yet written to sink_
+        std::size_t buffer_size_ { default_buffer_size }; ///< Size at which buffer_ is written to sink_
+
         bool start_of_row_ {true}; ///< for keeping track if when a row needs to be ended
 
+        /// Stream for formatting fields with `ostream::operator<<`
+        struct Format_stream
+        {
+            std::string field;                    ///< Formatted field
+            detail::String_append_buf buf{field}; ///< Appends to field
+            std::ostream stream{&buf};            ///< Stream writing to buf
+        };
+
+        std::unique_ptr<Format_stream> format_stream_; ///< Created on first use
+        std::string format_buffer_;                    ///< Numbers too large to format on the stack
+
+        int precision_ {-1}; ///< Digits after the decimal point for floating point fields, or negative for shortest
+
+        Quoting quoting_ {Quoting::minimal};                 ///< Quoting policy for columns without their own
+        std::vector<std::optional<Quoting>> column_quoting_; ///< Quoting policy for each column, if set
+        std::size_t column_ {0};                             ///< Index of next column to write
+
         char delimiter_ {','};
         char quote_ {'"'};
     };
@@ -0,0 +1,1570 @@
+/// @file
+/// @brief Multi-threaded C++ CSV reader
+
+// Copyright 2020 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CSV_PARALLEL_HPP
+#define CSV_PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "csv.hpp"
+
+namespace csv
+{
+    /// @addtogroup cpp
+    /// @{
+
+    namespace detail
+    {
+        /// Independently compressed part of compressed input
+        struct Compressed_frame
+        {
+            std::string_view data;                        ///< Compressed data
+            std::optional<std::size_t> decompressed_size; ///< Size when decompressed, if known
+        };
+
+        /// Split compressed input into independently compressed frames
+
+        /// gzip input is split into BGZF blocks, and zstd input into frames.
+        /// Other gzip input can't be split without decompressing it
+        /// @param input Compressed input
+        /// @param compression Compression format of \c input
+        /// @returns Frames of \c input, or one frame of all of \c input if it can't be split
+        /// @throws IO_error if \c input is truncated or corrupt
+        inline std::vector<Compressed_frame> split_frames(std::string_view input, [[maybe_unused]] Compression compression)
+        {
+            std::vector<Compressed_frame> frames;
+
+#ifdef CSVPP_USE_ZLIB
+            if(compression == Compression::gzip)
+            {
+                auto le16 = [](const char * data) { return static_cast<std::size_t>(static_cast<unsigned char>(data[0]) | static_cast<unsigned char>(data[1]) << 8); };
+
+                for(std::size_t pos = 0; pos < std::size(input);)
+                {
+                    auto member = input.substr(pos);
+
+                    // BGZF members are gzip members with a BC extra field holding the member size - 1
+                    constexpr std::size_t header_size = 12, trailer_size = 8;
+                    std::optional<std::size_t> member_size;
+                    if(std::size(member) >= header_size && member.compare(0, 3, "\x1f\x8b\x08") == 0 && (member[3] & 0x04))
+                    {
+                        auto extra = member.substr(header_size, le16(&member[10]));
+                        for(std::size_t i = 0; i + 4 <= std::size(extra); i += 4 + le16(&extra[i + 2]))
+                        {
+                            if(extra[i] == 'B' && extra[i + 1] == 'C' && le16(&extra[i + 2]) == 2 && i + 6 <= std::size(extra))
+                                member_size = le16(&extra[i + 4]) + 1;
+                        }
+                    }
+
+                    if(!member_size)
+                        return {{input, std::nullopt}};
+
+                    if(*member_size > std::size(member) || *member_size < header_size + trailer_size)
+                        throw IO_error{"Truncated gzip input", EIO};
+
+                    // BGZF members hold at most 64KiB. Anything larger is left to be found while decompressing
+                    auto block = member.substr(0, *member_size);
+                    auto decompressed_size = le16(&block[*member_size - 4]) | le16(&block[*member_size - 2]) << 16;
+                    frames.push_back({block, decompressed_size <= 0x10000 ? std::optional{decompressed_size} : std::nullopt});
+
+                    pos += *member_size;
+                }
+                return frames;
+            }
+#endif
+#ifdef CSVPP_USE_ZSTD
+            if(compression == Compression::zstd)
+            {
+                for(std::size_t pos = 0; pos < std::size(input);)
+                {
+                    auto frame_size = ZSTD_findFrameCompressedSize(std::data(input) + pos, std::size(input) - pos);
+                    if(ZSTD_isError(frame_size))
+                        throw IO_error{std::string{"Error decompressing zstd input: "} + ZSTD_getErrorName(frame_size), EIO};
+
+                    // skippable frames, such as the seekable format's seek table, decompress to nothing
+                    auto decompressed_size = ZSTD_getFrameContentSize(std::data(input) + pos, frame_size);
+                    frames.push_back({input.substr(pos, frame_size),
+                            decompressed_size == ZSTD_CONTENTSIZE_UNKNOWN || decompressed_size == ZSTD_CONTENTSIZE_ERROR ? std::nullopt : std::optional{static_cast<std::size_t>(decompressed_size)}});
+
+                    pos += frame_size;
+                }
+                return frames;
+            }
+#endif
+
+            frames.push_back({input, std::nullopt});
+            return frames;
+        }
+
+        /// Decompress a frame of unknown size
+
+        /// @param frame Frame to decompress
+        /// @param compression Compression format of \c frame
+        /// @returns Decompressed data
+        /// @throws IO_error if \c frame is corrupt, or if \c compression is a format that is not enabled
+        inline std::string decompress_frame(const Compressed_frame & frame, Compression compression)
+        {
+            auto source = decompress(std::make_unique<Memory_source>(std::data(frame.data), std::size(frame.data)), compression);
+
+            std::string output(std::max(4 * std::size(frame.data), std::size_t{64 * 1024}), '\0');
+            std::size_t size = 0;
+            for(std::size_t read_size; (read_size = source->read(std::data(output) + size, std::size(output) - size)) > 0;)
+            {
+                size += read_size;
+                if(size == std::size(output))
+                    output.resize(2 * size);
+            }
+            output.resize(size);
+            return output;
+        }
+
+        /// Decompress a frame of known size
+
+        /// @param frame Frame to decompress
+        /// @param compression Compression format of \c frame
+        /// @param output Buffer of frame.decompressed_size bytes to decompress into
+        /// @throws IO_error if \c frame is corrupt or does not decompress to
+        /// its expected size, or if \c compression is a format that is not enabled
+        inline void decompress_frame(const Compressed_frame & frame, Compression compression, char * output)
+        {
+            auto source = decompress(std::make_unique<Memory_source>(std::data(frame.data), std::size(frame.data)), compression);
+
+            std::size_t size = 0;
+            for(std::size_t read_size; size < *frame.decompressed_size && (read_size = source->read(output + size, *frame.decompressed_size - size)) > 0;)
+                size += read_size;
+
+            char extra;
+            if(size != *frame.decompressed_size || source->read(&extra, 1) > 0)
+                throw IO_error{"Compressed frame does not match its recorded size", EIO};
+        }
+
+        /// Fixed set of threads that run batches of indexed tasks
+
+        /// The threads are started once, and sleep between batches, so
+        /// running a batch only costs waking them
+        class Worker_pool
+        {
+        public:
+            /// Start the threads
+
+            /// @param threads Number of threads to start, not including the calling thread
+            explicit Worker_pool(std::size_t threads)
+            {
+                for(std::size_t i = 0; i < threads; ++i)
+                    workers_.emplace_back([this]() { work(); });
+            }
+
+            Worker_pool(const Worker_pool &) = delete;
+            Worker_pool & operator=(const Worker_pool &) = delete;
+
+            /// Stop and join the threads
+            ~Worker_pool()
+            {
+                {
+                    std::scoped_lock lock{mutex_};
+                    stop_ = true;
+                }
+                start_cv_.notify_all();
+
+                for(auto & worker: workers_)
+                    worker.join();
+            }
+
+            /// Run a task for each of \c count indexes
+
+            /// The calling thread is used as one of the threads. Returns after all tasks are complete
+            /// @param count Number of tasks
+            /// @param fun Task, called as <tt>fun(i)</tt> for each \c i in [0, \c count).
+            /// Must not throw
+            template <typename Fun>
+            void run(std::size_t count, Fun && fun)
+            {
+                std::function<void(std::size_t)> task = std::ref(fun);
+                {
+                    std::scoped_lock lock{mutex_};
+                    task_ = &task;
+                    count_ = count;
+                    next_ = 0;
+                    busy_ = std::size(workers_);
+                    ++batch_;
+                }
+                start_cv_.notify_all();
+
+                run_tasks();
+
+                std::unique_lock lock{mutex_};
+                done_cv_.wait(lock, [this]() { return busy_ == 0; });
+                task_ = nullptr;
+            }
+
+        private:
+            /// Run tasks from the current batch until none are left
+            void run_tasks()
+            {
+                for(std::size_t i; (i = next_++) < count_;)
+                    (*task_)(i);
+            }
+
+            /// Worker thread. Runs each batch until stopped
+            void work()
+            {
+                std::uint64_t batch = 0;
+                std::unique_lock lock{mutex_};
+                while(true)
+                {
+                    start_cv_.wait(lock, [this, batch]() { return stop_ || batch_ != batch; });
+                    if(stop_)
+                        return;
+                    batch = batch_;
+                    lock.unlock();
+
+                    run_tasks();
+
+                    lock.lock();
+                    if(--busy_ == 0)
+                        done_cv_.notify_one();
+                }
+            }
+
+            std::vector<std::thread> workers_; ///< Worker threads
+
+            std::mutex mutex_;                 ///< Guards everything below, except next_
+            std::condition_variable start_cv_; ///< Wakes workers for a new batch or to stop
+            std::condition_variable done_cv_;  ///< Wakes run() when every worker has finished the batch
+
+            const std::function<void(std::size_t)> * task_ { nullptr }; ///< Task for the current batch
+            std::size_t count_ { 0 };                                    ///< Number of tasks in the current batch
+            std::atomic<std::size_t> next_ { 0 };                        ///< Index of next task to run
+            std::size_t busy_ { 0 };                                     ///< Workers that have not finished the current batch
+            std::uint64_t batch_ { 0 };                                  ///< Incremented for each batch
+            bool stop_ { false };                                        ///< Set to stop worker threads
+        };
+    }
+
+    /// Multi-threaded CSV reader
+
+    /// Parses a single file or string on multiple threads, for inputs too
+    /// large for one Reader to keep up with. Parsing rules, lenient mode, and
+    /// Parse_error messages and positions match those of Reader.
+    ///
+    /// The input is split into chunks of roughly equal size. A pre-pass counts
+    /// the quotes and newlines in each chunk in parallel, which gives the quote
+    /// state at each chunk boundary, and so the first row that starts in each
+    /// chunk. Chunks are then parsed in parallel. Input is processed a window
+    /// of chunks at a time, so memory use does not grow with input size.
+    ///
+    /// Chunk boundaries are only guaranteed to be found correctly for input
+    /// without quote characters inside of unquoted fields. In strict mode,
+    /// such input is an error anyway, and the error from the earliest chunk is
+    /// thrown. In lenient mode, chunks are checked to line up before their rows
+    /// are delivered, and are re-parsed if they do not.
+    ///
+    /// Compressed files are decompressed while parsing, a block of about one
+    /// window at a time, so the decompressed input is never held in memory in
+    /// full. A row that continues past the end of a block is carried over to
+    /// the next one, so memory use also grows with the longest row. Files made
+    /// of independent blocks, such as BGZF, the zstd seekable format, and any
+    /// other multi-frame zstd file, are decompressed in parallel. This
+    /// includes compressed output from Writer. Other compressed files are
+    /// decompressed on the calling thread.
+    ///
+    /// Programs using this must link with the platform's thread library
+    /// (ie. Threads::Threads in CMake)
+    class Parallel_reader
+    {
+    public:
+        /// Order to deliver rows in
+        enum class Order
+        {
+            file, ///< Deliver rows in the order they appear in the input, on the calling thread
+            any   ///< Deliver rows from worker threads as soon as they are parsed
+        };
+
+        /// Open a file
+
+        /// Regular files are memory-mapped where supported. Other files are
+        /// read into memory in full before parsing. When built with \c
+        /// CSVPP_USE_ZLIB or \c CSVPP_USE_ZSTD, compressed files are detected
+        /// and decompressed
+        /// @param filename Path to a file to parse
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
+        /// @throws IO_error if there is an error opening or reading the file
+        explicit Parallel_reader(const std::string & filename,
+                const char delimiter = ',', const char quote = '"',
+                const bool lenient = false):
+            Parallel_reader{filename, Compression::detect, delimiter, quote, lenient}
+        {}
+
+        /// Open a compressed file
+
+        /// The file is decompressed while it is parsed, by each call to for_each_row()
+        /// @param filename Path to a file to parse
+        /// @param compression Compression format of the file
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
+        /// @throws IO_error if there is an error opening or reading the file
+        Parallel_reader(const std::string & filename, Compression compression,
+                const char delimiter = ',', const char quote = '"',
+                const bool lenient = false):
+            delimiter_{delimiter},
+            quote_{quote},
+            lenient_{lenient}
+        {
+#ifdef CSVPP_HAS_MMAP
+            source_ = detail::Mapped_file_source::open(filename);
+#endif
+            if(!source_)
+            {
+                std::ifstream file{filename, std::ios::binary};
+                if(!file)
+                    throw IO_error("Could not open file '" + filename + "'", errno);
+
+                std::ostringstream contents;
+                if(!(contents << file.rdbuf()) && file.peek() != std::ifstream::traits_type::eof())
+                    throw IO_error("Error reading from file '" + filename + "'", errno);
+
+                source_ = std::make_unique<detail::String_source>(contents.str());
+            }
+
+            if(compression == Compression::detect)
+                compression = detail::detect_compression({source_->contents(), std::min(std::size_t{4}, source_->contents_size())});
+            compression_ = compression;
+        }
+
+        /// Parse CSV from memory
+
+        /// @param input_data \c std::string containing CSV to parse
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
+        Parallel_reader(Reader::input_string_t, const std::string & input_data,
+                const char delimiter = ',', const char quote = '"',
+                const bool lenient = false):
+            source_{std::make_unique<detail::String_source>(input_data)},
+            delimiter_{delimiter},
+            quote_{quote},
+            lenient_{lenient}
+        {}
+
+        /// Change the number of threads
+
+        /// @param threads Number of threads to parse with, including the
+        /// calling thread. Must be greater than 0. Defaults to the number of
+        /// hardware threads
+        void set_threads(const std::size_t threads) { assert(threads > 0); threads_ = threads; }
+
+        /// Change the chunk size
+
+        /// @param size Approximate number of bytes parsed by each task. Must be greater than 0
+        void set_chunk_size(const std::size_t size) { assert(size > 0); chunk_size_ = size; }
+
+        /// Parse all rows
+
+        /// Worker threads are started once for the call, and parse each
+        /// window of chunks in turn
+        /// @param fun Function to call with each row, as <tt>fun(const
+        /// Reader::Row_view &)</tt>. The row is only valid for the duration of
+        /// the call. When \c order is Order::any, this is called from multiple
+        /// threads at once, and must be thread-safe
+        /// @param order Order to deliver rows in. In lenient mode, rows are
+        /// always delivered in file order
+        /// @throws Parse_error if error parsing a row (*only when not parsing
+        /// in lenient mode*). Line numbers are counted from the start of the
+        /// input. With Order::any, rows following the error may have already
+        /// been delivered
+        /// @throws IO_error if error decompressing input
+        /// @throws Any exception thrown by \c fun
+        template <typename Fun>
+        void for_each_row(Fun && fun, Order order = Order::file)
+        {
+            const bool ordered = order == Order::file || lenient_;
+
+            // started once, and reused for every window
+            detail::Worker_pool pool{threads_ - 1};
+            pool_ = &pool;
+            try
+            {
+                if(compression_ != Compression::none)
+                    parse_compressed(ordered, fun);
+                else
+                {
+                    const char * input = source_->contents();
+                    parse_block(input, input + source_->contents_size(), {input, 1, 0}, true, ordered, fun);
+                }
+            }
+            catch(...)
+            {
+                pool_ = nullptr;
+                throw;
+            }
+            pool_ = nullptr;
+        }
+
+    private:
+        /// Position within input
+        struct Position
+        {
+            const char * pos { nullptr }; ///< Pointer into input
+            unsigned int line_no { 1 };   ///< Line number of pos
+            unsigned int col_no { 0 };    ///< Column number of pos
+        };
+
+        /// Quote and newline counts over a range of input
+        struct Counts
+        {
+            std::size_t quotes { 0 };               ///< Number of quote characters
+            std::size_t newlines { 0 };             ///< Number of LF characters
+            const char * last_newline { nullptr };  ///< Last LF character, or \c nullptr if none
+
+            /// Extend to include the following range
+            void add(const Counts & next)
+            {
+                quotes += next.quotes;
+                newlines += next.newlines;
+                if(next.last_newline)
+                    last_newline = next.last_newline;
+            }
+        };
+
+        /// Range of input parsed by one task
+        struct Chunk
+        {
+            const char * raw_begin { nullptr }; ///< Start of chunk, before finding row boundaries
+            const char * raw_end { nullptr };   ///< End of chunk, before finding row boundaries
+            Counts counts;                      ///< Counts for [raw_begin, raw_end)
+
+            Position start;                     ///< Start of first row starting in chunk
+            const char * end { nullptr };       ///< Start of first row in the following chunk
+
+            std::vector<std::string_view> fields; ///< Fields of parsed rows, when delivering in order
+            std::vector<std::size_t> row_ends;    ///< Index into fields of the end of each row
+            std::deque<std::string> storage;      ///< Unescaped fields that could not be views into the input
+            Position result_end;                  ///< Where parsing stopped
+            const char * last_row { nullptr };    ///< Start of the last row parsed, when delivering in order
+            std::exception_ptr error;             ///< Exception thrown while parsing, if any
+
+            /// Reset for a new window
+            void clear()
+            {
+                counts = Counts{};
+                clear_rows();
+                error = nullptr;
+            }
+
+            /// Discard parsed rows
+            void clear_rows()
+            {
+                fields.clear();
+                row_ends.clear();
+                storage.clear();
+            }
+
+            /// Count quotes and newlines in [raw_begin, raw_end)
+            void count(char quote)
+            {
+                counts.quotes = static_cast<std::size_t>(std::count(raw_begin, raw_end, quote));
+                counts.newlines = static_cast<std::size_t>(std::count(raw_begin, raw_end, '\n'));
+
+                if(auto last = std::find(std::make_reverse_iterator(raw_end), std::make_reverse_iterator(raw_begin), '\n'); last.base() != raw_begin)
+                    counts.last_newline = &*last;
+            }
+
+            /// Save a row for in-order delivery
+
+            /// Fields that point into the input remain valid, and are stored
+            /// as-is. Others are only valid until the next row is read, and
+            /// must be copied
+            void store(const Reader::Row_view & row, const char * input, const char * input_end)
+            {
+                for(auto field: row)
+                {
+                    if(std::data(field) >= input && std::data(field) + std::size(field) <= input_end)
+                        fields.push_back(field);
+                    else
+                        fields.push_back(storage.emplace_back(field));
+                }
+                row_ends.push_back(std::size(fields));
+            }
+        };
+
+        /// Run a task for each of \c count indexes, on pool_
+
+        /// The calling thread is used as one of the threads. Returns after all tasks are complete
+        template <typename Fun>
+        void run_parallel(std::size_t count, Fun && fun) const
+        {
+            assert(pool_);
+            pool_->run(count, fun);
+        }
+
+        /// Parse the rows in a block of input
+
+        /// The block is processed a window of chunks at a time
+        /// @param input Start of block
+        /// @param input_end End of block
+        /// @param origin Position of \c input. Must be a row start
+        /// @param last Is this the end of the input. If not, rows that may
+        /// continue past the end of the block are left unparsed
+        /// @param ordered Deliver rows in order, on the calling thread
+        /// @param fun Function to call with each row
+        /// @returns Position of the first unparsed row. \c input_end when \c last is set
+        template <typename Fun>
+        Position parse_block(const char * input, const char * input_end, const Position & origin, bool last, bool ordered, Fun && fun)
+        {
+            const std::size_t window_size = 4 * threads_;
+
+            // where the next window of chunks starts
+            const char * raw_begin = input;
+            Position start = origin;
+
+            // quote state and newline totals between input and raw_begin
+            Counts before;
+
+            // where the next delivered row should start. Only differs from the
+            // chunk's start when chunks have not lined up (lenient mode only)
+            Position expected = start;
+
+            std::vector<Chunk> chunks;
+
+            while(raw_begin != input_end)
+            {
+                chunks.resize(std::min(window_size, static_cast<std::size_t>(input_end - raw_begin + chunk_size_ - 1) / chunk_size_));
+                for(auto & chunk: chunks)
+                {
+                    chunk.clear();
+                    chunk.raw_begin = raw_begin;
+                    raw_begin += std::min(chunk_size_, static_cast<std::size_t>(input_end - raw_begin));
+                    chunk.raw_end = raw_begin;
+                }
+
+                run_parallel(std::size(chunks), [this, &chunks](std::size_t i) { chunks[i].count(quote_); });
+
+                // starting positions of the chunks, and of the first chunk in the next window
+                std::vector<Counts> chunk_before(std::size(chunks));
+                for(std::size_t i = 0; i < std::size(chunks); ++i)
+                {
+                    chunk_before[i] = before;
+                    before.add(chunks[i].counts);
+                }
+
+                chunks[0].start = start;
+
+                // when no row starts after this window, the rest of the block
+                // may be part of a row that continues into the next block
+                auto next_start = find_row_start(raw_begin, input_end, before);
+                const bool block_end = !next_start && !last;
+                if(block_end)
+                {
+                    // stop before the last row, or leave the whole window if no row starts in it
+                    const char * last_start = nullptr;
+                    std::size_t i = std::size(chunks);
+                    while(!last_start && i-- > 0)
+                        last_start = find_last_row_start(chunks[i].raw_begin, chunks[i].raw_end, chunk_before[i]);
+
+                    if(last_start && last_start > start.pos)
+                        start = position(chunks[i].raw_begin, last_start, chunk_before[i], origin);
+                }
+                else
+                    start = position(raw_begin, next_start ? next_start : input_end, before, origin);
+
+                // a chunk in which no row starts (ie. it is inside of a quoted
+                // field) is left empty, and the following chunk is parsed instead
+                for(std::size_t i = std::size(chunks) - 1; i > 0; --i)
+                {
+                    auto & chunk = chunks[i];
+                    if(auto pos = find_row_start(chunk.raw_begin, chunk.raw_end, chunk_before[i]); pos && pos < start.pos)
+                        chunk.start = position(chunk.raw_begin, pos, chunk_before[i], origin);
+                    else
+                        chunk.start = i + 1 < std::size(chunks) ? chunks[i + 1].start : start;
+                }
+
+                for(std::size_t i = 0; i < std::size(chunks); ++i)
+                    chunks[i].end = i + 1 < std::size(chunks) ? chunks[i + 1].start.pos : start.pos;
+
+                auto store = [input, input_end](Chunk & chunk)
+                {
+                    return [&chunk, input, input_end](const Reader::Row_view & row) { chunk.store(row, input, input_end); };
+                };
+
+                run_parallel(std::size(chunks), [&](std::size_t i)
+                {
+                    auto & chunk = chunks[i];
+                    try
+                    {
+                        if(ordered)
+                            chunk.result_end = parse_range(chunk.start, chunk.end, input_end, store(chunk), &chunk.last_row);
+                        else
+                            chunk.result_end = parse_range(chunk.start, chunk.end, input_end, fun);
+                    }
+                    catch(...)
+                    {
+                        chunk.error = std::current_exception();
+                    }
+                });
+
+                bool carried = false;
+                for(auto & chunk: chunks)
+                {
+                    if(ordered && chunk.start.pos != expected.pos)
+                    {
+                        // the previous chunk did not end where this one was
+                        // expected to start. Re-parse from where it did end
+                        chunk.clear_rows();
+                        chunk.error = nullptr;
+                        chunk.result_end = parse_range(expected, chunk.end, input_end, store(chunk), &chunk.last_row);
+                    }
+
+                    if(ordered && !last && chunk.result_end.pos == input_end && !std::empty(chunk.row_ends))
+                    {
+                        // when chunks have not lined up, the last row may have
+                        // been cut off by the end of the block. Parse it again
+                        // with the next block
+                        chunk.row_ends.pop_back();
+                        chunk.fields.resize(std::empty(chunk.row_ends) ? 0 : chunk.row_ends.back());
+                        chunk.result_end = position(chunks[0].raw_begin, chunk.last_row, chunk_before[0], origin);
+                        carried = true;
+                    }
+
+                    if(ordered)
+                    {
+                        std::size_t row_begin = 0;
+                        for(auto row_end: chunk.row_ends)
+                        {
+                            fun(Reader::Row_view{std::data(chunk.fields) + row_begin, row_end - row_begin});
+                            row_begin = row_end;
+                        }
+                    }
+
+                    // rows before the error have been delivered, as they would be by Reader
+                    if(chunk.error)
+                        std::rethrow_exception(chunk.error);
+
+                    expected = chunk.result_end;
+                    if(carried)
+                        break;
+                }
+
+                if(carried || block_end)
+                    break;
+            }
+
+            return expected;
+        }
+
+        /// Decompress and parse the input, a block at a time
+
+        /// Blocks hold about as much input as one window of chunks. Runs of
+        /// frames of known size are decompressed in parallel, directly into
+        /// place. Large frames, and frames of unknown size that can't be
+        /// bounded, are decompressed in pieces. Any incomplete row at the end
+        /// of a block is carried over into the next one
+        /// @param ordered Deliver rows in order, on the calling thread
+        /// @param fun Function to call with each row
+        template <typename Fun>
+        void parse_compressed(bool ordered, Fun && fun)
+        {
+            auto frames = detail::split_frames({source_->contents(), source_->contents_size()}, compression_);
+            const std::size_t block_size = 4 * threads_ * chunk_size_;
+
+            // unparsed input carried over from the previous block, followed by the current block
+            std::string buffer;
+            Position carry {nullptr, 1, 0};
+
+            auto parse = [&](bool last)
+            {
+                const char * input = std::data(buffer);
+                carry = parse_block(input, input + std::size(buffer), {input, carry.line_no, carry.col_no}, last, ordered, fun);
+                buffer.erase(0, static_cast<std::size_t>(carry.pos - input));
+            };
+
+            // frames of unknown size are assumed to expand about 4 times
+            auto estimate = [](const detail::Compressed_frame & frame) { return frame.decompressed_size.value_or(4 * std::size(frame.data)); };
+            auto streamed = [this, block_size](const detail::Compressed_frame & frame)
+            {
+                return frame.decompressed_size ? *frame.decompressed_size > block_size : std::size(frame.data) > chunk_size_;
+            };
+
+            for(std::size_t first = 0; first < std::size(frames);)
+            {
+                if(streamed(frames[first]))
+                {
+                    auto source = detail::decompress(std::make_unique<detail::Memory_source>(std::data(frames[first].data), std::size(frames[first].data)), compression_);
+                    while(true)
+                    {
+                        auto size = std::size(buffer);
+                        buffer.resize(size + block_size);
+
+                        std::size_t read_size = 0;
+                        while(size < std::size(buffer) && (read_size = source->read(std::data(buffer) + size, std::size(buffer) - size)) > 0)
+                            size += read_size;
+                        buffer.resize(size);
+
+                        if(read_size == 0)
+                            break;
+                        parse(false);
+                    }
+                    ++first;
+                    continue;
+                }
+
+                // a run of frames expected to decompress to about one block
+                auto last = first;
+                for(std::size_t total = 0; last < std::size(frames) && !streamed(frames[last]) && (last == first || total + estimate(frames[last]) <= block_size); ++last)
+                    total += estimate(frames[last]);
+
+                decompress_frames(frames, first, last, buffer);
+                parse(false);
+                first = last;
+            }
+
+            parse(true);
+        }
+
+        /// Decompress frames in parallel
+
+        /// @param frames Frames of input
+        /// @param first Index of first frame to decompress
+        /// @param last Index past the last frame to decompress
+        /// @param output Buffer to append decompressed data to
+        /// @throws IO_error if a frame is corrupt
+        void decompress_frames(const std::vector<detail::Compressed_frame> & frames, std::size_t first, std::size_t last, std::string & output) const
+        {
+            std::vector<std::exception_ptr> errors(last - first);
+            auto rethrow = [&errors]()
+            {
+                for(auto & error: errors)
+                {
+                    if(error)
+                        std::rethrow_exception(error);
+                }
+            };
+
+            // frames of unknown size are decompressed first, to find where the others go
+            std::vector<std::string> unsized(last - first);
+            run_parallel(last - first, [&](std::size_t i)
+            {
+                try
+                {
+                    if(!frames[first + i].decompressed_size)
+                        unsized[i] = detail::decompress_frame(frames[first + i], compression_);
+                }
+                catch(...)
+                {
+                    errors[i] = std::current_exception();
+                }
+            });
+            rethrow();
+
+            std::vector<std::size_t> offsets(last - first + 1, std::size(output));
+            for(std::size_t i = 0; i < last - first; ++i)
+                offsets[i + 1] = offsets[i] + frames[first + i].decompressed_size.value_or(std::size(unsized[i]));
+
+            output.resize(offsets.back());
+            run_parallel(last - first, [&](std::size_t i)
+            {
+                try
+                {
+                    if(frames[first + i].decompressed_size)
+                        detail::decompress_frame(frames[first + i], compression_, std::data(output) + offsets[i]);
+                    else
+                        std::copy(std::begin(unsized[i]), std::end(unsized[i]), std::begin(output) + static_cast<std::ptrdiff_t>(offsets[i]));
+                }
+                catch(...)
+                {
+                    errors[i] = std::current_exception();
+                }
+            });
+            rethrow();
+        }
+
+        /// Find the first row starting in a range
+
+        /// @param begin Start of range. Must not be the start of the input
+        /// @param end End of range
+        /// @param before Counts for all input before \c begin
+        /// @returns Pointer to the first character following a newline outside
+        /// of quotes, or \c nullptr if there is no such newline in range
+        const char * find_row_start(const char * begin, const char * end, const Counts & before) const
+        {
+            bool quoted = before.quotes % 2 != 0;
+            for(auto pos = begin; pos != end; ++pos)
+            {
+                if(*pos == quote_)
+                    quoted = !quoted;
+                else if(!quoted && (*pos == '\r' || *pos == '\n'))
+                    return pos + 1;
+            }
+            return nullptr;
+        }
+
+        /// Find the last row starting in a range
+
+        /// @param begin Start of range
+        /// @param end End of range
+        /// @param before Counts for all input before \c begin
+        /// @returns Pointer to the first character following the last newline
+        /// outside of quotes, or \c nullptr if there is no such newline in range
+        const char * find_last_row_start(const char * begin, const char * end, const Counts & before) const
+        {
+            const char * row_start = nullptr;
+            bool quoted = before.quotes % 2 != 0;
+            for(auto pos = begin; pos != end; ++pos)
+            {
+                if(*pos == quote_)
+                    quoted = !quoted;
+                else if(!quoted && (*pos == '\r' || *pos == '\n'))
+                    row_start = pos + 1;
+            }
+            return row_start;
+        }
+
+        /// Get line and column numbers for a position
+
+        /// @param begin Start of range containing \c pos
+        /// @param pos Position to number
+        /// @param before Counts for all input between \c origin and \c begin
+        /// @param origin Position of the start of the block containing \c pos
+        /// @returns Line and column numbers of \c pos, as Reader would count them
+        static Position position(const char * begin, const char * pos, const Counts & before, const Position & origin)
+        {
+            Counts range;
+            range.newlines = static_cast<std::size_t>(std::count(begin, pos, '\n'));
+            if(auto last = std::find(std::make_reverse_iterator(pos), std::make_reverse_iterator(begin), '\n'); last.base() != begin)
+                range.last_newline = &*last;
+
+            auto total = before;
+            total.add(range);
+
+            if(!total.last_newline)
+                return {pos, origin.line_no, static_cast<unsigned int>(origin.col_no + (pos - origin.pos))};
+            return {pos, static_cast<unsigned int>(origin.line_no + total.newlines), static_cast<unsigned int>(pos - (total.last_newline + 1))};
+        }
+
+        /// Parse the rows starting in a range
+
+        /// @param start Start of first row
+        /// @param end Stop before reading a row starting at or after this position
+        /// @param input_end End of input. A row starting before \c end is parsed in full, even if it extends past \c end
+        /// @param fun Function to call with each row
+        /// @param[out] last_row Set to the start of the last row parsed, if not \c nullptr
+        /// @returns Position after the last row parsed
+        template <typename Fun>
+        Position parse_range(const Position & start, const char * end, const char * input_end, Fun && fun, const char ** last_row = nullptr) const
+        {
+            Reader reader{std::make_unique<detail::Memory_source>(start.pos, static_cast<std::size_t>(input_end - start.pos)), delimiter_, quote_, lenient_};
+            reader.line_no_ = start.line_no;
+            reader.col_no_ = start.col_no;
+            reader.refill();
+
+            while(true)
+            {
+                // Newlines that end the last row may continue past end. Don't
+                // let the Reader skip them and read the next chunk's first row
+                while(reader.pos_ < end && (*reader.pos_ == '\r' || *reader.pos_ == '\n'))
+                    ++reader.pos_;
+
+                if(reader.pos_ >= end)
+                    break;
+
+                if(last_row)
+                    *last_row = reader.pos_;
+                auto row = reader.read_row_view();
+                if(!row)
+                    break;
+
+                fun(*row);
+            }
+
+            reader.sync_position();
+            return {reader.pos_, reader.line_no_, reader.col_no_};
+        }
+
+        std::unique_ptr<detail::Input_source> source_; ///< Input data. Always held in memory
+        Compression compression_ { Compression::none }; ///< Compression format of source_
+
+        char delimiter_ {','};   ///< Delimiter character
+        char quote_ {'"'};       ///< Quote character
+        bool lenient_ { false }; ///< Lenient parsing enabled / disabled
+
+        std::size_t threads_ { std::max(1u, std::thread::hardware_concurrency()) }; ///< Number of threads to parse with
+        std::size_t chunk_size_ { 1024 * 1024 };                                     ///< Approximate size of each chunk
+
+        detail::Worker_pool * pool_ { nullptr }; ///< Threads parsing with, during for_each_row()
+    };
+
+    namespace detail
+    {
+        /// Reads from another source on a background thread
+
+        /// Blocks are read ahead into a ring of buffers, which is handed from
+        /// the reading thread to the parsing thread without locking. The mutex
+        /// is only used to sleep when the ring is full or empty
+        class Read_ahead_source final: public Input_source
+        {
+        public:
+            /// @param source Source to read from
+            /// @param buffers Number of buffers. Must be greater than 0
+            /// @param buffer_size Size of each buffer. Must be greater than 0
+            Read_ahead_source(std::unique_ptr<Input_source> source, std::size_t buffers, std::size_t buffer_size):
+                source_{std::move(source)},
+                num_buffers_{buffers},
+                buffer_size_{buffer_size}
+            {
+                assert(buffers > 0 && buffer_size > 0);
+            }
+
+            ~Read_ahead_source() override { stop(); }
+
+            /// Change the number and size of buffers
+
+            /// Must be called before the first read
+            /// @param buffers Number of buffers. Must be greater than 0
+            /// @param buffer_size Size of each buffer. Must be greater than 0
+            void set_buffers(std::size_t buffers, std::size_t buffer_size)
+            {
+                assert(buffers > 0 && buffer_size > 0);
+                assert(!thread_.joinable());
+                num_buffers_ = buffers;
+                buffer_size_ = buffer_size;
+                buffers_.clear();
+            }
+
+            std::size_t read(char * data, std::size_t size) override
+            {
+                if(finished_)
+                    return 0;
+
+                if(!thread_.joinable())
+                    start();
+
+                auto head = head_.load(std::memory_order_relaxed);
+                wait([this, head]() { return tail_.load(std::memory_order_acquire) != head; });
+
+                auto & buffer = buffers_[head % std::size(buffers_)];
+                if(buffer.size == 0)
+                {
+                    // end of input, or an error
+                    finished_ = true;
+                    stop();
+                    if(error_)
+                        std::rethrow_exception(std::exchange(error_, nullptr));
+                    return 0;
+                }
+
+                auto read_size = std::min(size, buffer.size - buffer_pos_);
+                std::memcpy(data, buffer.data.get() + buffer_pos_, read_size);
+                buffer_pos_ += read_size;
+
+                if(buffer_pos_ == buffer.size)
+                {
+                    buffer_pos_ = 0;
+                    head_.store(head + 1, std::memory_order_release);
+                    notify();
+                }
+
+                return read_size;
+            }
+
+            bool seek(std::uint64_t offset) override
+            {
+                stop();
+                head_ = tail_ = 0;
+                buffer_pos_ = 0;
+                finished_ = false;
+                error_ = nullptr;
+
+                return source_->seek(offset);
+            }
+
+        private:
+            /// A block of input
+            struct Buffer
+            {
+                std::unique_ptr<char[]> data; ///< Block storage
+                std::size_t size { 0 };       ///< Number of bytes read into data. 0 at end of input
+            };
+
+            /// Start the reading thread
+            void start()
+            {
+                // allocated on first use, and kept when restarting after a seek
+                if(std::empty(buffers_))
+                {
+                    for(std::size_t i = 0; i < num_buffers_; ++i)
+                        buffers_.push_back({std::make_unique<char[]>(buffer_size_)});
+                }
+
+                thread_ = std::thread{[this]() { fill(); }};
+            }
+
+            /// Stop and join the reading thread
+            void stop()
+            {
+                if(!thread_.joinable())
+                    return;
+
+                stop_ = true;
+                notify();
+                thread_.join();
+                stop_ = false;
+            }
+
+            /// Reading thread. Fills buffers until end of input, an error, or stop() is called
+            void fill()
+            {
+                while(true)
+                {
+                    auto tail = tail_.load(std::memory_order_relaxed);
+                    wait([this, tail]() { return stop_ || tail - head_.load(std::memory_order_acquire) < std::size(buffers_); });
+                    if(stop_)
+                        return;
+
+                    auto & buffer = buffers_[tail % std::size(buffers_)];
+                    try
+                    {
+                        buffer.size = source_->read(buffer.data.get(), buffer_size_);
+                    }
+                    catch(...)
+                    {
+                        // delivered to the parsing thread in place of the next block
+                        error_ = std::current_exception();
+                        buffer.size = 0;
+                    }
+
+                    tail_.store(tail + 1, std::memory_order_release);
+                    notify();
+
+                    if(buffer.size == 0)
+                        return;
+                }
+            }
+
+            /// Wait for a condition set by the other thread
+            template <typename Pred>
+            void wait(Pred pred)
+            {
+                if(pred())
+                    return;
+
+                std::unique_lock lock{mutex_};
+                cv_.wait(lock, pred);
+            }
+
+            /// Wake the other thread, if it is waiting
+            void notify()
+            {
+                // taking the lock orders this with a waiter's check of its condition
+                { std::lock_guard lock{mutex_}; }
+                cv_.notify_one();
+            }
+
+            std::unique_ptr<Input_source> source_; ///< Source to read from
+
+            std::size_t num_buffers_;     ///< Requested number of buffers
+            std::size_t buffer_size_;     ///< Size of each buffer
+            std::vector<Buffer> buffers_; ///< Ring of buffers
+
+            std::atomic<std::size_t> head_ { 0 }; ///< Count of buffers consumed by the parsing thread
+            std::atomic<std::size_t> tail_ { 0 }; ///< Count of buffers filled by the reading thread
+            std::atomic<bool> stop_ { false };    ///< Set to stop the reading thread
+            std::size_t buffer_pos_ { 0 };        ///< Position within the head buffer
+            bool finished_ { false };             ///< Reached end of input
+            std::exception_ptr error_;            ///< Exception thrown by the reading thread
+
+            std::mutex mutex_;           ///< Guards sleeping on cv_
+            std::condition_variable cv_; ///< Wakes a thread waiting for a buffer to be filled or freed
+            std::thread thread_;         ///< Reading thread
+        };
+    };
+
+    /// Reader that reads ahead on a background thread
+
+    /// Input is read into a ring of buffers by a background thread while
+    /// earlier buffers are parsed, so slow input such as pipes and network
+    /// filesystems is read at the same time as it is parsed, rather than
+    /// in turns.
+    ///
+    /// Files are always read as streams. Local files are usually read faster
+    /// by Reader, which memory-maps them.
+    ///
+    /// Programs using this must link with the platform's thread library
+    /// (ie. Threads::Threads in CMake)
+    class Read_ahead_reader final: public Reader
+    {
+    public:
+        /// Default number of read-ahead buffers
+        static inline constexpr std::size_t default_read_ahead_buffers = 4;
+
+        /// Default size of each read-ahead buffer
+        static inline constexpr std::size_t default_read_ahead_size = 1024 * 1024;
+
+        /// Parse CSV from a std::istream
+
+        /// @param input_stream std::istream to read from. It must not be read
+        /// from elsewhere while this Reader is in use
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
+        explicit Read_ahead_reader(std::istream & input_stream,
+                const char delimiter = ',', const char quote = '"',
+                const bool lenient = false):
+            Reader{std::make_unique<detail::Read_ahead_source>(std::make_unique<detail::Stream_source>(input_stream),
+                    default_read_ahead_buffers, default_read_ahead_size), delimiter, quote, lenient}
+        {}
+
+        /// Parse compressed CSV from a std::istream
+
+        /// Input is decompressed on the background thread
+        /// @param input_stream std::istream to read from. It must not be read
+        /// from elsewhere while this Reader is in use
+        /// @param compression Compression format of \c input_stream
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
+        /// @throws IO_error if \c compression is a format that is not enabled
+        Read_ahead_reader(std::istream & input_stream, Compression compression,
+                const char delimiter = ',', const char quote = '"',
+                const bool lenient = false):
+            Reader{std::make_unique<detail::Read_ahead_source>(detail::decompress(std::make_unique<detail::Stream_source>(input_stream), compression),
+                    default_read_ahead_buffers, default_read_ahead_size), delimiter, quote, lenient}
+        {}
+
+        /// Open a file for CSV parsing
+
+        /// When built with \c CSVPP_USE_ZLIB or \c CSVPP_USE_ZSTD, compressed
+        /// files are detected and decompressed on the background thread
+        /// @param filename Path to a file to parse
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
+        /// @throws IO_error if there is an error opening the file
+        explicit Read_ahead_reader(const std::string & filename,
+                const char delimiter = ',', const char quote = '"',
+                const bool lenient = false):
+            Read_ahead_reader{filename, Compression::detect, delimiter, quote, lenient}
+        {}
+
+        /// Open a compressed file for CSV parsing
+
+        /// Input is decompressed on the background thread
+        /// @param filename Path to a file to parse
+        /// @param compression Compression format of the file
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @param lenient Enable lenient parsing (will attempt to read past syntax errors)
+        /// @throws IO_error if there is an error opening the file, or if \c
+        /// compression is a format that is not enabled
+        Read_ahead_reader(const std::string & filename, Compression compression,
+                const char delimiter = ',', const char quote = '"',
+                const bool lenient = false):
+            Reader{std::make_unique<detail::Read_ahead_source>(detail::decompress(open_stream(filename), compression),
+                    default_read_ahead_buffers, default_read_ahead_size), delimiter, quote, lenient}
+        {}
+
+        /// Change the number and size of read-ahead buffers
+
+        /// Must be called before reading. Up to \c buffers blocks of \c size
+        /// bytes are read ahead of the parser
+        /// @param buffers Number of buffers. Must be greater than 0. Defaults to default_read_ahead_buffers
+        /// @param size Size of each buffer. Must be greater than 0. Defaults to default_read_ahead_size
+        void set_read_ahead(std::size_t buffers, std::size_t size)
+        {
+            static_cast<detail::Read_ahead_source &>(*source_).set_buffers(buffers, size);
+        }
+
+    private:
+        static std::unique_ptr<detail::Input_source> open_stream(const std::string & filename)
+        {
+            auto file = std::make_unique<std::ifstream>(filename, std::ios::binary);
+            if(!(*file))
+                throw IO_error("Could not open file '" + filename + "'", errno);
+
+            return std::make_unique<detail::Stream_source>(std::move(file));
+        }
+    };
+
+
+    /// Writer that formats rows on multiple threads
+
+    /// Producers submit batches of rows, each with a sequence number. Worker
+    /// threads format each batch with its own Writer, into a private buffer,
+    /// and a committer thread writes the formatted batches to the output in
+    /// sequence number order, so the output is the same as if each batch had
+    /// been written in turn by one Writer. Each batch starts at the start of
+    /// a row, and any row left unfinished at the end of a batch is ended.
+    ///
+    /// Batches may be submitted from any number of threads. Sequence numbers
+    /// start at 0, and every number must be submitted exactly once. Use
+    /// next_sequence() to number batches in the order they are submitted. To
+    /// bound memory use, submitting a batch blocks while its sequence number
+    /// is more than set_max_pending() batches ahead of the output. As long as
+    /// each thread submits its batches in increasing order, this can not
+    /// deadlock.
+    ///
+    /// Programs using this must link with the platform's thread library
+    /// (ie. Threads::Threads in CMake)
+    class Parallel_writer
+    {
+    public:
+        /// Use a std::ostream for CSV output
+
+        /// @param output_stream std::ostream to write to
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @warning \c output_stream must not be destroyed or written to during the lifetime of this Parallel_writer
+        explicit Parallel_writer(std::ostream & output_stream,
+                const char delimiter = ',', const char quote = '"'):
+            output_{output_stream, delimiter, quote},
+            delimiter_{delimiter},
+            quote_{quote}
+        {}
+
+        /// Open a file for CSV output
+
+        /// @param filename Path to file to write to. Any existing file will be overwritten
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @throws IO_error if there is an error opening the file
+        explicit Parallel_writer(const std::string & filename,
+                const char delimiter = ',', const char quote = '"'):
+            output_{filename, delimiter, quote},
+            delimiter_{delimiter},
+            quote_{quote}
+        {}
+
+        /// Use a std::ostream for compressed CSV output
+
+        /// Compressed as by Writer. Compression happens on the committer thread
+        /// @param output_stream std::ostream to write to
+        /// @param compression Compression format
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @warning \c output_stream must not be destroyed or written to during the lifetime of this Parallel_writer
+        /// @throws IO_error if \c compression is a format that is not enabled
+        Parallel_writer(std::ostream & output_stream, Compression compression,
+                const char delimiter = ',', const char quote = '"'):
+            output_{output_stream, compression, delimiter, quote},
+            delimiter_{delimiter},
+            quote_{quote}
+        {}
+
+        /// Open a file for compressed CSV output
+
+        /// Compressed as by Writer. Compression happens on the committer thread
+        /// @param filename Path to file to write to. Any existing file will be overwritten
+        /// @param compression Compression format
+        /// @param delimiter Delimiter character
+        /// @param quote Quote character
+        /// @throws IO_error if there is an error opening the file, or if \c
+        /// compression is a format that is not enabled
+        Parallel_writer(const std::string & filename, Compression compression,
+                const char delimiter = ',', const char quote = '"'):
+            output_{filename, compression, delimiter, quote},
+            delimiter_{delimiter},
+            quote_{quote}
+        {}
+
+        /// Destructor
+
+        /// Waits for submitted batches to be written. Errors are ignored. Call
+        /// finish() first to have them reported
+        ~Parallel_writer()
+        {
+            try { finish(); }
+            catch(...) {}
+        }
+
+        Parallel_writer(const Parallel_writer &) = delete;
+        Parallel_writer & operator=(const Parallel_writer &) = delete;
+
+        /// Change the number of threads
+
+        /// Must be called before the first batch is submitted
+        /// @param threads Number of threads to format with, not including the
+        /// committer thread. Must be greater than 0. Defaults to the number of
+        /// hardware threads
+        void set_threads(const std::size_t threads) { assert(threads > 0); assert(std::empty(workers_)); threads_ = threads; }
+
+        /// Change the number of batches that may be pending
+
+        /// @param batches Number of batches that may be submitted ahead of the
+        /// output. Must be greater than 0. Defaults to 4 per thread
+        void set_max_pending(const std::size_t batches) { assert(batches > 0); max_pending_ = batches; }
+
+        /// Set up the Writer of each batch
+
+        /// Called on the worker thread with each batch's Writer before the
+        /// batch is written, to apply settings such as Writer::set_quoting().
+        /// Must be called before the first batch is submitted
+        /// @param setup Function to call, as <tt>setup(Writer &)</tt>
+        void set_batch_setup(std::function<void(Writer &)> setup) { assert(std::empty(workers_)); setup_ = std::move(setup); }
+
+        /// Get a sequence number
+
+        /// @returns The next sequence number, starting from 0. Thread-safe
+        std::uint64_t next_sequence() { return next_sequence_++; }
+
+        /// Submit a batch
+
+        /// @param sequence Sequence number of the batch
+        /// @param batch Function writing the batch, as <tt>batch(Writer &)</tt>.
+        /// Called on a worker thread
+        /// @throws Any exception thrown by an earlier batch, or by writing
+        /// the output. The batch is not submitted
+        void submit(std::uint64_t sequence, std::function<void(Writer &)> batch)
+        {
+            std::unique_lock lock{mutex_};
+            if(std::empty(workers_))
+                start();
+
+            cv_.wait(lock, [this, sequence]() { return error_ || sequence < next_commit_ + max_pending_; });
+            if(error_)
+                std::rethrow_exception(error_);
+
+            tasks_.push_back({sequence, std::move(batch)});
+            cv_.notify_all();
+        }
+
+        /// Submit a batch of rows
+
+        /// @param sequence Sequence number of the batch
+        /// @param rows Range of rows to write. Each row is written with Writer::write_row
+        /// @throws Any exception thrown by an earlier batch, or by writing
+        /// the output. The batch is not submitted
+        template <typename Rows>
+        void submit_rows(std::uint64_t sequence, Rows rows)
+        {
+            submit(sequence, [rows = std::move(rows)](Writer & writer)
+            {
+                for(const auto & row: rows)
+                    writer.write_row(row);
+            });
+        }
+
+        /// Wait for submitted batches to be written
+
+        /// Stops the worker threads, and flushes the output. More batches may
+        /// be submitted afterwards, continuing the sequence
+        /// @throws Any exception thrown by a batch, or by writing the output
+        /// @throws Out_of_range_error if a sequence number was skipped
+        void finish()
+        {
+            std::unique_lock lock{mutex_};
+            if(!std::empty(workers_))
+            {
+                cv_.wait(lock, [this]()
+                {
+                    return std::empty(tasks_) && busy_ == 0 && !committing_
+                        && (std::empty(done_) || std::begin(done_)->first != next_commit_);
+                });
+
+                if(!std::empty(done_) && !error_)
+                    error_ = std::make_exception_ptr(Out_of_range_error("Batch sequence number not submitted"));
+
+                stop_ = true;
+                cv_.notify_all();
+                lock.unlock();
+
+                for(auto & worker: workers_)
+                    worker.join();
+                committer_.join();
+
+                lock.lock();
+                workers_.clear();
+                done_.clear();
+                stop_ = false;
+            }
+
+            if(error_)
+                std::rethrow_exception(std::exchange(error_, nullptr));
+
+            output_.flush();
+        }
+
+    private:
+        /// A submitted batch
+        struct Task
+        {
+            std::uint64_t sequence;           ///< Sequence number
+            std::function<void(Writer &)> fun; ///< Writes the batch
+        };
+
+        /// A formatted batch
+        struct Batch
+        {
+            std::string output;       ///< Formatted rows
+            std::exception_ptr error; ///< Exception thrown while formatting
+        };
+
+        /// Start worker and committer threads. mutex_ must be held
+        void start()
+        {
+            if(max_pending_ == 0)
+                max_pending_ = 4 * threads_;
+
+            for(std::size_t i = 0; i < threads_; ++i)
+                workers_.emplace_back([this]() { work(); });
+            committer_ = std::thread{[this]() { commit(); }};
+        }
+
+        /// Worker thread. Formats batches until stopped
+        void work()
+        {
+            std::unique_lock lock{mutex_};
+            while(true)
+            {
+                cv_.wait(lock, [this]() { return stop_ || !std::empty(tasks_); });
+                if(std::empty(tasks_))
+                    return;
+
+                auto task = std::move(tasks_.front());
+                tasks_.pop_front();
+                ++busy_;
+
+                Batch batch;
+                if(!std::empty(free_buffers_))
+                {
+                    batch.output = std::move(free_buffers_.back());
+                    free_buffers_.pop_back();
+                }
+                lock.unlock();
+
+                try
+                {
+                    // destroyed before the batch is done, to end the last row and flush
+                    Writer writer{std::make_unique<detail::String_sink>(batch.output), delimiter_, quote_};
+                    if(setup_)
+                        setup_(writer);
+                    task.fun(writer);
+                }
+                catch(...)
+                {
+                    batch.error = std::current_exception();
+                }
+
+                lock.lock();
+                --busy_;
+                [[maybe_unused]] auto inserted = done_.emplace(task.sequence, std::move(batch)).second;
+                assert(inserted); // sequence numbers must be unique
+                cv_.notify_all();
+            }
+        }
+
+        /// Committer thread. Writes batches in sequence order until stopped
+        void commit()
+        {
+            std::unique_lock lock{mutex_};
+            while(true)
+            {
+                auto ready = [this]() { return !std::empty(done_) && std::begin(done_)->first == next_commit_; };
+                cv_.wait(lock, [this, &ready]() { return stop_ || ready(); });
+                if(!ready())
+                    return;
+
+                auto batch = std::move(std::begin(done_)->second);
+                done_.erase(std::begin(done_));
+                if(batch.error && !error_)
+                    error_ = batch.error;
+
+                // after an error, batches are discarded, so the output ends at the last good batch
+                auto failed = static_cast<bool>(error_);
+                committing_ = true;
+                lock.unlock();
+
+                std::exception_ptr error;
+                if(!failed)
+                {
+                    try
+                    {
+                        output_.write_formatted(batch.output);
+                    }
+                    catch(...)
+                    {
+                        error = std::current_exception();
+                    }
+                }
+                batch.output.clear();
+
+                lock.lock();
+                if(error && !error_)
+                    error_ = error;
+                if(std::size(free_buffers_) < threads_)
+                    free_buffers_.push_back(std::move(batch.output));
+                ++next_commit_;
+                committing_ = false;
+                cv_.notify_all();
+            }
+        }
+
+        Writer output_; ///< Writes formatted batches to the output
+        char delimiter_ {','}; ///< Delimiter character
+        char quote_ {'"'};     ///< Quote character
+
+        std::size_t threads_ { std::max(1u, std::thread::hardware_concurrency()) }; ///< Number of worker threads
+        std::size_t max_pending_ { 0 };                                             ///< Batches that may be submitted ahead of the output. 0 for 4 per thread
+        std::function<void(Writer &)> setup_;                                       ///< Sets up each batch's Writer
+
+        std::atomic<std::uint64_t> next_sequence_ { 0 }; ///< Returned by next_sequence()
+
+        std::mutex mutex_;           ///< Guards everything below
+        std::condition_variable cv_; ///< Wakes threads waiting for any change below
+
+        std::deque<Task> tasks_;                   ///< Batches waiting to be formatted
+        std::map<std::uint64_t, Batch> done_;      ///< Formatted batches waiting to be written, by sequence number
+        std::vector<std::string> free_buffers_;    ///< Buffers of written batches, for reuse
+        std::uint64_t next_commit_ { 0 };          ///< Sequence number of next batch to write
+        std::size_t busy_ { 0 };                   ///< Number of batches being formatted
+        bool committing_ { false };                ///< A batch is being written
+        bool stop_ { false };                      ///< Set to stop worker and committer threads
+        std::exception_ptr error_;                 ///< First exception thrown by a batch or by writing
+
+        std::vector<std::thread> workers_; ///< Worker threads. Empty when not started
+        std::thread committer_;            ///< Committer thread
+    };
+
+    /// @}
+};
+
+#endif // CSV_PARALLEL_HPP
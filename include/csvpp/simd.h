@@ -0,0 +1,145 @@
+/// @file
+/// @brief SIMD character search, shared by the C and C++ libraries
+
+// Copyright 2020 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Internal header. Used by csv.hpp and csv.c
+
+#ifndef CSV_SIMD_H
+#define CSV_SIMD_H
+
+/// @cond INTERNAL
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CSV_HAS_X86_SIMD
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// @defgroup c_simd CSV_find_structural
+/// @ingroup c
+/// @brief Structural character search
+/// @details Finds the next delimiter, quote, CR, or LF character. The reader
+/// uses this to skip over runs of ordinary field data, and the writers use it
+/// to decide whether a field needs to be quoted. Implementations for wider
+/// vector instructions are selected at runtime by CSV_select_find_structural.
+
+/// Signature shared by CSV_find_structural implementations
+
+/// @ingroup c_simd
+typedef const char * (*CSV_find_structural_fun)(const char * begin, const char * end, char delimiter, char quote);
+
+/// Find next structural character, one byte at a time
+
+/// @param begin Start of data to search
+/// @param end End of data to search
+/// @param delimiter Delimiter character
+/// @param quote Quote character
+/// @returns Pointer to first delimiter, quote, CR, or LF in [begin, end), or end if none found
+/// @ingroup c_simd
+static inline const char * CSV_find_structural_scalar(const char * begin, const char * end, char delimiter, char quote)
+{
+    for(; begin != end; ++begin)
+    {
+        char c = *begin;
+        if(c == delimiter || c == quote || c == '\r' || c == '\n')
+            break;
+    }
+    return begin;
+}
+
+#ifdef CSV_HAS_X86_SIMD
+/// Find next structural character, 16 bytes at a time using SSE4.2
+
+/// @copydetails CSV_find_structural_scalar
+/// @ingroup c_simd
+__attribute__((target("sse4.2")))
+static inline const char * CSV_find_structural_sse42(const char * begin, const char * end, char delimiter, char quote)
+{
+    const __m128i needle = _mm_setr_epi8(delimiter, quote, '\r', '\n', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+
+    for(; end - begin >= 16; begin += 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)begin);
+        int idx = _mm_cmpestri(needle, 4, block, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+        if(idx < 16)
+            return begin + idx;
+    }
+
+    return CSV_find_structural_scalar(begin, end, delimiter, quote);
+}
+
+/// Find next structural character, 32 bytes at a time using AVX2
+
+/// @copydetails CSV_find_structural_scalar
+/// @ingroup c_simd
+__attribute__((target("avx2")))
+static inline const char * CSV_find_structural_avx2(const char * begin, const char * end, char delimiter, char quote)
+{
+    const __m256i delimiter_v = _mm256_set1_epi8(delimiter);
+    const __m256i quote_v     = _mm256_set1_epi8(quote);
+    const __m256i cr_v        = _mm256_set1_epi8('\r');
+    const __m256i lf_v        = _mm256_set1_epi8('\n');
+
+    for(; end - begin >= 32; begin += 32)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i *)begin);
+        __m256i match = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(block, delimiter_v), _mm256_cmpeq_epi8(block, quote_v)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(block, cr_v), _mm256_cmpeq_epi8(block, lf_v)));
+
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(match);
+        if(mask != 0)
+            return begin + __builtin_ctz(mask);
+    }
+
+    return CSV_find_structural_sse42(begin, end, delimiter, quote);
+}
+#endif
+
+/// Select the fastest CSV_find_structural implementation the CPU supports
+
+/// Callers should select once, and keep the result
+/// @returns CSV_find_structural implementation
+/// @ingroup c_simd
+static inline CSV_find_structural_fun CSV_select_find_structural(void)
+{
+#ifdef CSV_HAS_X86_SIMD
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        return CSV_find_structural_avx2;
+    if(__builtin_cpu_supports("sse4.2"))
+        return CSV_find_structural_sse42;
+#endif
+    return CSV_find_structural_scalar;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/// @endcond INTERNAL
+
+#endif // CSV_SIMD_H
@@ -0,0 +1,472 @@
+/// @file
+/// @brief io_uring file reader, shared by the C and C++ libraries
+
+// Copyright 2020 Matthew Chandler
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Internal header. Used by csv.hpp and csv.c when built with CSVPP_USE_IO_URING.
+// Requires POSIX. C sources must define _DEFAULT_SOURCE (or equivalent) before
+// including any system headers.
+
+#ifndef CSV_URING_H
+#define CSV_URING_H
+
+/// @cond INTERNAL
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#define CSV_HAS_IO_URING
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// @defgroup c_uring CSV_uring
+/// @ingroup c
+/// @brief Sequential file reader
+/// @details Reads a file in large blocks, keeping several reads in flight
+/// through io_uring, into buffers registered with the kernel. Falls back to
+/// reading one block at a time with pread when io_uring is not available,
+/// or is not permitted at runtime.
+
+/// @brief Default number of reads kept in flight
+/// @ingroup c_uring
+enum {CSV_URING_DEPTH = 8};
+
+/// @brief Default size of each read
+/// @ingroup c_uring
+enum {CSV_URING_BLOCK_SIZE = 1024 * 1024};
+
+/// Sequential file reader
+
+/// @ingroup c_uring
+typedef struct CSV_uring
+{
+    int fd;                ///< File being read
+    uint64_t offset;       ///< Offset of block 0
+    size_t block_size;     ///< Size of each read
+    unsigned depth;        ///< Number of buffers
+    char * buffers;        ///< Storage for \c depth buffers of \c block_size
+    int * results;         ///< Result of the read into each buffer, when complete
+    bool * complete;       ///< \c true for each buffer whose read has completed
+    uint64_t next_block;   ///< Next block to return
+    uint64_t submitted;    ///< Number of blocks submitted
+    bool last;             ///< The last block has been returned
+
+    int ring_fd;           ///< io_uring instance, or -1 if reading with pread
+#ifdef CSV_HAS_IO_URING
+    bool fixed;            ///< Buffers are registered
+    unsigned in_flight;    ///< Number of reads submitted but not yet reaped
+
+    void * sq_ptr;         ///< Submission queue ring mapping
+    size_t sq_size;        ///< Size of sq_ptr mapping
+    void * cq_ptr;         ///< Completion queue ring mapping. May equal sq_ptr
+    size_t cq_size;        ///< Size of cq_ptr mapping
+    struct io_uring_sqe * sqes; ///< Submission queue entries
+    size_t sqes_size;      ///< Size of sqes mapping
+
+    unsigned * sq_tail;    ///< Submission queue tail
+    unsigned * sq_mask;    ///< Submission queue index mask
+    unsigned * sq_array;   ///< Submission queue index array
+    unsigned * cq_head;    ///< Completion queue head
+    unsigned * cq_tail;    ///< Completion queue tail
+    unsigned * cq_mask;    ///< Completion queue index mask
+    struct io_uring_cqe * cqes; ///< Completion queue entries
+#endif
+} CSV_uring;
+
+/// Read a full block with pread
+
+/// Retries short reads, so the block is only short at end of file
+/// @returns Number of bytes read, or -1 on error
+/// @ingroup c_uring
+static inline ptrdiff_t CSV_uring_pread(int fd, char * data, size_t size, uint64_t offset)
+{
+    size_t total = 0;
+    while(total < size)
+    {
+        ssize_t read_size = pread(fd, data + total, size - total, (off_t)(offset + total));
+        if(read_size < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            return -1;
+        }
+        if(read_size == 0)
+            break;
+        total += (size_t)read_size;
+    }
+    return (ptrdiff_t)total;
+}
+
+#ifdef CSV_HAS_IO_URING
+
+/// Queue a read of the next block
+/// @ingroup c_uring
+static inline void CSV_uring_queue(CSV_uring * uring)
+{
+    uint64_t block = uring->submitted++;
+    unsigned buffer = (unsigned)(block % uring->depth);
+    uring->complete[buffer] = false;
+
+    unsigned tail = *uring->sq_tail;
+    unsigned index = tail & *uring->sq_mask;
+
+    struct io_uring_sqe * sqe = &uring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = uring->fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = uring->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(uring->buffers + buffer * uring->block_size);
+    sqe->len = (uint32_t)uring->block_size;
+    sqe->off = uring->offset + block * uring->block_size;
+    sqe->buf_index = (uint16_t)(uring->fixed ? buffer : 0);
+    sqe->user_data = block;
+
+    uring->sq_array[index] = index;
+    __atomic_store_n(uring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++uring->in_flight;
+}
+
+/// Submit queued reads, and optionally wait for one to complete
+
+/// @returns \c false on error
+/// @ingroup c_uring
+static inline bool CSV_uring_enter(CSV_uring * uring, unsigned to_submit, bool wait)
+{
+    while(syscall(__NR_io_uring_enter, uring->ring_fd, to_submit, wait ? 1u : 0u,
+                wait ? IORING_ENTER_GETEVENTS : 0u, NULL, 0) < 0)
+    {
+        if(errno != EINTR && errno != EAGAIN)
+            return false;
+    }
+    return true;
+}
+
+/// Record results of all completed reads
+/// @ingroup c_uring
+static inline void CSV_uring_reap(CSV_uring * uring)
+{
+    unsigned head = *uring->cq_head;
+    unsigned tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+    for(; head != tail; ++head)
+    {
+        struct io_uring_cqe * cqe = &uring->cqes[head & *uring->cq_mask];
+        unsigned buffer = (unsigned)(cqe->user_data % uring->depth);
+        uring->results[buffer] = cqe->res;
+        uring->complete[buffer] = true;
+        --uring->in_flight;
+    }
+    __atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/// Wait for all reads in flight, so their buffers may be reused or freed
+/// @ingroup c_uring
+static inline void CSV_uring_drain(CSV_uring * uring)
+{
+    while(uring->in_flight > 0)
+    {
+        CSV_uring_reap(uring);
+        if(uring->in_flight > 0 && !CSV_uring_enter(uring, 0, true))
+            break;
+    }
+}
+
+/// Queue reads into every buffer, starting from block \c next_block
+/// @returns \c false on error
+/// @ingroup c_uring
+static inline bool CSV_uring_start(CSV_uring * uring)
+{
+    uring->submitted = uring->next_block;
+    for(unsigned i = 0; i < uring->depth; ++i)
+        CSV_uring_queue(uring);
+    return CSV_uring_enter(uring, uring->depth, false);
+}
+
+/// Release io_uring resources, and fall back to pread
+/// @ingroup c_uring
+static inline void CSV_uring_close_ring(CSV_uring * uring)
+{
+    if(uring->ring_fd < 0)
+        return;
+
+    CSV_uring_drain(uring);
+
+    if(uring->sqes)
+        munmap(uring->sqes, uring->sqes_size);
+    if(uring->cq_ptr && uring->cq_ptr != uring->sq_ptr)
+        munmap(uring->cq_ptr, uring->cq_size);
+    if(uring->sq_ptr)
+        munmap(uring->sq_ptr, uring->sq_size);
+
+    close(uring->ring_fd);
+    uring->ring_fd = -1;
+}
+
+/// Set up an io_uring instance
+
+/// @returns \c false if io_uring is not available. The reader is left using pread
+/// @ingroup c_uring
+static inline bool CSV_uring_open_ring(CSV_uring * uring)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    long ring_fd = syscall(__NR_io_uring_setup, uring->depth, &params);
+    if(ring_fd < 0)
+        return false;
+
+    uring->ring_fd = (int)ring_fd;
+
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    uring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    uring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(single_mmap)
+    {
+        if(uring->cq_size > uring->sq_size)
+            uring->sq_size = uring->cq_size;
+        uring->cq_size = uring->sq_size;
+    }
+    uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    void * sq_ptr = mmap(NULL, uring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED, uring->ring_fd, IORING_OFF_SQ_RING);
+    void * cq_ptr = single_mmap ? sq_ptr : mmap(NULL, uring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED, uring->ring_fd, IORING_OFF_CQ_RING);
+    void * sqes = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED, uring->ring_fd, IORING_OFF_SQES);
+
+    uring->sq_ptr = sq_ptr != MAP_FAILED ? sq_ptr : NULL;
+    uring->cq_ptr = cq_ptr != MAP_FAILED ? cq_ptr : NULL;
+    uring->sqes = sqes != MAP_FAILED ? (struct io_uring_sqe *)sqes : NULL;
+    if(!uring->sq_ptr || !uring->cq_ptr || !uring->sqes)
+    {
+        CSV_uring_close_ring(uring);
+        return false;
+    }
+
+    uring->sq_tail = (unsigned *)((char *)uring->sq_ptr + params.sq_off.tail);
+    uring->sq_mask = (unsigned *)((char *)uring->sq_ptr + params.sq_off.ring_mask);
+    uring->sq_array = (unsigned *)((char *)uring->sq_ptr + params.sq_off.array);
+    uring->cq_head = (unsigned *)((char *)uring->cq_ptr + params.cq_off.head);
+    uring->cq_tail = (unsigned *)((char *)uring->cq_ptr + params.cq_off.tail);
+    uring->cq_mask = (unsigned *)((char *)uring->cq_ptr + params.cq_off.ring_mask);
+    uring->cqes = (struct io_uring_cqe *)((char *)uring->cq_ptr + params.cq_off.cqes);
+
+    // registered buffers skip mapping user memory on every read. Registration
+    // may fail if the buffers exceed RLIMIT_MEMLOCK, so this is optional
+    struct iovec * iovecs = (struct iovec *)malloc(sizeof(struct iovec) * uring->depth);
+    if(iovecs)
+    {
+        for(unsigned i = 0; i < uring->depth; ++i)
+        {
+            iovecs[i].iov_base = uring->buffers + i * uring->block_size;
+            iovecs[i].iov_len = uring->block_size;
+        }
+        uring->fixed = syscall(__NR_io_uring_register, uring->ring_fd, IORING_REGISTER_BUFFERS, iovecs, uring->depth) == 0;
+        free(iovecs);
+    }
+
+    if(!CSV_uring_start(uring))
+    {
+        CSV_uring_close_ring(uring);
+        return false;
+    }
+
+    return true;
+}
+
+#endif // CSV_HAS_IO_URING
+
+/// Initialize a reader
+
+/// @param uring Reader to initialize. Free with CSV_uring_free()
+/// @param fd File to read. Caller remains responsible to close it
+/// @param offset Offset to start reading from
+/// @param block_size Size of each read. Must be greater than 0
+/// @param depth Number of reads to keep in flight. Must be greater than 0
+/// @returns \c false if memory could not be allocated, with errno set to
+/// ENOMEM. Nothing needs to be freed in that case
+/// @ingroup c_uring
+static inline bool CSV_uring_init(CSV_uring * uring, int fd, uint64_t offset, size_t block_size, unsigned depth)
+{
+    memset(uring, 0, sizeof(*uring));
+    uring->fd = fd;
+    uring->offset = offset;
+    uring->block_size = block_size;
+    uring->depth = depth;
+    uring->ring_fd = -1;
+
+    if(block_size > SIZE_MAX / depth)
+    {
+        errno = ENOMEM;
+        return false;
+    }
+
+    uring->buffers = (char *)malloc(block_size * depth);
+    uring->results = (int *)malloc(sizeof(int) * depth);
+    uring->complete = (bool *)malloc(sizeof(bool) * depth);
+    if(!uring->buffers || !uring->results || !uring->complete)
+    {
+        free(uring->buffers);
+        free(uring->results);
+        free(uring->complete);
+        errno = ENOMEM;
+        return false;
+    }
+
+#ifdef CSV_HAS_IO_URING
+    CSV_uring_open_ring(uring);
+#endif
+    return true;
+}
+
+/// Stop using io_uring, and read with pread from now on
+
+/// Waits for any reads in flight. Does nothing if already reading with pread
+/// @ingroup c_uring
+static inline void CSV_uring_use_pread(CSV_uring * uring)
+{
+#ifdef CSV_HAS_IO_URING
+    CSV_uring_close_ring(uring);
+#else
+    (void)uring;
+#endif
+}
+
+/// Free resources held by a reader. Does not close the file
+/// @ingroup c_uring
+static inline void CSV_uring_free(CSV_uring * uring)
+{
+#ifdef CSV_HAS_IO_URING
+    CSV_uring_close_ring(uring);
+#endif
+    free(uring->buffers);
+    free(uring->results);
+    free(uring->complete);
+}
+
+/// Get the next block of the file
+
+/// @param[out] data Set to the start of the block. Valid until the next call
+/// @returns Size of the block, 0 at end of file, or -1 on error. See errno for details
+/// @ingroup c_uring
+static inline ptrdiff_t CSV_uring_next(CSV_uring * uring, const char ** data)
+{
+    if(uring->last)
+        return 0;
+
+    uint64_t block = uring->next_block;
+    char * buffer = uring->buffers + (block % uring->depth) * uring->block_size;
+    uint64_t offset = uring->offset + block * uring->block_size;
+    ptrdiff_t size;
+
+#ifdef CSV_HAS_IO_URING
+    if(uring->ring_fd >= 0)
+    {
+        // the previous block has been consumed. Reuse its buffer
+        if(uring->submitted < block + uring->depth)
+        {
+            CSV_uring_queue(uring);
+            if(!CSV_uring_enter(uring, 1, false))
+                return -1;
+        }
+
+        unsigned index = (unsigned)(block % uring->depth);
+        while(!uring->complete[index])
+        {
+            CSV_uring_reap(uring);
+            if(!uring->complete[index] && !CSV_uring_enter(uring, 0, true))
+                return -1;
+        }
+
+        size = uring->results[index];
+        if(size < 0)
+        {
+            // eg. IORING_OP_READ is not supported by older kernels. Retry with pread
+            size = CSV_uring_pread(uring->fd, buffer, uring->block_size, offset);
+        }
+        else if((size_t)size < uring->block_size && size > 0)
+        {
+            // a short read is not necessarily the end of the file. Read the rest
+            ptrdiff_t rest = CSV_uring_pread(uring->fd, buffer + size, uring->block_size - (size_t)size, offset + (uint64_t)size);
+            size = rest < 0 ? -1 : size + rest;
+        }
+    }
+    else
+#endif
+    {
+        size = CSV_uring_pread(uring->fd, buffer, uring->block_size, offset);
+    }
+
+    if(size < 0)
+        return -1;
+
+    ++uring->next_block;
+    if((size_t)size < uring->block_size)
+        uring->last = true;
+
+    *data = buffer;
+    return size;
+}
+
+/// Move to a new position in the file
+
+/// Cancels any reads in flight
+/// @param offset Offset to read from next
+/// @returns \c false on error
+/// @ingroup c_uring
+static inline bool CSV_uring_seek(CSV_uring * uring, uint64_t offset)
+{
+    uring->offset = offset;
+    uring->next_block = 0;
+    uring->last = false;
+
+#ifdef CSV_HAS_IO_URING
+    if(uring->ring_fd >= 0)
+    {
+        CSV_uring_drain(uring);
+        if(!CSV_uring_start(uring))
+            return false;
+    }
+#endif
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/// @endcond INTERNAL
+
+#endif // CSV_URING_H
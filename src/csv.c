@@ -21,9 +21,41 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#ifndef _WIN32
+// for POSIX file functions, including fseeko / ftello
+#define _DEFAULT_SOURCE
+// 64-bit file offsets, even on 32-bit platforms
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include <errno.h>
+#include <limits.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef CSVPP_USE_IO_URING
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "csvpp/uring.h"
+#endif
+
+#include "csvpp/simd.h"
+
+#if defined(CSVPP_USE_ZLIB) || defined(CSVPP_USE_ZSTD)
+#define CSVPP_HAS_COMPRESSION
+#endif
+
+#ifdef CSVPP_USE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef CSVPP_USE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "csvpp/csv.h"
 
 /// @cond INTERNAL
@@ -145,6 +177,26 @@ static void CSV_string_append(CSV_string * str, const char c)
     str->str[str->size++] = c;
 }
 
+/// Append characters to the string
+
+/// @param data Characters to append
+/// @param size Number of characters to append
+/// @ingroup c_str
+static void CSV_string_append_n(CSV_string * str, const char * data, size_t size)
+{
+    if(!str || size == 0)
+        return;
+
+    if(str->size + size > str->alloc)
+    {
+        str->alloc = str->alloc * 2 > str->size + size ? str->alloc * 2 : str->size + size;
+        str->str = (char *)realloc(str->str, sizeof(char) * str->alloc);
+    }
+
+    memcpy(str->str + str->size, data, size);
+    str->size += size;
+}
+
 /// @brief CSV row
 /// @ingroup c_row
 struct CSV_row
@@ -232,6 +284,226 @@ const char * const * CSV_row_arr(const CSV_row * rec)
     return (const char * const *)rec->fields_;
 }
 
+#ifdef CSVPP_HAS_COMPRESSION
+
+/// Detect compression format from the first bytes of input
+
+/// Only formats that are enabled are detected
+/// @param data First bytes of input
+/// @param size Number of bytes in \c data
+/// @returns Compression format, or CSV_COMPRESSION_NONE if not recognized
+/// @ingroup c_reader
+static CSV_compression CSV_detect_compression(const char * data, size_t size)
+{
+#ifdef CSVPP_USE_ZLIB
+    if(size >= 2 && memcmp(data, "\x1f\x8b", 2) == 0)
+        return CSV_COMPRESSION_GZIP;
+#endif
+#ifdef CSVPP_USE_ZSTD
+    // a frame, or a skippable frame such as a seek table
+    if(size >= 4 && (memcmp(data, "\x28\xb5\x2f\xfd", 4) == 0 || ((data[0] & 0xf0) == 0x50 && memcmp(data + 1, "\x2a\x4d\x18", 3) == 0)))
+        return CSV_COMPRESSION_ZSTD;
+#endif
+    return CSV_COMPRESSION_NONE;
+}
+
+/// @brief Size of compressed and decompressed blocks
+/// @ingroup c_reader
+enum {CSV_DECOMPRESS_BLOCK_SIZE = 64 * 1024};
+
+/// Decompresses a file in blocks
+
+/// @ingroup c_reader
+typedef struct
+{
+    FILE * file;                             ///< Compressed input
+    CSV_compression format;                  ///< Compression format. CSV_COMPRESSION_NONE passes input through
+    char in[CSV_DECOMPRESS_BLOCK_SIZE];      ///< Compressed data
+    char out[CSV_DECOMPRESS_BLOCK_SIZE];     ///< Decompressed data
+    size_t in_pos;                           ///< Next unused byte of \c in
+    size_t in_size;                          ///< Bytes read into \c in
+    bool in_frame;                           ///< Part way through a gzip member or zstd frame
+    bool pending;                            ///< \c out filled on last call, so more may be pending
+#ifdef CSVPP_USE_ZLIB
+    z_stream zstream;                        ///< zlib state
+#endif
+#ifdef CSVPP_USE_ZSTD
+    ZSTD_DStream * zstd;                     ///< zstd state
+#endif
+} CSV_decompressor;
+
+/// Read the next block of compressed data
+
+/// @returns \c false at end of input or on error
+/// @ingroup c_reader
+static bool CSV_decompressor_refill(CSV_decompressor * decomp)
+{
+    decomp->in_pos = 0;
+    decomp->in_size = fread(decomp->in, 1, sizeof(decomp->in), decomp->file);
+    return decomp->in_size > 0;
+}
+
+/// Create a new decompressor
+
+/// @param file File to read from. Closed by CSV_decompressor_free()
+/// @param compression Compression format, or CSV_COMPRESSION_DETECT to detect
+/// from the start of \c file
+/// @returns New decompressor. Free with CSV_decompressor_free()
+/// @returns NULL on error
+/// @ingroup c_reader
+static CSV_decompressor * CSV_decompressor_init(FILE * file, CSV_compression compression)
+{
+    CSV_decompressor * decomp = (CSV_decompressor *)malloc(sizeof(CSV_decompressor));
+    if(!decomp)
+        return NULL;
+
+    decomp->file = file;
+    decomp->in_frame = decomp->pending = false;
+
+    // the first block stays in the buffer to be decompressed
+    CSV_decompressor_refill(decomp);
+    if(ferror(file))
+        goto error;
+
+    if(compression == CSV_COMPRESSION_DETECT)
+        compression = CSV_detect_compression(decomp->in, decomp->in_size);
+
+    decomp->format = compression;
+
+#ifdef CSVPP_USE_ZLIB
+    if(compression == CSV_COMPRESSION_GZIP)
+    {
+        memset(&decomp->zstream, 0, sizeof(decomp->zstream));
+
+        // +32 detects a gzip or zlib header
+        if(inflateInit2(&decomp->zstream, 15 + 32) != Z_OK)
+            goto error;
+    }
+#endif
+#ifdef CSVPP_USE_ZSTD
+    if(compression == CSV_COMPRESSION_ZSTD)
+    {
+        decomp->zstd = ZSTD_createDStream();
+        if(!decomp->zstd)
+            goto error;
+        if(ZSTD_isError(ZSTD_initDStream(decomp->zstd)))
+        {
+            ZSTD_freeDStream(decomp->zstd);
+            goto error;
+        }
+    }
+#endif
+
+    return decomp;
+
+error:
+    free(decomp);
+    return NULL;
+}
+
+/// Free a decompressor and close its file
+
+/// @ingroup c_reader
+static void CSV_decompressor_free(CSV_decompressor * decomp)
+{
+    if(!decomp)
+        return;
+
+#ifdef CSVPP_USE_ZLIB
+    if(decomp->format == CSV_COMPRESSION_GZIP)
+        inflateEnd(&decomp->zstream);
+#endif
+#ifdef CSVPP_USE_ZSTD
+    if(decomp->format == CSV_COMPRESSION_ZSTD)
+        ZSTD_freeDStream(decomp->zstd);
+#endif
+
+    fclose(decomp->file);
+    free(decomp);
+}
+
+/// Get the next block of decompressed data
+
+/// @param data Set to the start of the block, valid until the next call
+/// @returns Size of the block. 0 at end of input, or -1 on error (including
+/// corrupt or truncated input)
+/// @ingroup c_reader
+static ptrdiff_t CSV_decompressor_next(CSV_decompressor * decomp, const char ** data)
+{
+    if(decomp->format == CSV_COMPRESSION_NONE)
+    {
+        if(decomp->in_pos == decomp->in_size && !CSV_decompressor_refill(decomp))
+            return ferror(decomp->file) ? -1 : 0;
+
+        *data = decomp->in + decomp->in_pos;
+        ptrdiff_t size = (ptrdiff_t)(decomp->in_size - decomp->in_pos);
+        decomp->in_pos = decomp->in_size;
+        return size;
+    }
+
+    *data = decomp->out;
+    size_t out_size = 0;
+    while(out_size == 0)
+    {
+        // decompressed data may be pending from the last call, even with no input left
+        if(decomp->in_pos == decomp->in_size && !decomp->pending && !CSV_decompressor_refill(decomp))
+        {
+            if(ferror(decomp->file) || decomp->in_frame)
+                return -1;
+            break;
+        }
+
+#ifdef CSVPP_USE_ZLIB
+        if(decomp->format == CSV_COMPRESSION_GZIP)
+        {
+            decomp->zstream.next_in = (Bytef *)(decomp->in + decomp->in_pos);
+            decomp->zstream.avail_in = (uInt)(decomp->in_size - decomp->in_pos);
+            decomp->zstream.next_out = (Bytef *)decomp->out;
+            decomp->zstream.avail_out = sizeof(decomp->out);
+
+            int ret = inflate(&decomp->zstream, Z_NO_FLUSH);
+            decomp->in_pos = decomp->in_size - decomp->zstream.avail_in;
+            out_size = sizeof(decomp->out) - decomp->zstream.avail_out;
+            decomp->pending = decomp->zstream.avail_out == 0;
+
+            if(ret == Z_STREAM_END)
+            {
+                // another member may follow
+                decomp->in_frame = false;
+                inflateReset(&decomp->zstream);
+            }
+            else if(ret == Z_OK)
+                decomp->in_frame = true;
+            else if(ret != Z_BUF_ERROR) // no progress
+                return -1;
+        }
+#endif
+#ifdef CSVPP_USE_ZSTD
+        if(decomp->format == CSV_COMPRESSION_ZSTD)
+        {
+            ZSTD_inBuffer in = {decomp->in, decomp->in_size, decomp->in_pos};
+            ZSTD_outBuffer out = {decomp->out, sizeof(decomp->out), 0};
+
+            size_t ret = ZSTD_decompressStream(decomp->zstd, &out, &in);
+            if(ZSTD_isError(ret))
+                return -1;
+
+            out_size = out.pos;
+            decomp->pending = out.pos == out.size;
+
+            // with no progress, ret is a hint for the next frame
+            if(in.pos != decomp->in_pos || out.pos != 0)
+                decomp->in_frame = ret != 0;
+            decomp->in_pos = in.pos;
+        }
+#endif
+    }
+
+    return (ptrdiff_t)out_size;
+}
+
+#endif
+
 /// @brief CSV Reader
 /// @ingroup c_reader
 struct CSV_reader
@@ -240,15 +512,26 @@ struct CSV_reader
     {
         FILE * file_;      ///< Contains input file if initialized by CSV_reader_init_from_file() or CSV_reader_init_from_filename()
         const char * str_; ///< Contains input string if initialized by CSV_reader_init_from_str()
+#ifdef CSVPP_USE_IO_URING
+        CSV_uring * uring_; ///< Contains input file reader if initialized by CSV_reader_init_from_filename() with a regular file
+#endif
+#ifdef CSVPP_HAS_COMPRESSION
+        CSV_decompressor * decompressor_; ///< Contains input file reader if initialized with a compressed file
+#endif
     };
 
     /// Records how this CSV_reader was initialized
     enum {
         CSV_SOURCE_FILENAME, ///< Initialized by CSV_reader_init_from_filename()
         CSV_SOURCE_FILE,     ///< Initialized by CSV_reader_init_from_file()
-        CSV_SOURCE_STR       ///< Initialized by CSV_reader_init_from_str()
+        CSV_SOURCE_STR,      ///< Initialized by CSV_reader_init_from_str()
+        CSV_SOURCE_URING,    ///< Initialized by CSV_reader_init_from_filename() with a regular file, when built with CSVPP_USE_IO_URING
+        CSV_SOURCE_DECOMPRESS ///< Initialized with a compressed file, when built with CSVPP_USE_ZLIB or CSVPP_USE_ZSTD
     } source_;
 
+    const char * block_pos_; ///< Next character of current block, for CSV_SOURCE_URING and CSV_SOURCE_DECOMPRESS
+    const char * block_end_; ///< End of current block, for CSV_SOURCE_URING and CSV_SOURCE_DECOMPRESS
+
     /// Parsing states
     enum {
         CSV_STATE_READ,             ///< Ready to read a character into current field
@@ -263,6 +546,7 @@ struct CSV_reader
     bool end_of_row_;      ///< \c true if parsing is at the end of a row
     unsigned int line_no_; ///< Current line number within input
     unsigned int col_no_;  ///< Current column number within input
+    uint64_t remaining_;   ///< Bytes left to read if initialized by CSV_reader_init_from_shard(), otherwise UINT64_MAX
 
     CSV_status error_;     ///< Current error state
     char * error_message_; ///< Error details. NULL if no error has occurred
@@ -285,6 +569,9 @@ static CSV_reader * CSV_reader_init_common(void)
 
     reader->line_no_ = 1;
     reader->col_no_ = 0;
+    reader->remaining_ = UINT64_MAX;
+
+    reader->block_pos_ = reader->block_end_ = NULL;
 
     reader->delimiter_ = ',';
     reader->quote_ = '"';
@@ -332,6 +619,44 @@ static void CSV_reader_set_status(CSV_reader * reader, CSV_status error, const c
     }
 }
 
+/// Get the next block of input
+
+/// For block sources (CSV_SOURCE_URING and CSV_SOURCE_DECOMPRESS). Sets an
+/// empty block at end of input
+/// @returns \c false on IO error
+/// @ingroup c_reader
+static bool CSV_reader_next_block(CSV_reader * reader)
+{
+    const char * block = NULL;
+    ptrdiff_t size = 0;
+
+    switch(reader->source_)
+    {
+#ifdef CSVPP_USE_IO_URING
+    case CSV_SOURCE_URING:
+        size = CSV_uring_next(reader->uring_, &block);
+        break;
+#endif
+#ifdef CSVPP_HAS_COMPRESSION
+    case CSV_SOURCE_DECOMPRESS:
+        size = CSV_decompressor_next(reader->decompressor_, &block);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    if(size < 0)
+    {
+        CSV_reader_set_status(reader, CSV_IO_ERROR, "I/O Error", false);
+        return false;
+    }
+
+    reader->block_pos_ = block;
+    reader->block_end_ = block + size;
+    return true;
+}
+
 /// Get next character from input
 
 /// Updates line and column position, and checks for IO error
@@ -342,6 +667,10 @@ static int CSV_reader_getc(CSV_reader * reader)
     if(!reader)
         return '\0';
 
+    // end of shard
+    if(reader->remaining_ == 0)
+        return EOF;
+
     int c = '\0';
 
     switch(reader->source_)
@@ -354,6 +683,12 @@ static int CSV_reader_getc(CSV_reader * reader)
         if(*reader->str_)
             c = *(reader->str_++);
         break;
+    case CSV_SOURCE_URING:
+    case CSV_SOURCE_DECOMPRESS:
+        if(reader->block_pos_ == reader->block_end_ && !CSV_reader_next_block(reader))
+            return EOF;
+        c = reader->block_pos_ == reader->block_end_ ? EOF : (unsigned char)*(reader->block_pos_++);
+        break;
     }
 
     if((reader->source_ == CSV_SOURCE_FILENAME || reader->source_ == CSV_SOURCE_FILE) && c == EOF  && !feof(reader->file_))
@@ -367,6 +702,9 @@ static int CSV_reader_getc(CSV_reader * reader)
     else if(c != EOF && c != '\0')
         ++reader->col_no_;
 
+    if(c != EOF && reader->remaining_ != UINT64_MAX)
+        --reader->remaining_;
+
     return c;
 }
 
@@ -400,10 +738,16 @@ static void CSV_reader_consume_newlines(CSV_reader * reader)
             case CSV_SOURCE_FILENAME:
             case CSV_SOURCE_FILE:
                 ungetc(c, reader->file_);
+                if(reader->remaining_ != UINT64_MAX)
+                    ++reader->remaining_;
                 break;
             case CSV_SOURCE_STR:
                 --reader->str_;
                 break;
+            case CSV_SOURCE_URING:
+            case CSV_SOURCE_DECOMPRESS:
+                --reader->block_pos_;
+                break;
             }
             --reader->col_no_;
             break;
@@ -548,13 +892,100 @@ error:
     return NULL;
 }
 
-/// @}
+/// Open a file for reading
 
-CSV_reader * CSV_reader_init_from_filename(const char * filename)
+/// @param filename Path to file
+/// @param compression Compression format of the file
+/// @returns New CSV_reader object, or NULL on error
+/// @ingroup c_reader
+static CSV_reader * CSV_reader_open(const char * filename, CSV_compression compression)
 {
+#ifndef CSVPP_USE_ZLIB
+    if(compression == CSV_COMPRESSION_GZIP)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+#endif
+#ifndef CSVPP_USE_ZSTD
+    if(compression == CSV_COMPRESSION_ZSTD)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+#endif
+#ifndef CSVPP_HAS_COMPRESSION
+    compression = CSV_COMPRESSION_NONE;
+#endif
+
+#ifdef CSVPP_USE_IO_URING
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return NULL;
+
+    // pipes and other non-seekable files are read through stdio
+    struct stat st;
+    bool regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+
+#ifdef CSVPP_HAS_COMPRESSION
+    if(regular && compression == CSV_COMPRESSION_DETECT)
+    {
+        char magic[4];
+        ssize_t size = pread(fd, magic, sizeof(magic), 0);
+        compression = CSV_detect_compression(magic, size > 0 ? (size_t)size : 0);
+    }
+#endif
+
+    // compressed files are decompressed through stdio
+    if(regular && compression == CSV_COMPRESSION_NONE)
+    {
+        CSV_uring * uring = (CSV_uring *)malloc(sizeof(CSV_uring));
+        if(!uring || !CSV_uring_init(uring, fd, 0, CSV_URING_BLOCK_SIZE, CSV_URING_DEPTH))
+        {
+            free(uring);
+            close(fd);
+            errno = ENOMEM;
+            return NULL;
+        }
+
+        CSV_reader * reader = CSV_reader_init_common();
+
+        reader->source_ = CSV_SOURCE_URING;
+        reader->uring_ = uring;
+
+        return reader;
+    }
+
+    FILE * file = fdopen(fd, "rb");
+    if(!file)
+    {
+        close(fd);
+        return NULL;
+    }
+#else
     FILE * file = fopen(filename, "rb");
     if(!file)
         return NULL;
+#endif
+
+#ifdef CSVPP_HAS_COMPRESSION
+    if(compression != CSV_COMPRESSION_NONE)
+    {
+        CSV_decompressor * decomp = CSV_decompressor_init(file, compression);
+        if(!decomp)
+        {
+            fclose(file);
+            return NULL;
+        }
+
+        CSV_reader * reader = CSV_reader_init_common();
+
+        reader->source_ = CSV_SOURCE_DECOMPRESS;
+        reader->decompressor_ = decomp;
+
+        return reader;
+    }
+#endif
 
     CSV_reader * reader = CSV_reader_init_common();
 
@@ -564,6 +995,72 @@ CSV_reader * CSV_reader_init_from_filename(const char * filename)
     return reader;
 }
 
+/// Seek to an offset from the start of a file
+
+/// Unlike \c fseek, supports offsets past 2GiB where \c long is 32 bits
+/// @param file File to seek in
+/// @param offset Offset in bytes from the start of the file
+/// @returns \c false on error. Sets \c errno to \c ERANGE if \c offset is
+/// too large for the platform's file offsets
+/// @ingroup c_reader
+static bool CSV_file_seek(FILE * file, uint64_t offset)
+{
+#ifdef _WIN32
+    if(offset > INT64_MAX)
+    {
+        errno = ERANGE;
+        return false;
+    }
+    return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+    off_t pos = (off_t)offset;
+    if(pos < 0 || (uint64_t)pos != offset)
+    {
+        errno = ERANGE;
+        return false;
+    }
+    return fseeko(file, pos, SEEK_SET) == 0;
+#endif
+}
+
+/// Get the size of a file
+
+/// Unlike \c ftell, supports sizes past 2GiB where \c long is 32 bits. Leaves
+/// the file positioned at its end
+/// @param file File to get the size of. Must be seekable
+/// @param[out] size Size of the file in bytes
+/// @returns \c false on error
+/// @ingroup c_reader
+static bool CSV_file_size(FILE * file, uint64_t * size)
+{
+#ifdef _WIN32
+    if(_fseeki64(file, 0, SEEK_END) != 0)
+        return false;
+    __int64 end = _ftelli64(file);
+#else
+    if(fseeko(file, 0, SEEK_END) != 0)
+        return false;
+    off_t end = ftello(file);
+#endif
+    if(end < 0)
+        return false;
+
+    *size = (uint64_t)end;
+    return true;
+}
+
+/// @}
+
+CSV_reader * CSV_reader_init_from_filename(const char * filename)
+{
+    return CSV_reader_open(filename, CSV_COMPRESSION_DETECT);
+}
+
+CSV_reader * CSV_reader_init_from_filename_compressed(const char * filename, CSV_compression compression)
+{
+    return CSV_reader_open(filename, compression);
+}
+
 CSV_reader * CSV_reader_init_from_file(FILE * file)
 {
     if(!file)
@@ -577,6 +1074,34 @@ CSV_reader * CSV_reader_init_from_file(FILE * file)
     return reader;
 }
 
+CSV_reader * CSV_reader_init_from_shard(const char * filename, const CSV_shard * shard)
+{
+    if(!shard)
+        return NULL;
+
+    FILE * file = fopen(filename, "rb");
+    if(!file)
+        return NULL;
+
+    if(!CSV_file_seek(file, shard->begin))
+    {
+        int err = errno;
+        fclose(file);
+        errno = err;
+        return NULL;
+    }
+
+    CSV_reader * reader = CSV_reader_init_common();
+
+    reader->source_ = CSV_SOURCE_FILENAME;
+    reader->file_ = file;
+    reader->remaining_ = shard->end > shard->begin ? shard->end - shard->begin : 0;
+    reader->line_no_ = (unsigned int)shard->line;
+    reader->col_no_ = (unsigned int)shard->col;
+
+    return reader;
+}
+
 CSV_reader * CSV_reader_init_from_str(const char * input)
 {
     if(!input)
@@ -598,6 +1123,20 @@ void CSV_reader_free(CSV_reader * reader)
     if(reader->source_ == CSV_SOURCE_FILENAME)
         fclose(reader->file_);
 
+#ifdef CSVPP_HAS_COMPRESSION
+    if(reader->source_ == CSV_SOURCE_DECOMPRESS)
+        CSV_decompressor_free(reader->decompressor_);
+#endif
+
+#ifdef CSVPP_USE_IO_URING
+    if(reader->source_ == CSV_SOURCE_URING)
+    {
+        CSV_uring_free(reader->uring_);
+        close(reader->uring_->fd);
+        free(reader->uring_);
+    }
+#endif
+
     if(reader->error_message_)
         free(reader->error_message_);
 
@@ -774,6 +1313,160 @@ CSV_status CSV_reader_get_error(const CSV_reader * reader)
     return reader->error_;
 }
 
+/// @name Private Functions
+/// @{
+
+/// Find the first row start at or after each of a list of offsets
+
+/// Tracks quoting and line breaks from the start of the file. Assumes that
+/// quotes only appear in quoted fields
+/// @param filename Path to CSV file
+/// @param quote Quote character
+/// @param targets Offsets to search from, in ascending order
+/// @param num_targets Number of targets
+/// @param row_starts Set to the position of a row start for each target.
+/// Targets with no row start after them are given the end of the file.
+/// \c end is not set
+/// @returns \c false if unable to read the file
+/// @ingroup c_reader
+static bool CSV_find_row_starts(const char * filename, const char quote,
+        const uint64_t * targets, size_t num_targets, CSV_shard * row_starts)
+{
+    FILE * file = fopen(filename, "rb");
+    if(!file)
+        return false;
+
+    bool quoted = false;
+    bool after_newline = true;
+    uint64_t offset = 0, line = 1, line_start = 0;
+    size_t found = 0;
+
+    char buffer[4096];
+    size_t size;
+    while(found < num_targets && (size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        for(size_t i = 0; i < size && found < num_targets;)
+        {
+            char c = buffer[i];
+            if(quoted)
+            {
+                if(c == quote)
+                    quoted = false;
+            }
+            else if(c == '\r' || c == '\n')
+            {
+                after_newline = true;
+            }
+            else if(after_newline && offset >= targets[found])
+            {
+                // a later target may start at the same row, so don't advance
+                row_starts[found].begin = offset;
+                row_starts[found].line = line;
+                row_starts[found].col = offset - line_start;
+                ++found;
+                continue;
+            }
+            else
+            {
+                after_newline = false;
+                if(c == quote)
+                    quoted = true;
+            }
+
+            if(c == '\n')
+            {
+                ++line;
+                line_start = offset + 1;
+            }
+
+            ++i;
+            ++offset;
+        }
+    }
+
+    bool error = ferror(file);
+    fclose(file);
+    if(error)
+        return false;
+
+    for(; found < num_targets; ++found)
+    {
+        row_starts[found].begin = offset;
+        row_starts[found].line = line;
+        row_starts[found].col = offset - line_start;
+    }
+
+    return true;
+}
+
+/// @}
+
+bool CSV_resolve_shard(const char * filename, uint64_t begin, uint64_t end, const char quote, CSV_shard * shard)
+{
+    if(!shard)
+        return false;
+
+    uint64_t targets[2] = {begin, end > begin ? end : begin};
+    CSV_shard row_starts[2];
+    if(!CSV_find_row_starts(filename, quote, targets, 2, row_starts))
+        return false;
+
+    *shard = row_starts[0];
+    shard->end = row_starts[1].begin;
+
+    return true;
+}
+
+bool CSV_plan_shards(const char * filename, size_t count, const char quote, CSV_shard * shards)
+{
+    if(count == 0 || !shards)
+        return false;
+
+    FILE * file = fopen(filename, "rb");
+    if(!file)
+        return false;
+
+    uint64_t size = 0;
+    bool have_size = CSV_file_size(file, &size);
+    fclose(file);
+    if(!have_size)
+        return false;
+
+    if(count > SIZE_MAX / sizeof(CSV_shard) - 1)
+    {
+        errno = ENOMEM;
+        return false;
+    }
+
+    uint64_t * targets = (uint64_t *)malloc(sizeof(uint64_t) * (count + 1));
+    CSV_shard * row_starts = (CSV_shard *)malloc(sizeof(CSV_shard) * (count + 1));
+    if(!targets || !row_starts)
+    {
+        free(targets);
+        free(row_starts);
+        errno = ENOMEM;
+        return false;
+    }
+
+    for(size_t i = 0; i <= count; ++i)
+        targets[i] = (uint64_t)((long double)size * i / count);
+
+    bool ok = CSV_find_row_starts(filename, quote, targets, count + 1, row_starts);
+    if(ok)
+    {
+        for(size_t i = 0; i < count; ++i)
+        {
+            shards[i] = row_starts[i];
+            shards[i].end = row_starts[i + 1].begin;
+        }
+    }
+
+    free(targets);
+    free(row_starts);
+
+    return ok;
+}
+
 /// @brief CSV Writer
 struct CSV_writer
 {
@@ -793,6 +1486,8 @@ struct CSV_writer
     char delimiter_;    ///< Delimiter character (default ',')
     char quote_;        ///< Quote character (default '"')
     bool start_of_row_; ///< for keeping track if when a row needs to be ended
+
+    CSV_find_structural_fun find_structural_; ///< Checks if fields need quoting
 };
 
 /// @name Private Functions
@@ -811,6 +1506,8 @@ static CSV_writer * CSV_writer_init_common(void)
 
     writer->start_of_row_ = true;
 
+    writer->find_structural_ = CSV_select_find_structural();
+
     return writer;
 }
 
@@ -839,6 +1536,31 @@ static CSV_status CSV_writer_putc(CSV_writer * writer, const char c)
     return CSV_OK;
 }
 
+/// Append characters
+
+/// Append characters to output and check for errors
+/// @param data characters to append
+/// @param size number of characters to append
+/// @returns #CSV_OK if successful
+/// @returns #CSV_IO_ERROR if an error occurs while writing
+/// @ingroup c_writer
+static CSV_status CSV_writer_write(CSV_writer * writer, const char * data, size_t size)
+{
+    switch(writer->dest_)
+    {
+    case CSV_DEST_FILENAME:
+    case CSV_DEST_FILE:
+        if(fwrite(data, 1, size, writer->file_) != size)
+            return CSV_IO_ERROR;
+        break;
+    case CSV_DEST_STR:
+        CSV_string_append_n(writer->str_, data, size);
+        break;
+    }
+
+    return CSV_OK;
+}
+
 /// @}
 
 CSV_writer * CSV_writer_init_from_filename(const char * filename)
@@ -937,36 +1659,32 @@ CSV_status CSV_writer_write_field(CSV_writer * writer, const char * field)
 
     if(field)
     {
-        bool quoted = false;
-        for(const char * i = field; *i; ++i)
-        {
-            if(*i == writer->quote_ || *i == writer->delimiter_ || *i == '\n' || *i == '\r')
-            {
-                quoted = true;
-                break;
-            }
-        }
+        const char * end = field + strlen(field);
 
-        if(quoted)
+        // fields without any delimiters, quotes, or newlines are written as-is
+        if(writer->find_structural_(field, end, writer->delimiter_, writer->quote_) == end)
         {
-            if((status = CSV_writer_putc(writer, writer->quote_)) != CSV_OK)
+            if((status = CSV_writer_write(writer, field, (size_t)(end - field))) != CSV_OK)
                 return status;
         }
-
-        for(const char * i = field; *i; ++i)
+        else
         {
-            if((status = CSV_writer_putc(writer, *i)) != CSV_OK)
+            if((status = CSV_writer_putc(writer, writer->quote_)) != CSV_OK)
                 return status;
 
-            if(*i == writer->quote_)
+            // write the runs between quotes, doubling each quote
+            const char * begin = field;
+            for(const char * q; (q = (const char *)memchr(begin, writer->quote_, (size_t)(end - begin))); begin = q + 1)
             {
+                if((status = CSV_writer_write(writer, begin, (size_t)(q + 1 - begin))) != CSV_OK)
+                    return status;
                 if((status = CSV_writer_putc(writer, writer->quote_)) != CSV_OK)
                     return status;
             }
-        }
 
-        if(quoted)
-        {
+            if((status = CSV_writer_write(writer, begin, (size_t)(end - begin))) != CSV_OK)
+                return status;
+
             if((status = CSV_writer_putc(writer, writer->quote_)) != CSV_OK)
                 return status;
         }
@@ -1,6 +1,8 @@
 #include "c_test.hpp"
 
 #include <array>
+#include <filesystem>
+#include <fstream>
 
 #include "csvpp/csv.h"
 
@@ -105,6 +107,138 @@ test::Result test_read_c_row(const std::string & csv_text, const CSV_data & expe
     return CSV_test_suite::common_read_return(csv_text, expected_data, data);
 }
 
+test::Result test_read_c_shards(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    // shard boundaries are not guaranteed for quotes in unquoted fields, which lenient mode allows
+    if(lenient)
+        return test::skip();
+
+    auto filename = (std::filesystem::temp_directory_path() / "csvpp_test_c_shards.csv").string();
+    {
+        std::ofstream out{filename, std::ios::binary};
+        out<<csv_text;
+    }
+
+    // split into byte ranges, as independent processes would
+    std::uint64_t step = std::max(std::size(csv_text) / 16, std::size_t{3});
+    std::vector<CSV_shard> shards;
+    for(std::uint64_t begin = 0; begin < std::size(csv_text); begin += step)
+    {
+        CSV_shard shard;
+        if(!CSV_resolve_shard(filename.c_str(), begin, begin + step, quote, &shard))
+            throw std::runtime_error("could not resolve shard");
+        shards.push_back(shard);
+    }
+
+    std::array<CSV_shard, 7> planned_shards;
+    if(!CSV_plan_shards(filename.c_str(), std::size(planned_shards), quote, std::data(planned_shards)))
+        throw std::runtime_error("could not plan shards");
+    shards.insert(std::end(shards), std::begin(planned_shards), std::end(planned_shards));
+
+    // the file is read twice: first split into resolved shards, then planned shards
+    CSV_data data;
+    for(auto & shard: shards)
+    {
+        CSV_reader * r = CSV_reader_init_from_shard(filename.c_str(), &shard);
+        if(!r)
+            throw std::runtime_error("could not init CSV_reader");
+
+        CSV_reader_set_delimiter(r, delimiter);
+        CSV_reader_set_quote(r, quote);
+        CSV_reader_set_lenient(r, lenient);
+
+        while(true)
+        {
+            auto rec = CSV_reader_read_row(r);
+            if(rec)
+            {
+                data.emplace_back(CSV_row_arr(rec), CSV_row_arr(rec) + CSV_row_size(rec));
+                CSV_row_free(rec);
+            }
+
+            else if(CSV_reader_eof(r))
+                break;
+
+            else
+            {
+                std::string msg = CSV_reader_get_error_msg(r);
+                auto error = CSV_reader_get_error(r);
+                CSV_reader_free(r);
+                std::filesystem::remove(filename);
+
+                if(error == CSV_PARSE_ERROR)
+                    return test::error();
+                throw std::runtime_error{"bad error for CSV_reader: " + msg};
+            }
+        }
+
+        CSV_reader_free(r);
+    }
+
+    std::filesystem::remove(filename);
+
+    auto expected_twice = expected_data;
+    expected_twice.insert(std::end(expected_twice), std::begin(expected_data), std::end(expected_data));
+    return CSV_test_suite::common_read_return(csv_text, expected_twice, data);
+}
+
+#ifdef CSVPP_USE_ZLIB
+test::Result test_read_c_gzip(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    auto filename = (std::filesystem::temp_directory_path() / "csvpp_test_c_gzip.csv.gz").string();
+    {
+        std::ofstream out{filename, std::ios::binary};
+        out<<CSV_test_suite::gzip(csv_text);
+    }
+
+    // the file is read twice: first detected, then with the format given
+    CSV_data data;
+    for(auto compression: {CSV_COMPRESSION_DETECT, CSV_COMPRESSION_GZIP})
+    {
+        CSV_reader * r = CSV_reader_init_from_filename_compressed(filename.c_str(), compression);
+        if(!r)
+            throw std::runtime_error("could not init CSV_reader");
+
+        CSV_reader_set_delimiter(r, delimiter);
+        CSV_reader_set_quote(r, quote);
+        CSV_reader_set_lenient(r, lenient);
+
+        while(true)
+        {
+            auto rec = CSV_reader_read_row(r);
+            if(rec)
+            {
+                data.emplace_back(CSV_row_arr(rec), CSV_row_arr(rec) + CSV_row_size(rec));
+                CSV_row_free(rec);
+            }
+
+            else if(CSV_reader_eof(r))
+                break;
+
+            else
+            {
+                std::string msg = CSV_reader_get_error_msg(r);
+                auto error = CSV_reader_get_error(r);
+                CSV_reader_free(r);
+                std::filesystem::remove(filename);
+
+                if(error == CSV_PARSE_ERROR)
+                    return test::error();
+                throw std::runtime_error{"bad error for CSV_reader: " + msg};
+            }
+        }
+
+        CSV_reader_free(r);
+    }
+
+    std::filesystem::remove(filename);
+
+    auto expected_twice = expected_data;
+    expected_twice.insert(std::end(expected_twice), std::begin(expected_data), std::end(expected_data));
+    return CSV_test_suite::common_read_return(csv_text, expected_twice, data);
+}
+#endif
+
 test::Result test_read_c_row_variadic(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
 {
     CSV_reader * r = CSV_reader_init_from_str(csv_text.c_str());
@@ -630,6 +764,10 @@ void C_test::register_tests(CSV_test_suite & tests) const
 {
     tests.register_read_test(test_read_c_field);
     tests.register_read_test(test_read_c_row);
+    tests.register_read_test(test_read_c_shards);
+#ifdef CSVPP_USE_ZLIB
+    tests.register_read_test(test_read_c_gzip);
+#endif
     tests.register_read_test(test_read_c_row_variadic);
     tests.register_read_test(test_read_c_ptr);
     tests.register_read_test(test_read_c_ptr_dyn);
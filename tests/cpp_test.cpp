@@ -1,10 +1,18 @@
 #include "cpp_test.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
 #include <optional>
 #include <sstream>
+#include <thread>
 
 #include "csvpp/csv.hpp"
-
+#include "csvpp/parallel.hpp"
 std::optional<std::vector<std::vector<int>>> convert_to_int(const CSV_data & expected_data)
 {
     std::vector<std::vector<int>> expected_ints;
@@ -50,6 +58,260 @@ test::Result test_read_cpp_read_all(const std::string & csv_text, const CSV_data
     }
 }
 
+test::Result test_read_cpp_istream_small_buffer(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    try
+    {
+        std::istringstream input{csv_text};
+        csv::Reader r(input, delimiter, quote, lenient);
+        r.set_buffer_size(3); // force many refills, including within fields
+
+        return CSV_test_suite::common_read_return(csv_text, expected_data, r.read_all());
+    }
+    catch(const csv::Parse_error & e)
+    {
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+}
+
+test::Result test_read_cpp_file(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    auto filename = (std::filesystem::temp_directory_path() / "csvpp_test_read.csv").string();
+    {
+        std::ofstream out{filename, std::ios::binary};
+        out<<csv_text;
+    }
+
+    try
+    {
+        auto data = csv::Reader(filename, delimiter, quote, lenient).read_all();
+        std::filesystem::remove(filename);
+
+        return CSV_test_suite::common_read_return(csv_text, expected_data, data);
+    }
+    catch(const csv::Parse_error & e)
+    {
+        std::filesystem::remove(filename);
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+}
+
+test::Result test_read_cpp_seek(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    auto filename = (std::filesystem::temp_directory_path() / "csvpp_test_seek.csv").string();
+    auto sidecar_filename = filename + ".idx";
+    {
+        std::ofstream out{filename, std::ios::binary};
+        out<<csv_text;
+    }
+
+    auto cleanup = [&]()
+    {
+        std::filesystem::remove(filename);
+        std::filesystem::remove(sidecar_filename);
+    };
+
+    try
+    {
+        csv::Row_index::open(filename, sidecar_filename, 2, delimiter, quote, lenient);
+        auto index = csv::Row_index::load(sidecar_filename, filename);
+        if(!index)
+        {
+            cleanup();
+            return test::fail([](){ std::cout<<"could not load row index\n"; });
+        }
+
+        // seek backwards from past the end, to check checkpoints, and re-reading rows.
+        // Only some rows are checked for large inputs
+        csv::Reader r(filename, delimiter, quote, lenient);
+        auto step = std::max(std::size_t{1}, std::size(expected_data) / 16);
+        auto row = std::size(expected_data) + 1;
+        do
+        {
+            row -= std::min(row, step);
+            bool found = r.seek_to_row(*index, row);
+            auto data = r.read_all();
+
+            CSV_data expected_rest(std::begin(expected_data) + std::min(row, std::size(expected_data)), std::end(expected_data));
+            if(found != (row < std::size(expected_data)) || data != expected_rest)
+            {
+                cleanup();
+                return CSV_test_suite::common_read_return(csv_text, expected_rest, data);
+            }
+        } while(row > 0);
+
+        cleanup();
+        return test::pass();
+    }
+    catch(const csv::Parse_error & e)
+    {
+        cleanup();
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+}
+
+#ifdef CSVPP_HAS_URING
+// Read files in small blocks through Uring_file_source, for the duration of a test
+struct Uring_settings_guard
+{
+    Uring_settings_guard(const std::string & csv_text, unsigned depth, bool use_ring): saved{csv::detail::uring_settings}
+    {
+        // at least 32 blocks, so each buffer is reused several times
+        csv::detail::uring_settings = {std::max(std::size_t{7}, std::size(csv_text) / 32), depth, use_ring};
+    }
+    ~Uring_settings_guard() { csv::detail::uring_settings = saved; }
+
+    csv::detail::Uring_settings saved;
+};
+
+test::Result test_read_cpp_uring_blocks(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    Uring_settings_guard guard{csv_text, 3, true};
+    return test_read_cpp_file(csv_text, expected_data, delimiter, quote, lenient);
+}
+
+test::Result test_read_cpp_uring_seek(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    // seeking cancels the reads in flight, and restarts the ring
+    Uring_settings_guard guard{csv_text, 2, true};
+    return test_read_cpp_seek(csv_text, expected_data, delimiter, quote, lenient);
+}
+
+test::Result test_read_cpp_uring_pread(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    Uring_settings_guard guard{csv_text, 3, false};
+    return test_read_cpp_seek(csv_text, expected_data, delimiter, quote, lenient);
+}
+#endif
+
+test::Result test_read_cpp_seek_sidecar_mismatch(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    auto filename = (std::filesystem::temp_directory_path() / "csvpp_test_seek_mismatch.csv").string();
+    auto sidecar_filename = filename + ".idx";
+    {
+        std::ofstream out{filename, std::ios::binary};
+        out<<csv_text;
+    }
+
+    auto cleanup = [&]()
+    {
+        std::filesystem::remove(filename);
+        std::filesystem::remove(sidecar_filename);
+    };
+
+    try
+    {
+        // a sidecar built with another quote character has different row boundaries, and must be rebuilt
+        try
+        {
+            csv::Row_index::open(filename, sidecar_filename, 2, delimiter, quote == '"' ? '\'' : '"', true);
+        }
+        catch(const csv::Parse_error &) {}
+
+        auto index = csv::Row_index::open(filename, sidecar_filename, 2, delimiter, quote, lenient);
+        if(index.quote() != quote || index.lenient() != lenient)
+        {
+            cleanup();
+            return test::fail([](){ std::cout<<"stale row index not rebuilt\n"; });
+        }
+
+        // corrupt the row and checkpoint counts. Sidecar layout is:
+        // magic[8], size, time, interval, delimiter[1], quote[1], lenient[1], rows, checkpoint count, checkpoints
+        {
+            std::fstream sidecar{sidecar_filename, std::ios::binary | std::ios::in | std::ios::out};
+            std::uint64_t interval = 1, huge = std::uint64_t{1} << 60;
+            sidecar.seekp(24);
+            sidecar.write(reinterpret_cast<const char *>(&interval), sizeof(interval));
+            sidecar.seekp(35);
+            sidecar.write(reinterpret_cast<const char *>(&huge), sizeof(huge));
+            sidecar.write(reinterpret_cast<const char *>(&huge), sizeof(huge));
+        }
+        if(csv::Row_index::load(sidecar_filename, filename))
+        {
+            cleanup();
+            return test::fail([](){ std::cout<<"corrupt row index loaded\n"; });
+        }
+        index = csv::Row_index::open(filename, sidecar_filename, 2, delimiter, quote, lenient);
+
+        // seek through the rebuilt index. Only some rows are checked for large inputs
+        csv::Reader r(filename, delimiter, quote, lenient);
+        auto step = std::max(std::size_t{1}, std::size(expected_data) / 16);
+        for(std::size_t row = 0; row < std::size(expected_data); row += step)
+        {
+            bool found = r.seek_to_row(index, row);
+            auto data = r.read_all();
+
+            CSV_data expected_rest(std::begin(expected_data) + static_cast<std::ptrdiff_t>(row), std::end(expected_data));
+            if(!found || data != expected_rest)
+            {
+                cleanup();
+                return CSV_test_suite::common_read_return(csv_text, expected_rest, data);
+            }
+        }
+
+        cleanup();
+        return test::pass_fail(index.rows() == std::size(expected_data));
+    }
+    catch(const csv::Parse_error & e)
+    {
+        cleanup();
+        return test::error();
+    }
+}
+
+test::Result test_read_cpp_shards(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    // shard boundaries are not guaranteed for quotes in unquoted fields, which lenient mode allows
+    if(lenient)
+        return test::skip();
+
+    auto filename = (std::filesystem::temp_directory_path() / "csvpp_test_shards.csv").string();
+    {
+        std::ofstream out{filename, std::ios::binary};
+        out<<csv_text;
+    }
+
+    auto read_shards = [&](const std::vector<csv::Shard> & shards)
+    {
+        CSV_data data;
+        for(auto & shard: shards)
+        {
+            csv::Reader r(filename, shard, delimiter, quote, lenient);
+            for(auto & row: r.read_all())
+                data.push_back(row);
+        }
+        return data;
+    };
+
+    try
+    {
+        // many small shards, including empty ones
+        auto data = read_shards(csv::plan_shards(filename, 7, quote));
+        if(data == expected_data)
+        {
+            // split into byte ranges, as independent processes would.
+            // Short inputs are split every 3 bytes, to land inside of every row and field
+            std::uint64_t step = std::max(std::size(csv_text) / 16, std::size_t{3});
+            std::vector<csv::Shard> shards;
+            for(std::uint64_t begin = 0; begin < std::size(csv_text); begin += step)
+                shards.push_back(csv::resolve_shard(filename, begin, begin + step, quote));
+            data = read_shards(shards);
+        }
+
+        std::filesystem::remove(filename);
+        return CSV_test_suite::common_read_return(csv_text, expected_data, data);
+    }
+    catch(const csv::Parse_error & e)
+    {
+        std::filesystem::remove(filename);
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+}
+
 test::Result test_read_cpp_read_row_vec(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
 {
     try
@@ -234,25 +496,23 @@ test::Result test_read_cpp_range(const std::string & csv_text, const CSV_data &
     }
 }
 
-test::Result test_read_cpp_row_fields(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+test::Result test_read_cpp_range_view(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
 {
     try
     {
-        csv::Reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
-
+        std::istringstream input{csv_text};
+        csv::Reader r(input, delimiter, quote, lenient);
+        r.set_buffer_size(3); // force rows to span refills
         CSV_data data;
-        while(r)
-        {
-            auto row = r.get_row();
-            if(!row)
-                break;
-
-            std::vector<std::string> row_v;
 
-            while(!row.end_of_row())
-                row_v.push_back(row.read_field());
+        for(auto & row: r)
+        {
+            // views must remain valid until the next row, so only copy them after reading the whole row
+            std::vector<std::string_view> row_v;
+            for(auto & field: row.range<std::string_view>())
+                row_v.push_back(field);
 
-            data.emplace_back(std::move(row_v));
+            data.emplace_back(std::begin(row_v), std::end(row_v));
         }
 
         return CSV_test_suite::common_read_return(csv_text, expected_data, data);
@@ -264,26 +524,17 @@ test::Result test_read_cpp_row_fields(const std::string & csv_text, const CSV_da
     }
 }
 
-test::Result test_read_cpp_row_stream(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+test::Result test_read_cpp_row_view(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
 {
     try
     {
-        csv::Reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
+        std::istringstream input{csv_text};
+        csv::Reader r(input, delimiter, quote, lenient);
+        r.set_buffer_size(3); // force rows to span refills
 
         CSV_data data;
-        while(r)
-        {
-            auto row = r.get_row();
-            if(!row)
-                break;
-            std::vector<std::string> row_v;
-
-            std::string field;
-            while(row>>field)
-                row_v.emplace_back(std::move(field));
-
-            data.emplace_back(std::move(row_v));
-        }
+        while(auto row = r.read_row_view())
+            data.emplace_back(std::begin(*row), std::end(*row));
 
         return CSV_test_suite::common_read_return(csv_text, expected_data, data);
     }
@@ -294,101 +545,917 @@ test::Result test_read_cpp_row_stream(const std::string & csv_text, const CSV_da
     }
 }
 
-test::Result test_read_cpp_row_vec(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+test::Result test_read_cpp_try_read_row_view(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
 {
-    try
-    {
-        csv::Reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
-        CSV_data data;
-        for(auto & row: r)
-            data.emplace_back(row.read_vec());
+    std::istringstream input{csv_text};
+    csv::Reader r(input, delimiter, quote, lenient);
+    r.set_buffer_size(3); // force rows to span refills
 
-        return CSV_test_suite::common_read_return(csv_text, expected_data, data);
+    CSV_data data;
+    while(true)
+    {
+        auto row = r.try_read_row_view();
+        if(!row)
+        {
+            // should report the same error as read_row_view
+            try
+            {
+                csv::Reader(csv::Reader::input_string, csv_text, delimiter, quote, lenient).read_all();
+                return test::fail();
+            }
+            catch(const csv::Parse_error & e)
+            {
+                if(row.error().kind() != csv::Error_kind::parse || row.error().message() != e.what())
+                    return test::fail();
+                return test::error();
+            }
+        }
+        if(!*row)
+            break;
+        data.emplace_back(std::begin(**row), std::end(**row));
     }
-    catch(const csv::Parse_error & e)
+
+    return CSV_test_suite::common_read_return(csv_text, expected_data, data);
+}
+
+test::Result test_read_cpp_try_read_field_as_int(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    auto expected_ints = convert_to_int(expected_data);
+    csv::Reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
+
+    std::vector<std::vector<int>> data;
+    std::vector<int> row;
+    while(true)
     {
-        // std::cerr<<e.what()<<"\n";
-        return test::error();
+        auto field = r.try_read_field<int>();
+        if(!field)
+        {
+            if(field.error().kind() == csv::Error_kind::parse)
+                return test::error();
+
+            // non-integer data should fail to convert, and nothing else should
+            if(expected_ints || field.error().kind() != csv::Error_kind::type_conversion)
+                return test::fail();
+            return test::skip();
+        }
+
+        // read past the last row
+        if(r.eof())
+            break;
+
+        row.push_back(*field);
+        if(r.end_of_row())
+        {
+            data.push_back(std::move(row));
+            row.clear();
+        }
     }
+
+    if(!expected_ints)
+        return test::skip();
+
+    return test::pass_fail(data == *expected_ints, [csv_text]()
+    {
+        std::cout << "given:    "; CSV_test_suite::print_escapes(csv_text); std::cout << "\n\n";
+    });
 }
 
-test::Result test_read_cpp_row_vec_as_int(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+// converts with std::stoi, which throws on invalid input
+struct Stoi_int
+{
+    int value {0};
+    bool operator==(int i) const { return value == i; }
+};
+std::istream & operator>>(std::istream & in, Stoi_int & i)
+{
+    std::string field;
+    std::getline(in, field);
+    i.value = std::stoi(field);
+    return in;
+}
+
+test::Result test_read_cpp_try_read_field_throwing_conversion(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
 {
     auto expected_ints = convert_to_int(expected_data);
+    csv::Reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
+
+    std::vector<std::vector<int>> data;
+    std::vector<int> row;
+    while(true)
+    {
+        auto field = r.try_read_field<Stoi_int>();
+        if(!field)
+        {
+            if(field.error().kind() == csv::Error_kind::parse)
+                return test::error();
+
+            // std::stoi's exception should be returned, not thrown
+            if(expected_ints || field.error().kind() != csv::Error_kind::other)
+                return test::fail();
+            try
+            {
+                field.error().raise();
+            }
+            catch(const std::logic_error & e)
+            {
+                if(field.error().message() != e.what())
+                    return test::fail();
+                return test::skip();
+            }
+            catch(...)
+            {
+                return test::fail();
+            }
+        }
+
+        // read past the last row
+        if(r.eof())
+            break;
+
+        row.push_back(field->value);
+        if(r.end_of_row())
+        {
+            data.push_back(std::move(row));
+            row.clear();
+        }
+    }
+
     if(!expected_ints)
         return test::skip();
 
-    try
+    return test::pass_fail(data == *expected_ints, [csv_text]()
     {
-        csv::Reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
-        std::vector<std::vector<int>> data;
-        for(auto & row: r)
-            data.emplace_back(row.read_vec<int>());
+        std::cout << "given:    "; CSV_test_suite::print_escapes(csv_text); std::cout << "\n\n";
+    });
+}
 
-        auto failure_fun = [csv_text, data, expected_data]()
+test::Result test_read_cpp_try_read_row_view_throwing_filter(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    if(!std::empty(expected_data) && std::empty(expected_data.front()))
+        return test::skip();
+
+    // throws on the 1st row only
+    csv::Reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
+    r.set_filter(0, [calls = 0](std::string_view) mutable
+    {
+        if(calls++ == 0)
+            throw std::runtime_error("filter failed");
+        return true;
+    });
+
+    CSV_data data;
+    auto first = true;
+    while(true)
+    {
+        auto row = r.try_read_row_view();
+        if(!row)
         {
-            CSV_data str_data;
-            for(auto & row: data)
+            if(row.error().kind() == csv::Error_kind::parse)
+                return test::error();
+
+            // the filter's exception should be returned, not thrown
+            if(!first || row.error().kind() != csv::Error_kind::other || row.error().message() != "filter failed")
+                return test::fail();
+            try
             {
-                str_data.emplace_back();
-                for(auto & col: row)
-                {
-                    str_data.back().push_back(std::to_string(col));
-                }
+                std::rethrow_exception(row.error().exception());
             }
-            std::cout << "given:    "; CSV_test_suite::print_escapes(csv_text);   std::cout << '\n';
-            std::cout << "expected: "; CSV_test_suite::print_data(expected_data); std::cout << '\n';
-            std::cout << "got:      "; CSV_test_suite::print_data(str_data);      std::cout << "\n\n";
-        };
-        return test::pass_fail(data == *expected_ints, failure_fun);
+            catch(const std::runtime_error &)
+            {
+            }
+            catch(...)
+            {
+                return test::fail();
+            }
+            first = false;
+            continue;
+        }
+        if(!*row)
+            break;
+        data.emplace_back(std::begin(**row), std::end(**row));
+    }
+
+    if(first && !std::empty(expected_data))
+        return test::fail();
+
+    // reading resumes after the 1st field
+    auto expected_rest = expected_data;
+    if(!std::empty(expected_rest))
+    {
+        expected_rest.front().erase(std::begin(expected_rest.front()));
+        if(std::empty(expected_rest.front()))
+            expected_rest.erase(std::begin(expected_rest));
+    }
+
+    return CSV_test_suite::common_read_return(csv_text, expected_rest, data);
+}
+
+test::Result test_read_cpp_parallel(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    try
+    {
+        csv::Parallel_reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
+        r.set_threads(4);
+        r.set_chunk_size(5); // many chunk boundaries, including inside of quoted fields
+
+        CSV_data data;
+        r.for_each_row([&data](const csv::Reader::Row_view & row)
+        {
+            data.emplace_back(std::begin(row), std::end(row));
+        });
+
+        return CSV_test_suite::common_read_return(csv_text, expected_data, data);
+    }
+    catch(const csv::Parse_error & e)
+    {
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+}
+
+#ifdef CSVPP_USE_ZLIB
+test::Result test_read_cpp_parallel_gzip(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    auto filename = (std::filesystem::temp_directory_path() / "csvpp_test_parallel_gzip.csv.gz").string();
+    {
+        std::ofstream out{filename, std::ios::binary};
+        out<<CSV_test_suite::gzip(csv_text);
+    }
+
+    try
+    {
+        // members are decompressed in parallel, and rows are split across members
+        csv::Parallel_reader r(filename, delimiter, quote, lenient);
+        r.set_threads(4);
+        r.set_chunk_size(5);
+
+        CSV_data data;
+        r.for_each_row([&data](const csv::Reader::Row_view & row)
+        {
+            data.emplace_back(std::begin(row), std::end(row));
+        });
+
+        std::filesystem::remove(filename);
+        return CSV_test_suite::common_read_return(csv_text, expected_data, data);
+    }
+    catch(const csv::Parse_error & e)
+    {
+        std::filesystem::remove(filename);
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+}
+#endif
+
+test::Result test_read_cpp_parallel_unordered(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    try
+    {
+        csv::Parallel_reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
+        r.set_threads(4);
+        r.set_chunk_size(5);
+
+        CSV_data data;
+        std::mutex data_mutex;
+        r.for_each_row([&data, &data_mutex](const csv::Reader::Row_view & row)
+        {
+            std::lock_guard lock{data_mutex};
+            data.emplace_back(std::begin(row), std::end(row));
+        }, csv::Parallel_reader::Order::any);
+
+        // rows may arrive in any order
+        auto sorted_expected = expected_data;
+        std::sort(std::begin(data), std::end(data));
+        std::sort(std::begin(sorted_expected), std::end(sorted_expected));
+
+        return CSV_test_suite::common_read_return(csv_text, sorted_expected, data);
+    }
+    catch(const csv::Parse_error & e)
+    {
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+}
+
+test::Result test_read_cpp_read_ahead(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    try
+    {
+        std::istringstream input{csv_text};
+        csv::Read_ahead_reader r(input, delimiter, quote, lenient);
+        r.set_read_ahead(2, 5); // many handoffs between threads, and a full ring
+        r.set_buffer_size(3);
+
+        auto data = r.read_all();
+
+        return CSV_test_suite::common_read_return(csv_text, expected_data, data);
+    }
+    catch(const csv::Parse_error & e)
+    {
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+}
+
+#ifdef CSVPP_USE_ZLIB
+test::Result test_read_cpp_gzip(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    auto compressed = CSV_test_suite::gzip(csv_text);
+    auto filename = (std::filesystem::temp_directory_path() / "csvpp_test_gzip.csv.gz").string();
+    {
+        std::ofstream out{filename, std::ios::binary};
+        out<<compressed;
+    }
+
+    try
+    {
+        // detected from the file, decompressed from memory
+        auto data = csv::Reader{filename, delimiter, quote, lenient}.read_all();
+        std::filesystem::remove(filename);
+        if(data == expected_data)
+        {
+            // decompressed in small reads, from a stream
+            std::istringstream input{compressed};
+            csv::Reader r{input, csv::Compression::gzip, delimiter, quote, lenient};
+            r.set_buffer_size(3);
+            data = r.read_all();
+        }
+
+        return CSV_test_suite::common_read_return(csv_text, expected_data, data);
+    }
+    catch(const csv::Parse_error & e)
+    {
+        std::filesystem::remove(filename);
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+}
+#endif
+
+test::Result test_read_cpp_read_row_into(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    try
+    {
+        csv::Reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
+        CSV_data data;
+
+        // reused for every row
+        std::vector<std::string> row;
+        while(r.read_row_into(row))
+            data.push_back(row);
+
+        return CSV_test_suite::common_read_return(csv_text, expected_data, data);
+    }
+    catch(const csv::Parse_error & e)
+    {
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+}
+
+test::Result test_read_cpp_read_columns(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    try
+    {
+        // read_columns drops extra fields and fills in missing ones, so check the number of fields separately
+        auto parsed_data = csv::Reader{csv::Reader::input_string, csv_text, delimiter, quote, lenient}.read_all();
+        if(std::size(parsed_data) != std::size(expected_data))
+            return test::fail();
+        for(std::size_t i = 0; i < std::size(parsed_data); ++i)
+        {
+            if(std::size(parsed_data[i]) != std::size(expected_data[i]))
+                return test::fail();
+        }
+
+        auto [col0, col1, col2] = csv::Reader(csv::Reader::input_string, csv_text, delimiter, quote, lenient).read_columns<std::string, std::string, std::string>();
+
+        if(std::size(col1) != std::size(col0) || std::size(col2) != std::size(col0))
+            return test::fail();
+
+        CSV_data data;
+        for(std::size_t i = 0; i < std::size(col0); ++i)
+            data.push_back({col0[i], col1[i], col2[i]});
+
+        CSV_data expected_columns;
+        for(auto & row: expected_data)
+        {
+            auto & expected_row = expected_columns.emplace_back(std::begin(row), std::begin(row) + std::min(std::size(row), std::size_t{3}));
+            expected_row.resize(3);
+        }
+
+        return CSV_test_suite::common_read_return(csv_text, expected_columns, data);
+    }
+    catch(const csv::Parse_error & e)
+    {
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+}
+
+test::Result test_read_cpp_typed(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    for(auto & row: expected_data)
+    {
+        if(std::size(row) != 3)
+            return test::skip();
+    }
+
+    try
+    {
+        // Typed_reader ignores extra fields, so check the number of fields separately
+        auto parsed_data = csv::Reader{csv::Reader::input_string, csv_text, delimiter, quote, lenient}.read_all();
+        for(auto & row: parsed_data)
+        {
+            if(std::size(row) != 3)
+                return test::fail();
+        }
+
+        csv::Reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
+        // read out of order to check column placement
+        csv::Typed_reader<csv::Column<std::string, 2>, csv::Column<std::string, 0>, std::string> typed{r};
+
+        CSV_data data;
+        while(auto row = typed.read_row())
+            data.push_back({std::get<1>(*row), std::get<2>(*row), std::get<0>(*row)});
+
+        return CSV_test_suite::common_read_return(csv_text, expected_data, data);
+    }
+    catch(const csv::Parse_error & e)
+    {
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+}
+
+// Select columns from each row the way Reader::set_projection does
+CSV_data project(const CSV_data & data, const std::vector<std::size_t> & columns)
+{
+    CSV_data projected;
+    for(auto & row: data)
+    {
+        auto size = std::size(columns);
+        while(size > 1 && columns[size - 1] >= std::size(row))
+            --size;
+
+        auto & projected_row = projected.emplace_back();
+        for(std::size_t i = 0; i < size; ++i)
+            projected_row.push_back(columns[i] < std::size(row) ? row[columns[i]] : "");
+    }
+    return projected;
+}
+
+// Check that the CSV has the expected number of fields in each row. Needed
+// when the method being tested does not return every field
+bool same_field_counts(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    auto parsed_data = csv::Reader{csv::Reader::input_string, csv_text, delimiter, quote, lenient}.read_all();
+    if(std::size(parsed_data) != std::size(expected_data))
+        return false;
+    for(std::size_t i = 0; i < std::size(parsed_data); ++i)
+    {
+        if(std::size(parsed_data[i]) != std::size(expected_data[i]))
+            return false;
+    }
+    return true;
+}
+
+test::Result common_read_projection(csv::Reader & r, const std::vector<std::size_t> & columns,
+        const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    try
+    {
+        r.set_projection(columns);
+        auto data = r.read_all();
+
+        // projection hides the number of fields, so check it separately
+        if(!same_field_counts(csv_text, expected_data, delimiter, quote, lenient))
+            return test::fail();
+
+        return CSV_test_suite::common_read_return(csv_text, project(expected_data, columns), data);
+    }
+    catch(const csv::Parse_error & e)
+    {
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+}
+
+test::Result test_read_cpp_projection(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    csv::Reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
+    return common_read_projection(r, {2, 0}, csv_text, expected_data, delimiter, quote, lenient);
+}
+
+test::Result test_read_cpp_projection_stream(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    std::istringstream input{csv_text};
+    csv::Reader r(input, delimiter, quote, lenient);
+    r.set_buffer_size(3);
+    return common_read_projection(r, {1, 3}, csv_text, expected_data, delimiter, quote, lenient);
+}
+
+test::Result test_read_cpp_projection_by_header(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    try
+    {
+        if(std::empty(expected_data))
+        {
+            // no header row to select from
+            csv::Reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
+            r.set_projection_by_header({});
+            return test::fail([](){ std::cout<<"missing header row accepted\n"; });
+        }
+        if(std::empty(expected_data[0]))
+            return test::skip();
+
+        // select the last and first columns, out of order
+        auto & header_row = expected_data[0];
+        std::vector<std::string> headers{header_row.back(), header_row.front()};
+        std::vector<std::size_t> columns;
+        for(auto & header: headers)
+            columns.push_back(static_cast<std::size_t>(std::find(std::begin(header_row), std::end(header_row), header) - std::begin(header_row)));
+
+        csv::Reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
+        r.set_projection_by_header(headers);
+        auto data = r.read_all();
+
+        // projection hides the number of fields, so check it separately
+        if(!same_field_counts(csv_text, expected_data, delimiter, quote, lenient))
+            return test::fail();
+
+        // headers not in the header row are rejected
+        try
+        {
+            csv::Reader r2(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
+            r2.set_projection_by_header({header_row.front(), "<NO SUCH HEADER>"});
+            return test::fail([](){ std::cout<<"unknown header accepted\n"; });
+        }
+        catch(const csv::Out_of_range_error &) {}
+
+        return CSV_test_suite::common_read_return(csv_text, project(CSV_data(std::next(std::begin(expected_data)), std::end(expected_data)), columns), data);
+    }
+    catch(const csv::Parse_error & e)
+    {
+        if(e.what() == std::string{"Error parsing CSV at line: 0, col: 0: Can't get header row"} && std::size(expected_data) == 0)
+            return test::pass();
+
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+    catch(const csv::Out_of_range_error &)
+    {
+        // the expected headers are not the ones in the input
+        return test::fail();
+    }
+}
+
+test::Result test_read_cpp_filter(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    try
+    {
+        // keep rows with an even length 2nd field
+        auto keep = [](std::string_view field) { return std::size(field) % 2 == 0; };
+
+        csv::Reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
+        r.set_filter(1, keep);
+
+        CSV_data data;
+        for(auto & row: r)
+        {
+            auto & row_v = data.emplace_back();
+            for(auto & field: row)
+                row_v.push_back(field);
+        }
+
+        // filtering may hide rows with the wrong number of fields, so check separately
+        if(!same_field_counts(csv_text, expected_data, delimiter, quote, lenient))
+            return test::fail();
+
+        CSV_data expected_filtered;
+        for(auto & row: expected_data)
+        {
+            if(keep(std::size(row) > 1 ? row[1] : ""))
+                expected_filtered.push_back(row);
+        }
+
+        return CSV_test_suite::common_read_return(csv_text, expected_filtered, data);
+    }
+    catch(const csv::Parse_error & e)
+    {
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+}
+
+test::Result test_read_cpp_row_fields(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    try
+    {
+        csv::Reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
+
+        CSV_data data;
+        while(r)
+        {
+            auto row = r.get_row();
+            if(!row)
+                break;
+
+            std::vector<std::string> row_v;
+
+            while(!row.end_of_row())
+                row_v.push_back(row.read_field());
+
+            data.emplace_back(std::move(row_v));
+        }
+
+        return CSV_test_suite::common_read_return(csv_text, expected_data, data);
+    }
+    catch(const csv::Parse_error & e)
+    {
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+}
+
+test::Result test_read_cpp_row_stream(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    try
+    {
+        csv::Reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
+
+        CSV_data data;
+        while(r)
+        {
+            auto row = r.get_row();
+            if(!row)
+                break;
+            std::vector<std::string> row_v;
+
+            std::string field;
+            while(row>>field)
+                row_v.emplace_back(std::move(field));
+
+            data.emplace_back(std::move(row_v));
+        }
+
+        return CSV_test_suite::common_read_return(csv_text, expected_data, data);
+    }
+    catch(const csv::Parse_error & e)
+    {
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+}
+
+test::Result test_read_cpp_row_vec(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    try
+    {
+        csv::Reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
+        CSV_data data;
+        for(auto & row: r)
+            data.emplace_back(row.read_vec());
+
+        return CSV_test_suite::common_read_return(csv_text, expected_data, data);
+    }
+    catch(const csv::Parse_error & e)
+    {
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+}
+
+test::Result test_read_cpp_row_vec_as_int(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    auto expected_ints = convert_to_int(expected_data);
+    if(!expected_ints)
+        return test::skip();
+
+    try
+    {
+        csv::Reader r(csv::Reader::input_string, csv_text, delimiter, quote, lenient);
+        std::vector<std::vector<int>> data;
+        for(auto & row: r)
+            data.emplace_back(row.read_vec<int>());
+
+        auto failure_fun = [csv_text, data, expected_data]()
+        {
+            CSV_data str_data;
+            for(auto & row: data)
+            {
+                str_data.emplace_back();
+                for(auto & col: row)
+                {
+                    str_data.back().push_back(std::to_string(col));
+                }
+            }
+            std::cout << "given:    "; CSV_test_suite::print_escapes(csv_text);   std::cout << '\n';
+            std::cout << "expected: "; CSV_test_suite::print_data(expected_data); std::cout << '\n';
+            std::cout << "got:      "; CSV_test_suite::print_data(str_data);      std::cout << "\n\n";
+        };
+        return test::pass_fail(data == *expected_ints, failure_fun);
+    }
+    catch(const csv::Parse_error & e)
+    {
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
+    }
+}
+
+test::Result test_read_cpp_map(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    try
+    {
+        csv::Map_reader_iter r{csv::Reader::input_string, csv_text, std::string{"<DEFAULT VALUE>"}, {}, delimiter, quote, lenient};
+
+        auto & headers = expected_data.at(0);
+        if(r.get_headers() != headers)
+            return test::fail([csv_text, headers, got_headers = r.get_headers()]()
+                    {
+                        std::cout<<"could not read headers:\n";
+
+                        std::cout << "given:    "; CSV_test_suite::print_escapes(csv_text);   std::cout << '\n';
+                        std::cout << "expected: "; CSV_test_suite::print_data({headers});     std::cout << '\n';
+                        std::cout << "got:      "; CSV_test_suite::print_data({got_headers}); std::cout << "\n\n";
+                    });
+
+        std::size_t i = 1;
+        for(; r != csv::Map_reader_iter{} && i < std::size(expected_data); ++r, ++i)
+        {
+            if(std::size(expected_data[i]) != std::size(headers))
+                return test::skip();
+
+            std::remove_reference_t<decltype(*r)> expected_row;
+            for(std::size_t j = 0; j < std::size(headers); ++j)
+                expected_row.emplace(headers[j], expected_data[i][j]);
+
+            // look up by header before the map is built
+            for(std::size_t j = 0; j < std::size(headers); ++j)
+            {
+                if(r[headers[j]] != expected_row.at(headers[j]))
+                    return test::fail([](){ std::cout<<"field lookup mismatch\n"; });
+            }
+
+            if(*r != expected_row)
+            {
+                return test::fail([csv_text, headers, expected_row = expected_data[i], r = *r]
+                        {
+                            std::cout<<"row mismatch:\n";
+                            std::vector<std::string> row_v;
+
+                            for(auto & h: headers)
+                                row_v.emplace_back(std::move(r.at(h)));
+
+                            std::cout << "given:    "; CSV_test_suite::print_escapes(csv_text);    std::cout << '\n';
+                            std::cout << "expected: "; CSV_test_suite::print_data({expected_row}); std::cout << '\n';
+                            std::cout << "got:      "; CSV_test_suite::print_data({row_v});        std::cout << "\n\n";
+                        });
+            }
+        }
+        if(i != std::size(expected_data) || r != csv::Map_reader_iter{})
+            return test::fail([](){ std::cout<<"wrong # of rows\n"; });
+
+        return test::pass();
+    }
+    catch(const csv::Parse_error & e)
+    {
+        if(e.what() == std::string{"Error parsing CSV at line: 0, col: 0: Can't get header row"} && std::size(expected_data) == 0)
+            return test::pass();
+        else
+        {
+            // std::cerr<<e.what()<<"\n";
+            return test::error();
+        }
+    }
+    catch(csv::Out_of_range_error & e)
+    {
+        if(e.what() == std::string{"Too many fields"})
+            return test::skip([](){ std::cout<<"wrong # of cols\n"; });
+        else
+            throw;
+    }
+}
+
+test::Result test_read_cpp_map_too_many_fields(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+{
+    try
+    {
+        const std::string default_val{"<DEFAULT VALUE>"};
+        csv::Map_reader_iter r{csv::Reader::input_string, csv_text, default_val, {}, delimiter, quote, lenient};
+
+        auto headers = r.get_headers();
+        CSV_data data{headers};
+        while(r != csv::Map_reader_iter{})
+        {
+            data.push_back(r.get_values());
+            auto row = *r;
+
+            // rows with too many fields are skipped over, and should leave the current row intact
+            while(true)
+            {
+                try
+                {
+                    ++r;
+                    break;
+                }
+                catch(const csv::Out_of_range_error &)
+                {
+                    if(r.get_values() != data.back() || *r != row || r[headers.back()] != data.back().back())
+                        return test::fail([](){ std::cout<<"row changed by failed increment\n"; });
+                }
+            }
+        }
+
+        CSV_data expected_rows;
+        for(auto & row: expected_data)
+        {
+            if(std::empty(expected_rows))
+                expected_rows.push_back(row);
+            else if(std::size(row) <= std::size(headers))
+            {
+                expected_rows.push_back(row);
+                expected_rows.back().resize(std::size(headers), default_val);
+            }
+        }
+
+        return CSV_test_suite::common_read_return(csv_text, expected_rows, data);
     }
     catch(const csv::Parse_error & e)
     {
-        // std::cerr<<e.what()<<"\n";
-        return test::error();
+        if(e.what() == std::string{"Error parsing CSV at line: 0, col: 0: Can't get header row"} && std::size(expected_data) == 0)
+            return test::pass();
+        else
+            return test::error();
+    }
+    catch(const csv::Out_of_range_error &)
+    {
+        // thrown from the constructor, when the 1st row has too many fields
+        return test::skip();
     }
 }
 
-test::Result test_read_cpp_map(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
+test::Result test_read_cpp_map_columns(const std::string & csv_text, const CSV_data & expected_data, const char delimiter, const char quote, const bool lenient)
 {
+    if(std::empty(expected_data) || std::empty(expected_data[0]))
+        return test::skip();
+
+    // repeated headers can't be told apart in a map
+    auto headers = expected_data[0];
+    std::sort(std::begin(headers), std::end(headers));
+    if(std::adjacent_find(std::begin(headers), std::end(headers)) != std::end(headers))
+        return test::skip();
+
     try
     {
-        csv::Map_reader_iter r{csv::Reader::input_string, csv_text, std::string{"<DEFAULT VALUE>"}, {}, delimiter, quote, lenient};
+        // select the last and first columns, out of order
+        auto & header_row = expected_data[0];
+        auto columns = std::size(header_row) > 1 ? std::vector<std::string>{header_row.back(), header_row.front()} : header_row;
 
-        auto & headers = expected_data.at(0);
-        if(r.get_headers() != headers)
-            return test::fail([csv_text, headers, got_headers = r.get_headers()]()
-                    {
-                        std::cout<<"could not read headers:\n";
+        // headers not in the header row are rejected
+        try
+        {
+            csv::Map_reader_iter r2{csv::Reader::input_string, csv_text, std::string{}, {}, delimiter, quote, lenient, {header_row.front(), "<NO SUCH HEADER>"}};
+            return test::fail([](){ std::cout<<"unknown header accepted\n"; });
+        }
+        catch(const csv::Out_of_range_error & e)
+        {
+            if(e.what() != std::string{"Header not found"})
+                return test::fail();
+        }
 
-                        std::cout << "given:    "; CSV_test_suite::print_escapes(csv_text);   std::cout << '\n';
-                        std::cout << "expected: "; CSV_test_suite::print_data({headers});     std::cout << '\n';
-                        std::cout << "got:      "; CSV_test_suite::print_data({got_headers}); std::cout << "\n\n";
-                    });
+        csv::Map_reader_iter r{csv::Reader::input_string, csv_text, std::string{"<DEFAULT VALUE>"}, {}, delimiter, quote, lenient, columns};
+        if(r.get_headers() != columns)
+            return test::fail([](){ std::cout<<"headers not replaced by columns\n"; });
+
+        // projection hides the number of fields, so check it separately
+        if(!same_field_counts(csv_text, expected_data, delimiter, quote, lenient))
+            return test::fail();
 
         std::size_t i = 1;
         for(; r != csv::Map_reader_iter{} && i < std::size(expected_data); ++r, ++i)
         {
-            if(std::size(expected_data[i]) != std::size(headers))
+            if(std::size(expected_data[i]) != std::size(header_row))
                 return test::skip();
 
             std::remove_reference_t<decltype(*r)> expected_row;
-            for(std::size_t j = 0; j < std::size(headers); ++j)
-                expected_row.emplace(headers[j], expected_data[i][j]);
+            for(auto & column: columns)
+                expected_row.emplace(column, expected_data[i][static_cast<std::size_t>(std::find(std::begin(header_row), std::end(header_row), column) - std::begin(header_row))]);
 
             if(*r != expected_row)
             {
-                return test::fail([csv_text, headers, expected_row = expected_data[i], r = *r]
+                return test::fail([csv_text, columns, expected_row, r = *r]
                         {
                             std::cout<<"row mismatch:\n";
-                            std::vector<std::string> row_v;
-
-                            for(auto & h: headers)
-                                row_v.emplace_back(std::move(r.at(h)));
-
-                            std::cout << "given:    "; CSV_test_suite::print_escapes(csv_text);    std::cout << '\n';
-                            std::cout << "expected: "; CSV_test_suite::print_data({expected_row}); std::cout << '\n';
-                            std::cout << "got:      "; CSV_test_suite::print_data({row_v});        std::cout << "\n\n";
+                            std::vector<std::string> expected_v, row_v;
+                            for(auto & c: columns)
+                            {
+                                expected_v.push_back(expected_row.at(c));
+                                row_v.push_back(r.count(c) ? r.at(c) : "<MISSING>");
+                            }
+
+                            std::cout << "given:    "; CSV_test_suite::print_escapes(csv_text); std::cout << '\n';
+                            std::cout << "expected: "; CSV_test_suite::print_data({expected_v});  std::cout << '\n';
+                            std::cout << "got:      "; CSV_test_suite::print_data({row_v});       std::cout << "\n\n";
                         });
             }
         }
@@ -399,18 +1466,14 @@ test::Result test_read_cpp_map(const std::string & csv_text, const CSV_data & ex
     }
     catch(const csv::Parse_error & e)
     {
-        if(e.what() == std::string{"Error parsing CSV at line: 0, col: 0: Can't get header row"} && std::size(expected_data) == 0)
-            return test::pass();
-        else
-        {
-            // std::cerr<<e.what()<<"\n";
-            return test::error();
-        }
+        // std::cerr<<e.what()<<"\n";
+        return test::error();
     }
-    catch(csv::Out_of_range_error & e)
+    catch(const csv::Out_of_range_error & e)
     {
-        if(e.what() == std::string{"Too many fields"})
-            return test::skip([](){ std::cout<<"wrong # of cols\n"; });
+        // the expected headers are not the ones in the input
+        if(e.what() == std::string{"Header not found"})
+            return test::fail();
         else
             throw;
     }
@@ -765,6 +1828,234 @@ test::Result test_write_cpp_stream(const std::string & expected_text, const CSV_
     return CSV_test_suite::common_write_return(data, expected_text, str.str());
 }
 
+test::Result test_write_cpp_file(const std::string & expected_text, const CSV_data & data, const char delimiter, const char quote)
+{
+    auto filename = (std::filesystem::temp_directory_path() / "csvpp_test_write.csv").string();
+    { // scoped so dtor is called before checking result
+        csv::Writer w(filename, delimiter, quote);
+        w.set_buffer_size(3); // force output to be written in several blocks
+        for(const auto & row: data)
+            w.write_row(row);
+    }
+
+    std::ifstream in{filename, std::ios::binary};
+    std::string csv_text{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+    in.close();
+    std::filesystem::remove(filename);
+
+    return CSV_test_suite::common_write_return(data, expected_text, csv_text);
+}
+
+#ifdef CSVPP_USE_ZLIB
+test::Result test_write_cpp_gzip(const std::string & expected_text, const CSV_data & data, const char delimiter, const char quote)
+{
+    std::ostringstream str;
+    { // scoped so dtor is called before checking result
+        csv::Writer w(str, csv::Compression::gzip, delimiter, quote);
+        for(const auto & row: data)
+            w.write_row(row);
+    }
+    return CSV_test_suite::common_write_return(data, expected_text, CSV_test_suite::gunzip(str.str()));
+}
+#endif
+
+test::Result test_write_cpp_quoting_always(const std::string & expected_text, const CSV_data & data, const char delimiter, const char quote)
+{
+    // blank lines are not read back as rows
+    if(std::any_of(std::begin(data), std::end(data), [](const auto & row) { return std::empty(row); }))
+        return test::skip();
+
+    std::ostringstream str;
+    { // scoped so dtor is called before checking result
+        csv::Writer w(str, delimiter, quote);
+        w.set_quoting(csv::Quoting::always);
+        for(const auto & row: data)
+            w.write_row(row);
+    }
+
+    // every field is quoted, so the output differs from expected_text, but must read back the same
+    auto read_data = csv::Reader(csv::Reader::input_string, str.str(), delimiter, quote).read_all();
+    return test::pass_fail(read_data == data, [data, expected_text, text = str.str()]()
+    {
+        std::cout << "given:    "; CSV_test_suite::print_data(data);          std::cout << '\n';
+        std::cout << "expected: "; CSV_test_suite::print_escapes(expected_text); std::cout << '\n';
+        std::cout << "got:      "; CSV_test_suite::print_escapes(text);       std::cout << "\n\n";
+    });
+}
+
+// build the expected output for data written with the given quoting policy for each column
+template <typename Policy_of>
+std::string quoted_text(const CSV_data & data, const char delimiter, const char quote, Policy_of policy_of)
+{
+    std::string text;
+    for(const auto & row: data)
+    {
+        for(std::size_t i = 0; i < std::size(row); ++i)
+        {
+            if(i > 0)
+                text += delimiter;
+
+            const auto & field = row[i];
+            auto policy = policy_of(i);
+            if(policy == csv::Quoting::minimal && field.find_first_of(std::string{delimiter, quote, '\r', '\n'}) == std::string::npos)
+                policy = csv::Quoting::never;
+
+            if(policy == csv::Quoting::never || policy == csv::Quoting::trusted)
+            {
+                text += field;
+                continue;
+            }
+
+            text += quote;
+            for(auto c: field)
+            {
+                if(c == quote)
+                    text += quote;
+                text += c;
+            }
+            text += quote;
+        }
+        text += "\r\n";
+    }
+    return text;
+}
+
+test::Result test_write_cpp_column_quoting(const std::string & expected_text, const CSV_data & data, const char delimiter, const char quote)
+{
+    // check the expected output builder against the suite's own expectation first
+    if(quoted_text(data, delimiter, quote, [](std::size_t) { return csv::Quoting::minimal; }) != expected_text)
+        return test::skip();
+
+    // every other column is left with the Writer's policy
+    auto policy_of = [](std::size_t i) { return i % 2 ? csv::Quoting::minimal : csv::Quoting::always; };
+
+    std::ostringstream str;
+    { // scoped so dtor is called before checking result
+        csv::Writer w(str, delimiter, quote);
+        w.set_quoting(csv::Quoting::always);
+        w.set_column_quoting(1, csv::Quoting::never);
+        w.set_column_quoting(1, csv::Quoting::minimal);
+        w.set_column_quoting(3, csv::Quoting::minimal);
+        w.set_column_quoting(5, csv::Quoting::minimal);
+        for(const auto & row: data)
+            w.write_row(row);
+    }
+
+    return CSV_test_suite::common_write_return(data, quoted_text(data, delimiter, quote, policy_of), str.str());
+}
+
+test::Result test_write_cpp_quoting_never(const std::string & expected_text, const CSV_data & data, const char delimiter, const char quote)
+{
+    if(quoted_text(data, delimiter, quote, [](std::size_t) { return csv::Quoting::minimal; }) != expected_text)
+        return test::skip();
+
+    // fields with the delimiter or quote are written as-is, even though the output is not valid CSV
+    std::ostringstream str;
+    {
+        csv::Writer w(str, delimiter, quote);
+        w.set_quoting(csv::Quoting::never);
+        for(const auto & row: data)
+            w.write_row(row);
+    }
+
+    return CSV_test_suite::common_write_return(data, quoted_text(data, delimiter, quote, [](std::size_t) { return csv::Quoting::never; }), str.str());
+}
+
+test::Result test_write_cpp_quoting_trusted(const std::string & expected_text, const CSV_data & data, const char delimiter, const char quote)
+{
+    // trusted fields must not need quoting, so only data without special characters can be used
+    for(const auto & row: data)
+    {
+        for(const auto & field: row)
+        {
+            if(field.find_first_of(std::string{delimiter, quote, '\r', '\n'}) != std::string::npos)
+                return test::skip();
+        }
+    }
+
+    std::ostringstream str;
+    {
+        csv::Writer w(str, delimiter, quote);
+        w.set_quoting(csv::Quoting::trusted);
+        for(const auto & row: data)
+            w.write_row(row);
+    }
+
+    return CSV_test_suite::common_write_return(data, expected_text, str.str());
+}
+
+template <csv::Quoting ...Policies, typename ...Fields>
+void write_row_quoted(csv::Writer & w, const bool as_tuple, const Fields & ...fields)
+{
+    if(as_tuple)
+        w.write_row_quoted<Policies...>(std::tuple<const Fields &...>{fields...});
+    else
+        w.write_row_quoted<Policies...>(fields...);
+}
+
+test::Result test_write_cpp_row_quoted(const std::string & expected_text, const CSV_data & data, const char delimiter, const char quote)
+{
+    if(quoted_text(data, delimiter, quote, [](std::size_t) { return csv::Quoting::minimal; }) != expected_text)
+        return test::skip();
+
+    constexpr auto A = csv::Quoting::always;
+    constexpr auto M = csv::Quoting::minimal;
+    constexpr auto N = csv::Quoting::never;
+    auto policy_of = [](std::size_t i) { return std::array{A, M, N, A, M, N}[i % 6]; };
+
+    std::ostringstream str;
+    {
+        csv::Writer w(str, delimiter, quote);
+
+        // the Writer's policy is ignored by write_row_quoted
+        w.set_quoting(csv::Quoting::never);
+        w.set_column_quoting(0, csv::Quoting::minimal);
+
+        // alternate rows are written from a tuple
+        for(std::size_t i = 0; i < std::size(data); ++i)
+        {
+            const auto & row = data[i];
+            const auto as_tuple = i % 2 == 1;
+            switch(std::size(row))
+            {
+            case 0: write_row_quoted<>(w, as_tuple); break;
+            case 1: write_row_quoted<A>(w, as_tuple, row[0]); break;
+            case 2: write_row_quoted<A, M>(w, as_tuple, row[0], row[1]); break;
+            case 3: write_row_quoted<A, M, N>(w, as_tuple, row[0], row[1], row[2]); break;
+            case 4: write_row_quoted<A, M, N, A>(w, as_tuple, row[0], row[1], row[2], row[3]); break;
+            case 5: write_row_quoted<A, M, N, A, M>(w, as_tuple, row[0], row[1], row[2], row[3], row[4]); break;
+            case 6: write_row_quoted<A, M, N, A, M, N>(w, as_tuple, row[0], row[1], row[2], row[3], row[4], row[5]); break;
+            default: return test::skip();
+            }
+        }
+    }
+
+    return CSV_test_suite::common_write_return(data, quoted_text(data, delimiter, quote, policy_of), str.str());
+}
+
+test::Result test_write_cpp_parallel(const std::string & expected_text, const CSV_data & data, const char delimiter, const char quote)
+{
+    std::ostringstream str;
+    {
+        csv::Parallel_writer w(str, delimiter, quote);
+        w.set_threads(3);
+        w.set_max_pending(2);
+
+        // two producers, submitting alternate rows, one per batch
+        auto produce = [&w, &data](std::size_t first)
+        {
+            for(auto i = first; i < std::size(data); i += 2)
+                w.submit_rows(i, CSV_data{data[i]});
+        };
+        std::thread producer{produce, 1};
+        produce(0);
+        producer.join();
+
+        w.finish();
+    }
+    return CSV_test_suite::common_write_return(data, expected_text, str.str());
+}
+
 test::Result test_write_cpp_fields(const std::string & expected_text, const CSV_data & data, const char delimiter, const char quote)
 {
     std::ostringstream str;
@@ -825,6 +2116,139 @@ test::Result test_write_cpp_stream_as_int(const std::string & expected_text, con
     return CSV_test_suite::common_write_return(data, expected_text, str.str());
 }
 
+test::Result test_write_cpp_stream_as_double(const std::string & expected_text, const CSV_data & data, const char delimiter, const char quote)
+{
+    auto int_data = convert_to_int(data);
+    if(!int_data)
+        return test::skip();
+
+    std::ostringstream str;
+    { // scoped so dtor is called before checking result
+        csv::Writer w(str, delimiter, quote);
+        for(const auto & row: *int_data)
+        {
+            for(const auto & col: row)
+                w<<static_cast<double>(col); // whole numbers are written without a decimal point
+            w<<csv::end_row;
+        }
+    }
+    return CSV_test_suite::common_write_return(data, expected_text, str.str());
+}
+
+test::Result test_write_cpp_stream_as_fixed(const std::string & expected_text, const CSV_data & data, const char delimiter, const char quote)
+{
+    auto int_data = convert_to_int(data);
+    if(!int_data || quoted_text(data, delimiter, quote, [](std::size_t) { return csv::Quoting::minimal; }) != expected_text)
+        return test::skip();
+
+    // every number gets exactly 3 digits after the decimal point
+    CSV_data fixed_data;
+    for(const auto & row: *int_data)
+    {
+        auto & fixed_row = fixed_data.emplace_back();
+        for(const auto & col: row)
+        {
+            char field[64];
+            std::snprintf(field, sizeof(field), "%.3f", col + 0.25);
+            fixed_row.emplace_back(field);
+        }
+    }
+
+    std::ostringstream str;
+    { // scoped so dtor is called before checking result
+        csv::Writer w(str, delimiter, quote);
+        w.set_precision(3);
+        for(const auto & row: *int_data)
+        {
+            for(const auto & col: row)
+                w<<col + 0.25;
+            w<<csv::end_row;
+        }
+    }
+    return CSV_test_suite::common_write_return(data, quoted_text(fixed_data, delimiter, quote, [](std::size_t) { return csv::Quoting::minimal; }), str.str());
+}
+
+test::Result test_write_cpp_stream_as_fixed_large(const std::string & expected_text, const CSV_data & data, const char delimiter, const char quote)
+{
+    auto int_data = convert_to_int(data);
+    if(!int_data || quoted_text(data, delimiter, quote, [](std::size_t) { return csv::Quoting::minimal; }) != expected_text)
+        return test::skip();
+
+    // every other column is too long to format on the stack
+    auto value = [](int col, std::size_t i) { return (col + 0.25) * (i % 2 ? 1.0 : 1e300); };
+
+    CSV_data fixed_data;
+    for(const auto & row: *int_data)
+    {
+        auto & fixed_row = fixed_data.emplace_back();
+        for(std::size_t i = 0; i < std::size(row); ++i)
+        {
+            char field[512];
+            std::snprintf(field, sizeof(field), "%.3f", value(row[i], i));
+            fixed_row.emplace_back(field);
+        }
+    }
+
+    std::ostringstream str;
+    { // scoped so dtor is called before checking result
+        csv::Writer w(str, delimiter, quote);
+        w.set_precision(3);
+        w.set_column_quoting(0, csv::Quoting::always);
+        for(const auto & row: *int_data)
+        {
+            for(std::size_t i = 0; i < std::size(row); ++i)
+                w<<value(row[i], i);
+            w<<csv::end_row;
+        }
+    }
+    return CSV_test_suite::common_write_return(data, quoted_text(fixed_data, delimiter, quote, [](std::size_t i) { return i == 0 ? csv::Quoting::always : csv::Quoting::minimal; }), str.str());
+}
+
+test::Result test_write_cpp_stream_as_double_dot_delimiter(const std::string & expected_text, const CSV_data & data, const char delimiter, const char quote)
+{
+    auto int_data = convert_to_int(data);
+    if(!int_data || delimiter != ',' || quoted_text(data, delimiter, quote, [](std::size_t) { return csv::Quoting::minimal; }) != expected_text)
+        return test::skip();
+
+    // with '.' as the delimiter, numbers with a decimal point must be quoted, but whole numbers must not be
+    CSV_data dot_data;
+    for(const auto & row: *int_data)
+    {
+        auto & dot_row = dot_data.emplace_back();
+        for(const auto & col: row)
+        {
+            char field[64];
+            std::snprintf(field, sizeof(field), "%.1f", col + 0.5);
+            dot_row.emplace_back(std::to_string(col));
+            dot_row.emplace_back(field);
+        }
+    }
+
+    std::ostringstream str;
+    { // scoped so dtor is called before checking result
+        csv::Writer w(str, '.', quote);
+        w.set_precision(1);
+        for(const auto & row: *int_data)
+        {
+            for(const auto & col: row)
+                w<<col<<col + 0.5;
+            w<<csv::end_row;
+        }
+    }
+
+    auto text = str.str();
+    if(text != quoted_text(dot_data, '.', quote, [](std::size_t) { return csv::Quoting::minimal; }))
+        return CSV_test_suite::common_write_return(data, quoted_text(dot_data, '.', quote, [](std::size_t) { return csv::Quoting::minimal; }), text);
+
+    // and read back as the same fields
+    auto read_data = csv::Reader(csv::Reader::input_string, text, '.', quote).read_all();
+    return test::pass_fail(read_data == dot_data, [data, text]()
+    {
+        std::cout << "given: "; CSV_test_suite::print_data(data);  std::cout << '\n';
+        std::cout << "got:   "; CSV_test_suite::print_escapes(text); std::cout << "\n\n";
+    });
+}
+
 test::Result test_write_cpp_row_as_int(const std::string & expected_text, const CSV_data & data, const char delimiter, const char quote)
 {
     auto int_data = convert_to_int(data);
@@ -954,6 +2378,16 @@ test::Result test_write_cpp_map(const std::string & expected_text, const CSV_dat
 void Cpp_test::register_tests(CSV_test_suite & tests) const
 {
     tests.register_read_test(test_read_cpp_read_all);
+    tests.register_read_test(test_read_cpp_istream_small_buffer);
+    tests.register_read_test(test_read_cpp_file);
+    tests.register_read_test(test_read_cpp_seek);
+    tests.register_read_test(test_read_cpp_seek_sidecar_mismatch);
+#ifdef CSVPP_HAS_URING
+    tests.register_read_test(test_read_cpp_uring_blocks);
+    tests.register_read_test(test_read_cpp_uring_seek);
+    tests.register_read_test(test_read_cpp_uring_pread);
+#endif
+    tests.register_read_test(test_read_cpp_shards);
     tests.register_read_test(test_read_cpp_read_row_vec);
     tests.register_read_test(test_read_cpp_read_all_as_int);
     tests.register_read_test(test_read_cpp_read_row);
@@ -961,11 +2395,35 @@ void Cpp_test::register_tests(CSV_test_suite & tests) const
     tests.register_read_test(test_read_cpp_fields);
     tests.register_read_test(test_read_cpp_iters);
     tests.register_read_test(test_read_cpp_range);
+    tests.register_read_test(test_read_cpp_range_view);
+    tests.register_read_test(test_read_cpp_row_view);
+    tests.register_read_test(test_read_cpp_try_read_row_view);
+    tests.register_read_test(test_read_cpp_try_read_field_as_int);
+    tests.register_read_test(test_read_cpp_try_read_field_throwing_conversion);
+    tests.register_read_test(test_read_cpp_try_read_row_view_throwing_filter);
+    tests.register_read_test(test_read_cpp_parallel);
+#ifdef CSVPP_USE_ZLIB
+    tests.register_read_test(test_read_cpp_parallel_gzip);
+#endif
+    tests.register_read_test(test_read_cpp_parallel_unordered);
+    tests.register_read_test(test_read_cpp_read_ahead);
+#ifdef CSVPP_USE_ZLIB
+    tests.register_read_test(test_read_cpp_gzip);
+#endif
+    tests.register_read_test(test_read_cpp_read_row_into);
+    tests.register_read_test(test_read_cpp_read_columns);
+    tests.register_read_test(test_read_cpp_typed);
+    tests.register_read_test(test_read_cpp_projection);
+    tests.register_read_test(test_read_cpp_projection_stream);
+    tests.register_read_test(test_read_cpp_projection_by_header);
+    tests.register_read_test(test_read_cpp_filter);
     tests.register_read_test(test_read_cpp_row_fields);
     tests.register_read_test(test_read_cpp_row_stream);
     tests.register_read_test(test_read_cpp_row_vec);
     tests.register_read_test(test_read_cpp_row_vec_as_int);
     tests.register_read_test(test_read_cpp_map);
+    tests.register_read_test(test_read_cpp_map_too_many_fields);
+    tests.register_read_test(test_read_cpp_map_columns);
     tests.register_read_test(test_read_cpp_map_as_int);
     tests.register_read_test(test_read_cpp_variadic);
     tests.register_read_test(test_read_cpp_tuple);
@@ -973,10 +2431,24 @@ void Cpp_test::register_tests(CSV_test_suite & tests) const
     tests.register_read_test(test_read_cpp_row_tuple);
 
     tests.register_write_test(test_write_cpp_stream);
+    tests.register_write_test(test_write_cpp_file);
+#ifdef CSVPP_USE_ZLIB
+    tests.register_write_test(test_write_cpp_gzip);
+#endif
+    tests.register_write_test(test_write_cpp_quoting_always);
+    tests.register_write_test(test_write_cpp_column_quoting);
+    tests.register_write_test(test_write_cpp_quoting_never);
+    tests.register_write_test(test_write_cpp_quoting_trusted);
+    tests.register_write_test(test_write_cpp_row_quoted);
+    tests.register_write_test(test_write_cpp_parallel);
     tests.register_write_test(test_write_cpp_fields);
     tests.register_write_test(test_write_cpp_row);
     tests.register_write_test(test_write_cpp_iter);
     tests.register_write_test(test_write_cpp_stream_as_int);
+    tests.register_write_test(test_write_cpp_stream_as_double);
+    tests.register_write_test(test_write_cpp_stream_as_fixed);
+    tests.register_write_test(test_write_cpp_stream_as_fixed_large);
+    tests.register_write_test(test_write_cpp_stream_as_double_dot_delimiter);
     tests.register_write_test(test_write_cpp_row_as_int);
     tests.register_write_test(test_write_cpp_iter_as_int);
     tests.register_write_test(test_write_cpp_variadic);
@@ -1,6 +1,7 @@
 #ifndef CSV_TEST_SUITE_HPP
 #define CSV_TEST_SUITE_HPP
 
+#include <algorithm>
 #include <functional>
 #include <iostream>
 #include <regex>
@@ -9,6 +10,10 @@
 
 #include "test.hpp"
 
+#ifdef CSVPP_USE_ZLIB
+#include <zlib.h>
+#endif
+
 using CSV_data = std::vector<std::vector<std::string>>;
 
 class CSV_test_suite
@@ -42,6 +47,77 @@ public:
         });
     }
 
+#ifdef CSVPP_USE_ZLIB
+    // gzip input as BGZF: small independent members with their size in a BC extra field.
+    // Short inputs are split every 3 bytes, to put member boundaries inside of every row and field
+    static std::string gzip(const std::string & input)
+    {
+        std::string output;
+        auto part_size = std::max(std::size(input) / 16, std::size_t{3});
+        for(std::size_t begin = 0; begin < std::size(input) || begin == 0; begin += part_size)
+        {
+            auto part = input.substr(std::min(begin, std::size(input)), part_size);
+
+            z_stream stream {};
+            if(deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                throw std::runtime_error("could not init deflate");
+
+            Bytef extra[] = {'B', 'C', 2, 0, 0, 0};
+            gz_header header {};
+            header.extra = extra;
+            header.extra_len = sizeof(extra);
+            header.os = 255;
+            deflateSetHeader(&stream, &header);
+
+            std::string member(deflateBound(&stream, std::size(part)) + sizeof(extra) + 2, '\0');
+            stream.next_in = reinterpret_cast<Bytef *>(std::data(part));
+            stream.avail_in = std::size(part);
+            stream.next_out = reinterpret_cast<Bytef *>(std::data(member));
+            stream.avail_out = std::size(member);
+            if(deflate(&stream, Z_FINISH) != Z_STREAM_END)
+                throw std::runtime_error("could not deflate");
+
+            member.resize(stream.total_out);
+            deflateEnd(&stream);
+
+            // member size - 1, following the BC subfield header
+            member[16] = static_cast<char>((std::size(member) - 1) & 0xff);
+            member[17] = static_cast<char>((std::size(member) - 1) >> 8);
+            output += member;
+        }
+        return output;
+    }
+
+    static std::string gunzip(const std::string & input)
+    {
+        z_stream stream {};
+        if(inflateInit2(&stream, 15 + 16) != Z_OK)
+            throw std::runtime_error("could not init inflate");
+
+        std::string output;
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(std::data(input)));
+        stream.avail_in = std::size(input);
+        while(true)
+        {
+            char buffer[4096];
+            stream.next_out = reinterpret_cast<Bytef *>(buffer);
+            stream.avail_out = sizeof(buffer);
+            auto ret = inflate(&stream, Z_NO_FLUSH);
+            output.append(buffer, sizeof(buffer) - stream.avail_out);
+            if(ret == Z_STREAM_END)
+            {
+                if(stream.avail_in == 0)
+                    break;
+                inflateReset(&stream); // next member
+            }
+            else if(ret != Z_OK)
+                throw std::runtime_error("could not inflate");
+        }
+        inflateEnd(&stream);
+        return output;
+    }
+#endif
+
     static void print_escapes(const std::string & text, bool escape_quote = false)
     {
         for(auto & c: text)
@@ -263,6 +339,16 @@ public:
                     "1,123412341234123412341234123412341234123412341234123412341234123412341234123412341234123412341234123412341234123412341234123412342,3,4",
                     {{"1", "123412341234123412341234123412341234123412341234123412341234123412341234123412341234123412341234123412341234123412341234123412342", "3", "4"}});
 
+            test_quotes(test_read_pass, "Read test: long fields",
+                    "\"abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ\"\"KLMNOPQRSTUVWXYZ0123456789abcdefghij,\r\nklmnopqrstuvwxyz0123456789ABCDEFGHIJ\",abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ\r\n",
+                    {{"abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ\"KLMNOPQRSTUVWXYZ0123456789abcdefghij,\r\nklmnopqrstuvwxyz0123456789ABCDEFGHIJ", "abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"}});
+
+            test_quotes(test_read_error, "Read test: unescaped quote in long field",
+                    "abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ\"KLMNOPQRSTUVWXYZ\r\n", {{"<parse error>"}});
+
+            test_quotes(test_read_pass, "Read test: unescaped quote in long field (lenient)",
+                    "abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ\"KLMNOPQRSTUVWXYZ\r\n", {{"abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ\"KLMNOPQRSTUVWXYZ"}}, true);
+
             {
                 std::string test_str;
                 const int test_nums = 42;
@@ -281,6 +367,33 @@ public:
 
                 test_quotes(test_read_pass, "Read test: fields reallocation", test_str, data);
             }
+
+            {
+                std::string test_str, test_str_lenient;
+                CSV_data data, data_lenient;
+
+                for(int i = 0; i < 4000; ++i)
+                {
+                    auto num = std::to_string(i);
+                    data.push_back({num, "field " + num, "quoted, \"field\"\r\n" + num, ""});
+                    test_str += num + ",field " + num + ",\"quoted, \"\"field\"\"\r\n" + num + "\",\r\n";
+
+                    // some rows need error recovery
+                    if(i % 97 == 0)
+                    {
+                        data_lenient.push_back({num, "fi\"eld " + num});
+                        test_str_lenient += num + ",fi\"eld " + num + "\r\n";
+                    }
+                    else
+                    {
+                        data_lenient.push_back(data.back());
+                        test_str_lenient += test_str.substr(test_str.rfind(num + ",field "));
+                    }
+                }
+
+                test_quotes(test_read_pass, "Read test: large input", test_str, data);
+                test_quotes(test_read_pass, "Read test: large input with errors (lenient)", test_str_lenient, data_lenient, true);
+            }
         }
 
         if(!std::empty(test_write))
@@ -323,6 +436,37 @@ public:
             test_quotes(test_write_pass, "Write test: more than header",
                     "1,2,3,4\r\n5,6,7,8,9\r\n", {{"1", "2", "3", "4"}, {"5", "6", "7", "8", "9"}});
 
+            // fields long enough for the vectorized scans. The only character
+            // needing quoting is in the 2nd 32 byte block, or in the 16 byte
+            // block after that
+            test_quotes(test_write_pass, "Write test: long fields",
+                    "abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ,KLMNOPQRSTUVWXYZ0123456789abcdefghijabcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ\r\n",
+                    {{"abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ", "KLMNOPQRSTUVWXYZ0123456789abcdefghijabcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ"}});
+
+            test_quotes(test_write_pass, "Write test: long field with comma",
+                    "\"abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ,KLMNOPQRSTUVWXYZ0123456789abcdefghij\"\r\n",
+                    {{"abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ,KLMNOPQRSTUVWXYZ0123456789abcdefghij"}});
+
+            test_quotes(test_write_pass, "Write test: long field with quote",
+                    "\"abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ\"\"KLMNOPQRSTUVWXYZ0123456789abcdefghij\"\r\n",
+                    {{"abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ\"KLMNOPQRSTUVWXYZ0123456789abcdefghij"}});
+
+            test_quotes(test_write_pass, "Write test: long field with CR",
+                    "\"abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ\rKLMNOPQRSTUVWXYZ0123456789abcdefghij\"\r\n",
+                    {{"abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ\rKLMNOPQRSTUVWXYZ0123456789abcdefghij"}});
+
+            test_quotes(test_write_pass, "Write test: long field with LF",
+                    "\"abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ\nKLMNOPQRSTUVWXYZ0123456789abcdefghij\"\r\n",
+                    {{"abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ\nKLMNOPQRSTUVWXYZ0123456789abcdefghij"}});
+
+            test_quotes(test_write_pass, "Write test: long field with quote near end",
+                    "abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ,\"abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456\"\"789abcdefg\"\r\n",
+                    {{"abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ", "abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456\"789abcdefg"}});
+
+            test_quotes(test_write_pass, "Write test: long field with many quotes",
+                    "\"abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ\"\"K\"\"\"\"LMNOPQRSTUVWXYZ0123456789\"\"\"\"\"\"abcdefghijklmnopqrstuvwxyz\"\"0123456789\"\",\"\"\"\r\n",
+                    {{"abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ\"K\"\"LMNOPQRSTUVWXYZ0123456789\"\"\"abcdefghijklmnopqrstuvwxyz\"0123456789\",\""}});
+
             std::cout<<"\n";
         }
 